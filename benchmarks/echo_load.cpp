@@ -0,0 +1,301 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+// Loopback load generator for an echo server. Each client fiber owns one
+// connection and sends `depth` messages back-to-back before reading their
+// echoes; `depth=1` is a closed loop, larger values pipeline requests. The
+// round-trip latency of each message is measured from the moment its batch was
+// written until its echo has been fully read.
+//
+// By default the benchmark runs an in-process copy of the echo server from
+// `examples/echo.cpp` on 127.0.0.1 once for each value of `--threads`.
+// `--port=N` drives an already running server (e.g. `echo_example`, which
+// listens on port 8000) instead.
+
+#include "harness.hpp"
+
+#include <ufiber/stack_pool.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <cstdint>
+#include <mutex>
+
+namespace
+{
+
+namespace net = boost::asio;
+
+using executor_t = net::io_context::executor_type;
+using yield_token_t = ufiber::yield_token<executor_t>;
+using tcp_socket = net::basic_stream_socket<net::ip::tcp, executor_t>;
+using tcp_acceptor = net::basic_socket_acceptor<net::ip::tcp, executor_t>;
+using clock_type = std::chrono::steady_clock;
+
+struct echo_session
+{
+    void operator()(yield_token_t yield)
+    {
+        std::uint8_t buffer[8192];
+        for (;;)
+        {
+            boost::system::error_code ec;
+            std::size_t n;
+            std::tie(ec, n) =
+              socket_.async_read_some(net::buffer(buffer), yield);
+            if (ec)
+            {
+                return;
+            }
+            std::tie(ec, n) =
+              net::async_write(socket_, net::buffer(buffer, n), yield);
+            if (ec)
+            {
+                return;
+            }
+        }
+    }
+
+    tcp_socket socket_;
+};
+
+// Accepts connections until the io_context is stopped
+class echo_server
+{
+public:
+    explicit echo_server(std::size_t threads)
+      : acceptor_{io_.get_executor(),
+                  net::ip::tcp::endpoint{net::ip::address_v4::loopback(), 0}}
+    {
+        endpoint_ = acceptor_.local_endpoint();
+        ufiber::spawn(io_.get_executor(), [this](yield_token_t yield) {
+            tcp_socket s{io_.get_executor()};
+            for (;;)
+            {
+                boost::system::error_code ec = acceptor_.async_accept(s, yield);
+                if (ec)
+                {
+                    return;
+                }
+                s.set_option(net::ip::tcp::no_delay{true}, ec);
+                ufiber::spawn(std::allocator_arg,
+                              pool_.get_allocator(),
+                              yield.get_executor(),
+                              echo_session{std::move(s)});
+            }
+        });
+        for (std::size_t i = 0; i < threads; ++i)
+        {
+            threads_.emplace_back([this] { io_.run(); });
+        }
+    }
+
+    ~echo_server()
+    {
+        io_.stop();
+        for (auto& t : threads_)
+        {
+            t.join();
+        }
+    }
+
+    net::ip::tcp::endpoint endpoint() const
+    {
+        return endpoint_;
+    }
+
+private:
+    net::io_context io_;
+    tcp_acceptor acceptor_;
+    net::ip::tcp::endpoint endpoint_;
+    ufiber::stack_pool pool_;
+    std::vector<std::thread> threads_;
+};
+
+struct load_config
+{
+    net::ip::tcp::endpoint endpoint;
+    std::size_t clients;
+    std::size_t client_threads;
+    std::size_t message_size;
+    std::size_t depth;
+    clock_type::duration duration;
+};
+
+struct load_result
+{
+    std::vector<std::int64_t> latencies;
+    std::size_t errors = 0;
+    double seconds = 0;
+};
+
+load_result
+generate_load(load_config const& cfg)
+{
+    net::io_context io{static_cast<int>(cfg.client_threads)};
+    std::mutex mutex;
+    load_result result;
+    auto const start = clock_type::now();
+    auto const deadline = start + cfg.duration;
+
+    for (std::size_t c = 0; c < cfg.clients; ++c)
+    {
+        ufiber::spawn(io.get_executor(), [&](yield_token_t yield) {
+            std::vector<std::int64_t> latencies;
+            std::vector<std::uint8_t> out(cfg.message_size * cfg.depth, 'x');
+            std::vector<std::uint8_t> in(cfg.message_size);
+            tcp_socket s{yield.get_executor()};
+
+            boost::system::error_code ec = s.async_connect(cfg.endpoint, yield);
+            if (!ec)
+            {
+                s.set_option(net::ip::tcp::no_delay{true}, ec);
+            }
+            while (!ec && clock_type::now() < deadline)
+            {
+                std::size_t n;
+                auto const sent = clock_type::now();
+                std::tie(ec, n) = net::async_write(s, net::buffer(out), yield);
+                for (std::size_t i = 0; !ec && i < cfg.depth; ++i)
+                {
+                    std::tie(ec, n) =
+                      net::async_read(s, net::buffer(in), yield);
+                    latencies.push_back(
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        clock_type::now() - sent)
+                        .count());
+                }
+            }
+            s.shutdown(net::socket_base::shutdown_both, ec);
+
+            std::lock_guard<std::mutex> lock{mutex};
+            if (clock_type::now() < deadline)
+            {
+                ++result.errors;
+            }
+            result.latencies.insert(
+              result.latencies.end(), latencies.begin(), latencies.end());
+        });
+    }
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < cfg.client_threads; ++i)
+    {
+        threads.emplace_back([&io] { io.run(); });
+    }
+    io.run();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    result.seconds =
+      std::chrono::duration<double>(clock_type::now() - start).count();
+    return result;
+}
+
+double
+percentile_us(std::vector<std::int64_t>& v, double p)
+{
+    if (v.empty())
+    {
+        return 0;
+    }
+    auto const idx =
+      static_cast<std::size_t>(p * static_cast<double>(v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return static_cast<double>(v[idx]) / 1000.0;
+}
+
+void
+run_load(ufiber::bench::harness& h, std::string const& name, load_config cfg)
+{
+    if (!h.enabled(name))
+    {
+        return;
+    }
+    auto r = generate_load(cfg);
+    auto const messages = r.latencies.size();
+    double mean = 0;
+    for (auto l : r.latencies)
+    {
+        mean += static_cast<double>(l);
+    }
+    mean = messages > 0 ? mean / static_cast<double>(messages) / 1000.0 : 0;
+    auto const rate = static_cast<double>(messages) / r.seconds;
+    auto const p50 = percentile_us(r.latencies, 0.5);
+
+    h.record(ufiber::bench::harness::result{
+      name,
+      messages,
+      p50 * 1000.0,
+      rate,
+      {{"mean_us", mean},
+       {"p50_us", p50},
+       {"p99_us", percentile_us(r.latencies, 0.99)},
+       {"p999_us", percentile_us(r.latencies, 0.999)},
+       {"MiB_per_second",
+        rate * static_cast<double>(cfg.message_size) / (1024.0 * 1024.0)},
+       {"errors", static_cast<double>(r.errors)}}});
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    ufiber::bench::harness h{argc, argv};
+
+    load_config cfg;
+    cfg.clients = h.list_option("clients", "64").front();
+    cfg.client_threads = h.list_option("client-threads", "1").front();
+    cfg.duration = std::chrono::milliseconds{static_cast<std::int64_t>(
+      2000 * std::atof(h.option("scale", "1").c_str()))};
+    auto const sizes = h.list_option("sizes", "64,4096");
+    auto const depths = h.list_option("depths", "1,16");
+    auto const port = h.list_option("port", "0").front();
+
+    auto const run_all = [&](std::string const& prefix) {
+        for (auto size : sizes)
+        {
+            for (auto depth : depths)
+            {
+                cfg.message_size = size;
+                cfg.depth = depth;
+                auto name = prefix + (depth == 1 ? "/closed" : "/pipelined") +
+                            "/size:" + std::to_string(size) +
+                            "/depth:" + std::to_string(depth) +
+                            "/clients:" + std::to_string(cfg.clients);
+                run_load(h, name, cfg);
+            }
+        }
+    };
+
+    if (port != 0)
+    {
+        cfg.endpoint =
+          net::ip::tcp::endpoint{net::ip::address_v4::loopback(),
+                                 static_cast<unsigned short>(port)};
+        run_all("echo/external");
+    }
+    else
+    {
+        for (auto threads : h.list_option("threads", "1,2,4"))
+        {
+            echo_server server{threads};
+            cfg.endpoint = server.endpoint();
+            run_all("echo/threads:" + std::to_string(threads));
+        }
+    }
+    h.report();
+}
@@ -0,0 +1,250 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_BENCHMARKS_HARNESS_HPP
+#define UFIBER_BENCHMARKS_HARNESS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ufiber
+{
+namespace bench
+{
+
+// Minimal benchmark runner. The JSON it emits follows the layout used by
+// Google Benchmark (`context` + `benchmarks` array with `real_time` and
+// `cpu_time` in `time_unit`), so existing comparison tooling can consume it.
+// `cpu_time` is the CPU time of the whole process, so it includes the threads
+// a benchmark runs its io_context on.
+class harness
+{
+public:
+    struct result
+    {
+        std::string name;
+        std::size_t iterations;
+        double ns_per_op;
+        double items_per_second;
+        std::vector<std::pair<std::string, double>> counters;
+        // CPU time of the whole process per iteration, negative if the
+        // benchmark doesn't measure it
+        double cpu_ns_per_op = -1;
+    };
+
+    harness(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg{argv[i]};
+            args_.push_back(arg);
+            if (arg.compare(0, 8, "--scale=") == 0)
+            {
+                scale_ = std::atof(arg.c_str() + 8);
+            }
+            else if (arg.compare(0, 9, "--filter=") == 0)
+            {
+                filter_ = arg.substr(9);
+            }
+            else if (arg.compare(0, 6, "--out=") == 0)
+            {
+                out_ = arg.substr(6);
+            }
+            else if (arg.compare(0, 14, "--repetitions=") == 0)
+            {
+                repetitions_ = std::atoi(arg.c_str() + 14);
+            }
+            else if (arg == "--help")
+            {
+                std::cout
+                  << "usage: " << argv[0]
+                  << " [--scale=X] [--filter=SUBSTR] [--repetitions=N]"
+                     " [--out=FILE]\n";
+                std::exit(0);
+            }
+        }
+        if (repetitions_ < 1)
+        {
+            repetitions_ = 1;
+        }
+    }
+
+    // Returns the value of a benchmark specific `--name=value` argument
+    std::string option(std::string const& name, std::string def) const
+    {
+        auto const prefix = "--" + name + "=";
+        for (auto const& arg : args_)
+        {
+            if (arg.compare(0, prefix.size(), prefix) == 0)
+            {
+                return arg.substr(prefix.size());
+            }
+        }
+        return def;
+    }
+
+    // Returns the value of a comma-separated `--name=a,b,c` argument
+    std::vector<std::size_t> list_option(std::string const& name,
+                                         std::string def) const
+    {
+        std::vector<std::size_t> values;
+        std::istringstream is{option(name, std::move(def))};
+        std::string value;
+        while (std::getline(is, value, ','))
+        {
+            values.push_back(std::strtoul(value.c_str(), nullptr, 10));
+        }
+        return values;
+    }
+
+    // Number of iterations to use for a benchmark with nominal size `n`.
+    std::size_t iterations(std::size_t n) const
+    {
+        auto scaled =
+          static_cast<std::size_t>(static_cast<double>(n) * scale_);
+        return scaled > 0 ? scaled : 1;
+    }
+
+    bool enabled(std::string const& name) const
+    {
+        return filter_.empty() || name.find(filter_) != std::string::npos;
+    }
+
+    // Runs `f(iterations)` `repetitions` times and records the median time
+    // per iteration. `f` must perform exactly `iterations` operations.
+    template<class F>
+    void run(std::string const& name, std::size_t nominal, F&& f)
+    {
+        if (!enabled(name))
+        {
+            return;
+        }
+        auto const n = iterations(nominal);
+        // Warm up caches, allocators and lazily initialized services
+        f(std::max<std::size_t>(n / 10, 1));
+
+        std::vector<double> samples;
+        std::vector<double> cpu_samples;
+        for (int i = 0; i < repetitions_; ++i)
+        {
+            auto const cpu_start = cpu_time();
+            auto const start = std::chrono::steady_clock::now();
+            f(n);
+            auto const stop = std::chrono::steady_clock::now();
+            auto const cpu_stop = cpu_time();
+            samples.push_back(
+              std::chrono::duration<double, std::nano>(stop - start).count() /
+              static_cast<double>(n));
+            cpu_samples.push_back((cpu_stop - cpu_start) /
+                                  static_cast<double>(n));
+        }
+        std::sort(samples.begin(), samples.end());
+        std::sort(cpu_samples.begin(), cpu_samples.end());
+        record(result{name,
+                      n,
+                      samples[samples.size() / 2],
+                      1e9 / samples[samples.size() / 2],
+                      {},
+                      cpu_samples[cpu_samples.size() / 2]});
+    }
+
+    void record(result r)
+    {
+        std::cerr << r.name << ": " << r.ns_per_op << " ns/op, "
+                  << r.items_per_second << " op/s";
+        for (auto const& c : r.counters)
+        {
+            std::cerr << ", " << c.first << "=" << c.second;
+        }
+        std::cerr << '\n';
+        results_.push_back(std::move(r));
+    }
+
+    // Writes the results to the file given by --out, or to stdout.
+    void report() const
+    {
+        std::ostringstream os;
+        std::time_t now = std::time(nullptr);
+        char date[64];
+        std::strftime(
+          date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::gmtime(&now));
+        os << "{\n  \"context\": {\n"
+           << "    \"date\": \"" << date << "\",\n"
+           << "    \"num_cpus\": " << std::thread::hardware_concurrency()
+           << ",\n"
+           << "    \"library\": \"ufiber\",\n"
+           << "    \"scale\": " << scale_ << "\n  },\n"
+           << "  \"benchmarks\": [";
+        for (std::size_t i = 0; i < results_.size(); ++i)
+        {
+            auto const& r = results_[i];
+            os << (i == 0 ? "\n" : ",\n") << "    {\n"
+               << "      \"name\": \"" << r.name << "\",\n"
+               << "      \"run_type\": \"iteration\",\n"
+               << "      \"iterations\": " << r.iterations << ",\n"
+               << "      \"real_time\": " << r.ns_per_op << ",\n";
+            if (r.cpu_ns_per_op >= 0)
+            {
+                os << "      \"cpu_time\": " << r.cpu_ns_per_op << ",\n";
+            }
+            os << "      \"time_unit\": \"ns\",\n"
+               << "      \"items_per_second\": " << r.items_per_second;
+            for (auto const& c : r.counters)
+            {
+                os << ",\n      \"" << c.first << "\": " << c.second;
+            }
+            os << "\n    }";
+        }
+        os << "\n  ]\n}\n";
+
+        if (out_.empty())
+        {
+            std::cout << os.str();
+        }
+        else
+        {
+            std::ofstream{out_} << os.str();
+        }
+    }
+
+private:
+    // CPU time consumed by all threads of the process, in nanoseconds
+    static double cpu_time() noexcept
+    {
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+        timespec ts;
+        if (::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0)
+        {
+            return static_cast<double>(ts.tv_sec) * 1e9 +
+                   static_cast<double>(ts.tv_nsec);
+        }
+#endif // CLOCK_PROCESS_CPUTIME_ID
+        return static_cast<double>(std::clock()) * 1e9 / CLOCKS_PER_SEC;
+    }
+
+    double scale_ = 1.0;
+    int repetitions_ = 5;
+    std::string filter_;
+    std::string out_;
+    std::vector<std::string> args_;
+    std::vector<result> results_;
+};
+
+} // namespace bench
+} // namespace ufiber
+
+#endif // UFIBER_BENCHMARKS_HARNESS_HPP
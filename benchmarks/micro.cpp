@@ -0,0 +1,576 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include "harness.hpp"
+
+#include <ufiber/deadline.hpp>
+#include <ufiber/stack_pool.hpp>
+#include <ufiber/this_fiber.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/executor.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef UFIBER_BENCH_ASIO_SPAWN
+#include <boost/asio/spawn.hpp>
+#endif // UFIBER_BENCH_ASIO_SPAWN
+
+namespace
+{
+
+namespace net = boost::asio;
+
+using executor_t = net::io_context::executor_type;
+using yield_token_t = ufiber::yield_token<executor_t>;
+
+// Asynchronous operations which complete through the io_context's queue with
+// 0, 1 and 3 results.
+template<class CompletionToken>
+auto
+async_0(net::io_context& io, CompletionToken&& tok)
+  -> BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void())
+{
+    return net::async_initiate<CompletionToken, void()>(
+      [&io](BOOST_ASIO_HANDLER_TYPE(CompletionToken, void()) && handler) {
+          auto ex = net::get_associated_executor(handler, io.get_executor());
+          net::post(ex, std::move(handler));
+      },
+      tok);
+}
+
+template<class CompletionToken>
+auto
+async_1(net::io_context& io, int v, CompletionToken&& tok)
+  -> BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(int))
+{
+    using handler_t = BOOST_ASIO_HANDLER_TYPE(CompletionToken, void(int));
+    struct op
+    {
+        void operator()()
+        {
+            handler_(v_);
+        }
+
+        handler_t handler_;
+        int v_;
+    };
+
+    return net::async_initiate<CompletionToken, void(int)>(
+      [&io, v](handler_t&& handler) {
+          auto ex = net::get_associated_executor(handler, io.get_executor());
+          net::post(ex, op{std::move(handler), v});
+      },
+      tok);
+}
+
+template<class CompletionToken>
+auto
+async_3(net::io_context& io, int v, CompletionToken&& tok)
+  -> BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(int, int, int))
+{
+    using handler_t =
+      BOOST_ASIO_HANDLER_TYPE(CompletionToken, void(int, int, int));
+    struct op
+    {
+        void operator()()
+        {
+            handler_(v_, v_ + 1, v_ + 2);
+        }
+
+        handler_t handler_;
+        int v_;
+    };
+
+    return net::async_initiate<CompletionToken, void(int, int, int)>(
+      [&io, v](handler_t&& handler) {
+          auto ex = net::get_associated_executor(handler, io.get_executor());
+          net::post(ex, op{std::move(handler), v});
+      },
+      tok);
+}
+
+volatile int sink = 0;
+
+void
+spawn_benchmarks(ufiber::bench::harness& h)
+{
+    net::io_context io{1};
+    ufiber::stack_pool pool;
+    auto const noop = [](yield_token_t) {};
+
+    h.run("spawn/latency/executor", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            ufiber::spawn(io.get_executor(), noop);
+            io.run();
+            io.restart();
+        }
+    });
+
+    h.run("spawn/latency/context", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            ufiber::spawn(io, noop);
+            io.run();
+            io.restart();
+        }
+    });
+
+    h.run("spawn/latency/allocator_pool", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            ufiber::spawn(std::allocator_arg,
+                          pool.get_allocator(),
+                          io.get_executor(),
+                          noop);
+            io.run();
+            io.restart();
+        }
+    });
+
+    h.run("spawn/throughput/executor", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            ufiber::spawn(io.get_executor(), noop);
+        }
+        io.run();
+        io.restart();
+    });
+
+    h.run("spawn/throughput/context", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            ufiber::spawn(io, noop);
+        }
+        io.run();
+        io.restart();
+    });
+
+    h.run("spawn/throughput/allocator_pool", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            ufiber::spawn(std::allocator_arg,
+                          pool.get_allocator(),
+                          io.get_executor(),
+                          noop);
+        }
+        io.run();
+        io.restart();
+    });
+
+    // Spawning from a handler that already runs on the target executor
+    h.run("spawn/latency/nested_post", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            net::post(io, [&] {
+                ufiber::spawn(std::allocator_arg,
+                              pool.get_allocator(),
+                              io.get_executor(),
+                              noop);
+            });
+            io.run();
+            io.restart();
+        }
+    });
+
+    h.run("spawn/latency/nested_dispatch", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            net::post(io, [&] {
+                ufiber::spawn_dispatch(std::allocator_arg,
+                                       pool.get_allocator(),
+                                       io.get_executor(),
+                                       noop);
+            });
+            io.run();
+            io.restart();
+        }
+    });
+
+#ifdef UFIBER_BENCH_ASIO_SPAWN
+    h.run("spawn/latency/asio_spawn", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            net::spawn(io, [](net::yield_context) {});
+            io.run();
+            io.restart();
+        }
+    });
+
+    h.run("spawn/throughput/asio_spawn", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            net::spawn(io, [](net::yield_context) {});
+        }
+        io.run();
+        io.restart();
+    });
+#endif // UFIBER_BENCH_ASIO_SPAWN
+
+    h.run("spawn/latency/callback", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            net::post(io, [] { ++sink; });
+            io.run();
+            io.restart();
+        }
+    });
+
+    h.run("spawn/throughput/callback", 100000, [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            net::post(io, [] { ++sink; });
+        }
+        io.run();
+        io.restart();
+    });
+}
+
+// Runs `f(yield, n)` in a single fiber
+template<class F>
+void
+in_fiber(net::io_context& io, std::size_t n, F f)
+{
+    ufiber::spawn(io, [n, f](yield_token_t yield) { f(yield, n); });
+    io.run();
+    io.restart();
+}
+
+// A callback chain that performs `n_` operations one after another
+template<class Op>
+struct chain
+{
+    void operator()()
+    {
+        if (n_-- > 0)
+        {
+            op_(std::move(*this));
+        }
+    }
+
+    template<class T, class... Ts>
+    void operator()(T t, Ts...)
+    {
+        sink = sink + static_cast<int>(t);
+        (*this)();
+    }
+
+    Op op_;
+    std::size_t n_;
+};
+
+template<class Op>
+void
+run_chain(net::io_context& io, std::size_t n, Op op)
+{
+    chain<Op>{op, n}();
+    io.run();
+    io.restart();
+}
+
+struct post_op
+{
+    template<class Handler>
+    void operator()(Handler&& h) const
+    {
+        net::post(*io_, std::forward<Handler>(h));
+    }
+    net::io_context* io_;
+};
+
+void
+switch_benchmarks(ufiber::bench::harness& h)
+{
+    net::io_context io{1};
+
+    h.run("resume/post/ufiber", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [](yield_token_t yield, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                net::post(yield);
+            }
+        });
+    });
+
+    h.run("resume/yield/ufiber", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [](yield_token_t yield, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                ufiber::this_fiber::yield(yield);
+            }
+        });
+    });
+
+#ifdef UFIBER_BENCH_ASIO_SPAWN
+    h.run("resume/post/asio_spawn", 1000000, [&](std::size_t n) {
+        net::spawn(io, [n](net::yield_context yield) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                net::post(yield);
+            }
+        });
+        io.run();
+        io.restart();
+    });
+#endif // UFIBER_BENCH_ASIO_SPAWN
+
+    h.run("resume/post/callback", 1000000, [&](std::size_t n) {
+        run_chain(io, n, post_op{&io});
+    });
+}
+
+struct op_0
+{
+    template<class Handler>
+    void operator()(Handler&& h) const
+    {
+        async_0(*io_, std::forward<Handler>(h));
+    }
+    net::io_context* io_;
+};
+
+struct op_1
+{
+    template<class Handler>
+    void operator()(Handler&& h) const
+    {
+        async_1(*io_, 1, std::forward<Handler>(h));
+    }
+    net::io_context* io_;
+};
+
+struct op_3
+{
+    template<class Handler>
+    void operator()(Handler&& h) const
+    {
+        async_3(*io_, 1, std::forward<Handler>(h));
+    }
+    net::io_context* io_;
+};
+
+void
+promise_benchmarks(ufiber::bench::harness& h)
+{
+    net::io_context io{1};
+
+    h.run("promise/0/ufiber", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [&io](yield_token_t yield, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                async_0(io, yield);
+            }
+        });
+    });
+
+    h.run("promise/1/ufiber", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [&io](yield_token_t yield, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                sink = sink + async_1(io, 1, yield);
+            }
+        });
+    });
+
+    h.run("promise/3/ufiber", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [&io](yield_token_t yield, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                sink = sink + std::get<2>(async_3(io, 1, yield));
+            }
+        });
+    });
+
+#ifdef UFIBER_BENCH_ASIO_SPAWN
+    // yield_context supports at most one result (plus an error_code)
+    h.run("promise/0/asio_spawn", 1000000, [&](std::size_t n) {
+        net::spawn(io, [&io, n](net::yield_context yield) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                async_0(io, yield);
+            }
+        });
+        io.run();
+        io.restart();
+    });
+
+    h.run("promise/1/asio_spawn", 1000000, [&](std::size_t n) {
+        net::spawn(io, [&io, n](net::yield_context yield) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                sink = sink + async_1(io, 1, yield);
+            }
+        });
+        io.run();
+        io.restart();
+    });
+#endif // UFIBER_BENCH_ASIO_SPAWN
+
+    h.run("promise/0/callback", 1000000, [&](std::size_t n) {
+        run_chain(io, n, op_0{&io});
+    });
+
+    h.run("promise/1/callback", 1000000, [&](std::size_t n) {
+        run_chain(io, n, op_1{&io});
+    });
+
+    h.run("promise/3/callback", 1000000, [&](std::size_t n) {
+        run_chain(io, n, op_3{&io});
+    });
+}
+
+// Operations whose state is allocated by one thread and freed by another,
+// performed by many fibers at once
+void
+allocation_benchmarks(ufiber::bench::harness& h)
+{
+    std::size_t const fibers = 64;
+    auto const threads = h.list_option("alloc-threads", "1,4");
+
+    for (auto const t : threads)
+    {
+        net::io_context io{static_cast<int>(t)};
+        auto const run = [&io, t] {
+            std::vector<std::thread> pool;
+            for (std::size_t i = 1; i < t; ++i)
+            {
+                pool.emplace_back([&io] { io.run(); });
+            }
+            io.run();
+            for (auto& th : pool)
+            {
+                th.join();
+            }
+            io.restart();
+        };
+
+        h.run("alloc/op_state/threads:" + std::to_string(t),
+              1000000,
+              [&](std::size_t n) {
+                  auto const ops = n / fibers;
+                  for (std::size_t f = 0; f < fibers; ++f)
+                  {
+                      ufiber::spawn(io, [&io, ops](yield_token_t yield) {
+                          for (std::size_t i = 0; i < ops; ++i)
+                          {
+                              sink = sink + async_1(io, 1, yield);
+                          }
+                      });
+                  }
+                  run();
+              });
+    }
+}
+
+// Adds and removes deadlines while other fibers have deadlines pending. Each
+// run includes spawning the pending fibers.
+void
+deadline_benchmarks(ufiber::bench::harness& h)
+{
+    ufiber::stack_pool pool;
+    for (std::size_t const pending : {0, 4096})
+    {
+        h.run("deadline/arm_cancel/pending:" + std::to_string(pending),
+              1000000,
+              [&](std::size_t n) {
+                  net::io_context io{1};
+                  net::steady_timer never{io, std::chrono::hours{24}};
+                  for (std::size_t i = 0; i < pending; ++i)
+                  {
+                      ufiber::spawn(
+                        std::allocator_arg,
+                        pool.get_allocator(),
+                        io.get_executor(),
+                        [&never, i](yield_token_t yield) {
+                            never.async_wait(ufiber::with_timeout(
+                              yield,
+                              std::chrono::hours{1} +
+                                std::chrono::milliseconds{i * 7919 % 60000},
+                              [] {}));
+                        });
+                  }
+                  ufiber::spawn(io, [&never, n](yield_token_t yield) {
+                      for (std::size_t i = 0; i < n; ++i)
+                      {
+                          net::dispatch(ufiber::with_timeout(
+                            yield,
+                            std::chrono::milliseconds{1 + i * 7919 % 60000},
+                            [] {}));
+                      }
+                      never.cancel();
+                  });
+                  io.run();
+              });
+    }
+}
+
+void
+conversion_benchmarks(ufiber::bench::harness& h)
+{
+    net::io_context io{1};
+
+    h.run("convert/construct/any_executor", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [](yield_token_t yield, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                ufiber::yield_token<net::executor> erased{yield};
+                sink = sink + (erased.get_executor() == yield.get_executor());
+            }
+        });
+    });
+
+    h.run("convert/post/native_executor", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [](yield_token_t yield, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                net::post(yield);
+            }
+        });
+    });
+
+    h.run("convert/post/any_executor", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [](yield_token_t yield, std::size_t n) {
+            ufiber::yield_token<net::executor> erased{yield};
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                net::post(erased);
+            }
+        });
+    });
+
+    h.run("convert/post/any_executor_per_op", 1000000, [&](std::size_t n) {
+        in_fiber(io, n, [](yield_token_t yield, std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                net::post(ufiber::yield_token<net::executor>{yield});
+            }
+        });
+    });
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    ufiber::bench::harness h{argc, argv};
+    spawn_benchmarks(h);
+    switch_benchmarks(h);
+    promise_benchmarks(h);
+    allocation_benchmarks(h);
+    deadline_benchmarks(h);
+    conversion_benchmarks(h);
+    h.report();
+}
@@ -1,3 +1,4 @@
+#include <ufiber/stack_pool.hpp>
 #include <ufiber/ufiber.hpp>
 
 #include <boost/asio/ip/tcp.hpp>
@@ -68,6 +69,10 @@ accept(ufiber::yield_token<net::io_context::executor_type> yield)
     tcp_acceptor acceptor{
       ex.context(), net::ip::tcp::endpoint{net::ip::address_v6::any(), 8000}};
 
+    // Stacks of finished sessions are kept in a pool, so accepting a new
+    // client does not need to map and unmap a whole stack.
+    ufiber::stack_pool pool;
+
     tcp_socket s{ex.context()};
     for (;;)
     {
@@ -82,9 +87,12 @@ accept(ufiber::yield_token<net::io_context::executor_type> yield)
         }
         // Spawn a new fiber, use a function object as its entry point. Note
         // that the entry point is not copyable, but is move constructible. Here
-        // we use the overload which accepts an Executor, rather than an
-        // ExecutionContext.
-        ufiber::spawn(ex, echo_session{std::move(s)});
+        // we use the overload which accepts a StackAllocator and an Executor,
+        // rather than an ExecutionContext.
+        ufiber::spawn(std::allocator_arg,
+                      pool.get_allocator(),
+                      ex,
+                      echo_session{std::move(s)});
         // Note that a moved-from socket is guaranteed to be in a state usable
         // for `async_accept`, so we can hoist construction of `s` out of the
         // loop, because the "default" constructor of `socket` is fairly
@@ -0,0 +1,228 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_ARENA_HPP
+#define UFIBER_ARENA_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define UFIBER_HAS_MEMORY_RESOURCE
+#endif
+#endif
+
+/**
+ * @file
+ * Monotonic allocation of memory that lives as long as a fiber, or until the
+ * fiber resets it.
+ */
+
+#ifndef UFIBER_ARENA_STACK_BLOCK
+/**
+ * Size of the arena's first block, which is part of the fiber's stack.
+ */
+#define UFIBER_ARENA_STACK_BLOCK 512
+#endif // UFIBER_ARENA_STACK_BLOCK
+
+#ifndef UFIBER_ARENA_MIN_BLOCK
+/**
+ * Size of the first block that an arena allocates from the heap. Each further
+ * block is twice as large as the previous one.
+ */
+#define UFIBER_ARENA_MIN_BLOCK 4096
+#endif // UFIBER_ARENA_MIN_BLOCK
+
+namespace ufiber
+{
+
+/**
+ * A monotonic arena owned by a fiber, which is returned by
+ * `yield_token::arena()`. Allocation bumps a pointer, and deallocation does
+ * nothing. The memory is released in bulk by `reset()` or when the fiber's
+ * main function has finished, so the arena suits objects that die together,
+ * such as the strings and parse nodes of one request.
+ *
+ * The first `UFIBER_ARENA_STACK_BLOCK` bytes are part of the fiber's stack.
+ * Further blocks come from the heap and grow geometrically. An arena must
+ * only be used by its fiber, which may be resumed on different threads.
+ */
+class fiber_arena
+{
+public:
+    /// Constructs an arena whose first block is `size` bytes at `buffer`.
+    fiber_arena(void* buffer, std::size_t size) noexcept
+      : initial_{static_cast<char*>(buffer)}
+      , initial_size_{size}
+      , current_{initial_}
+      , end_{initial_ + size}
+    {
+    }
+
+    fiber_arena(fiber_arena const&) = delete;
+    fiber_arena& operator=(fiber_arena const&) = delete;
+
+    ~fiber_arena()
+    {
+        release();
+    }
+
+    /**
+     * Returns `size` bytes aligned to `align`, which must be a power of two.
+     *
+     * @throws std::bad_alloc if a new block can't be allocated.
+     */
+    void* allocate(std::size_t size,
+                   std::size_t align = alignof(std::max_align_t))
+    {
+        auto const p = align_up(current_, align);
+        if (p <= end_ && static_cast<std::size_t>(end_ - p) >= size)
+        {
+            current_ = p + size;
+            return p;
+        }
+        return grow(size, align);
+    }
+
+    /// Does nothing, the memory is reclaimed by `reset()`.
+    void deallocate(void*, std::size_t) noexcept
+    {
+    }
+
+    /**
+     * Makes all memory allocated from the arena available again. The largest
+     * heap block is kept for reuse, so an arena that is reset after each
+     * request stops allocating from the heap once it has seen the largest
+     * request.
+     */
+    UFIBER_INLINE_DECL void reset() noexcept;
+
+    /**
+     * Like `reset()`, but returns all heap blocks to the heap.
+     */
+    UFIBER_INLINE_DECL void release() noexcept;
+
+private:
+    struct block
+    {
+        block* next_;
+        std::size_t size_;
+    };
+
+    static char* align_up(char* p, std::size_t align) noexcept
+    {
+        auto const addr = reinterpret_cast<std::uintptr_t>(p);
+        return p + ((align - addr % align) % align);
+    }
+
+    UFIBER_INLINE_DECL void* grow(std::size_t size, std::size_t align);
+
+    UFIBER_INLINE_DECL void use(block* b) noexcept;
+
+    char* const initial_;
+    std::size_t const initial_size_;
+    char* current_;
+    char* end_;
+    block* blocks_ = nullptr;
+    block* spare_ = nullptr;
+};
+
+/**
+ * An Allocator that allocates from a `fiber_arena`. Deallocation does nothing.
+ */
+template<class T>
+class arena_allocator
+{
+public:
+    using value_type = T;
+
+    arena_allocator(fiber_arena& arena) noexcept
+      : arena_{&arena}
+    {
+    }
+
+    template<class U>
+    arena_allocator(arena_allocator<U> const& other) noexcept
+      : arena_{other.arena_}
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena_->allocate(sizeof(T) * n, alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) noexcept
+    {
+    }
+
+    friend bool operator==(arena_allocator const& lhs,
+                           arena_allocator const& rhs) noexcept
+    {
+        return lhs.arena_ == rhs.arena_;
+    }
+
+    friend bool operator!=(arena_allocator const& lhs,
+                           arena_allocator const& rhs) noexcept
+    {
+        return lhs.arena_ != rhs.arena_;
+    }
+
+private:
+    template<class U>
+    friend class arena_allocator;
+
+    fiber_arena* arena_;
+};
+
+#ifdef UFIBER_HAS_MEMORY_RESOURCE
+/**
+ * A `std::pmr::memory_resource` that allocates from a `fiber_arena`. Only
+ * available if the library is compiled as C++17 or later.
+ */
+class arena_resource final : public std::pmr::memory_resource
+{
+public:
+    explicit arena_resource(fiber_arena& arena) noexcept
+      : arena_{arena}
+    {
+    }
+
+private:
+    void* do_allocate(std::size_t size, std::size_t align) final
+    {
+        return arena_.allocate(size, align);
+    }
+
+    void do_deallocate(void*, std::size_t, std::size_t) final
+    {
+    }
+
+    bool do_is_equal(std::pmr::memory_resource const& other) const
+      noexcept final
+    {
+        return this == &other;
+    }
+
+    fiber_arena& arena_;
+};
+#endif // UFIBER_HAS_MEMORY_RESOURCE
+
+} // namespace ufiber
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/arena.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_ARENA_HPP
@@ -0,0 +1,214 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_CHANNEL_HPP
+#define UFIBER_CHANNEL_HPP
+
+#include <ufiber/detail/wait_queue.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/optional.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+
+/**
+ * @file
+ * Bounded channels for passing values between fibers.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Error codes reported by `channel` operations.
+ */
+enum class channel_errc
+{
+    /// The channel has been closed.
+    closed = 1
+};
+
+/**
+ * Returns the error category of `channel_errc`.
+ */
+UFIBER_INLINE_DECL boost::system::error_category const&
+channel_category() noexcept;
+
+/**
+ * Makes an error_code from a `channel_errc`.
+ */
+inline boost::system::error_code
+make_error_code(channel_errc e) noexcept
+{
+    return boost::system::error_code{static_cast<int>(e), channel_category()};
+}
+
+namespace detail
+{
+
+template<class T>
+struct channel_op : waiter_base
+{
+    using waiter_base::waiter_base;
+
+    // Holds the value of a waiting sender, receives the value of a waiting
+    // receiver.
+    boost::optional<T>* value_ = nullptr;
+    boost::system::error_code ec_;
+};
+
+} // namespace detail
+
+/**
+ * A bounded multi-producer, multi-consumer channel. Values are buffered in a
+ * ring buffer allocated when the channel is constructed. A sender finding the
+ * buffer full is suspended until a receiver makes room, so a slow consumer
+ * exerts backpressure on its producers. With a capacity of 0, every send waits
+ * for a receiver to take the value.
+ *
+ * Senders and receivers may run on different executors and threads. Suspended
+ * fibers are resumed on their own executors, in FIFO order.
+ *
+ * @tparam T the type of values, which must be MoveConstructible and
+ * DefaultConstructible.
+ */
+template<class T>
+class channel
+{
+    // receive() reports errors along with a default constructed value
+    static_assert(std::is_default_constructible<T>::value,
+                  "T must be DefaultConstructible");
+
+public:
+    /**
+     * Constructs an open channel, which buffers up to `capacity` values.
+     */
+    explicit channel(std::size_t capacity);
+
+    /**
+     * Destroys the buffered values.
+     *
+     * @pre No fiber is suspended in an operation on this channel.
+     */
+    ~channel();
+
+    channel(channel const&) = delete;
+    channel& operator=(channel const&) = delete;
+
+    /**
+     * Sends a value, suspending the calling fiber while the channel is full.
+     *
+     * @returns `channel_errc::closed` if the channel is closed before the
+     * value could be sent, in which case the value is discarded.
+     */
+    template<class Executor>
+    boost::system::error_code send(T value, yield_token<Executor>& yield);
+
+    /**
+     * Receives a value, suspending the calling fiber while the channel is
+     * empty.
+     *
+     * @returns `channel_errc::closed` and a default constructed value if the
+     * channel has been closed and all buffered values have been received.
+     */
+    template<class Executor>
+    std::tuple<boost::system::error_code, T> receive(
+      yield_token<Executor>& yield);
+
+    /**
+     * Sends a value without suspending. Returns false, and leaves `value`
+     * untouched, if the channel is full or closed.
+     */
+    bool try_send(T& value);
+
+    /**
+     * Receives a value without suspending. Returns false if no value is
+     * available.
+     */
+    bool try_receive(T& value);
+
+    /**
+     * Closes the channel. Suspended senders complete with
+     * `channel_errc::closed`. Buffered values can still be received, after
+     * which receivers complete with `channel_errc::closed` as well.
+     */
+    void close() noexcept;
+
+    /**
+     * Returns whether the channel has been closed.
+     */
+    bool is_closed() const;
+
+    /**
+     * Returns the maximum number of buffered values.
+     */
+    std::size_t capacity() const noexcept
+    {
+        return capacity_;
+    }
+
+private:
+    using storage_type =
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+    using op_type = detail::channel_op<T>;
+
+    enum class status
+    {
+        done,
+        closed,
+        would_block
+    };
+
+    status send_locked(T& value, op_type*& woken);
+    status receive_locked(boost::optional<T>& value, op_type*& woken);
+
+    T* slot(std::size_t i) noexcept
+    {
+        return reinterpret_cast<T*>(&buffer_[(head_ + i) % capacity_]);
+    }
+
+    mutable std::mutex mutex_;
+    std::unique_ptr<storage_type[]> buffer_;
+    std::size_t const capacity_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    bool closed_ = false;
+    detail::waiter_list senders_;
+    detail::waiter_list receivers_;
+};
+
+} // namespace ufiber
+
+namespace boost
+{
+namespace system
+{
+
+template<>
+struct is_error_code_enum<::ufiber::channel_errc>
+{
+    static bool const value = true;
+};
+
+} // namespace system
+} // namespace boost
+
+#include <ufiber/impl/channel.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/channel.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_CHANNEL_HPP
@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DEADLINE_HPP
+#define UFIBER_DEADLINE_HPP
+
+#include <ufiber/detail/deadline.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <chrono>
+#include <type_traits>
+
+/**
+ * @file
+ * Deadlines for asynchronous operations of a fiber, and timed sleeps.
+ */
+
+namespace ufiber
+{
+
+/**
+ * A CompletionToken that suspends the fiber like `yield_token`, and cancels
+ * the operation if it is still pending at a deadline.
+ *
+ * Cancellation is performed by invoking a function object supplied by the
+ * caller, which usually calls `cancel()` on the I/O object the operation was
+ * started on, so that the operation completes with
+ * `boost::asio::error::operation_aborted`. The function object is invoked at
+ * most once, on a thread that runs the timers of the fiber's execution
+ * context, while the fiber is suspended in the operation. It must not throw
+ * and must not wait for the operation to complete.
+ *
+ * Deadlines of all fibers of an `io_context` are kept in a hierarchical timing
+ * wheel, where adding and removing a deadline takes constant time. The wheel
+ * shares a single timer, which is re-armed only when a deadline earlier than
+ * all pending ones is added. Deadlines are rounded up to the wheel's tick of
+ * `UFIBER_DEADLINE_TICK_US` microseconds, which defaults to 1000, and all
+ * deadlines of a tick expire together.
+ *
+ * Objects of this type are created by `with_deadline` and `with_timeout`.
+ */
+template<class Executor, class Cancel>
+class deadline_token
+{
+public:
+    /**
+     * Executor type associated with this deadline_token object.
+     */
+    using executor_type = Executor;
+
+    /**
+     * Clock used to express deadlines.
+     */
+    using clock_type = std::chrono::steady_clock;
+
+    deadline_token(yield_token<Executor> const& yield,
+                   clock_type::time_point expiry,
+                   Cancel&& cancel)
+      : yield_{yield}
+      , expiry_{expiry}
+      , cancel_{std::move(cancel)}
+    {
+    }
+
+    /**
+     * Returns the executor object associated with this deadline_token object.
+     */
+    executor_type get_executor() noexcept
+    {
+        return yield_.get_executor();
+    }
+
+private:
+    template<class T, class Signature>
+    friend class boost::asio::async_result;
+
+    yield_token<Executor> yield_;
+    clock_type::time_point expiry_;
+    Cancel cancel_;
+};
+
+/**
+ * Returns a CompletionToken that cancels an operation of the calling fiber
+ * if the operation is still pending at `expiry`.
+ *
+ * @param yield the yield_token of the calling fiber.
+ * @param expiry the point in time after which the operation is cancelled.
+ * @param cancel a function object that cancels the operation.
+ */
+template<class Executor, class Cancel>
+deadline_token<Executor, typename std::decay<Cancel>::type>
+with_deadline(yield_token<Executor> const& yield,
+              std::chrono::steady_clock::time_point expiry,
+              Cancel&& cancel);
+
+/**
+ * Returns a CompletionToken that cancels an operation of the calling fiber if
+ * the operation is still pending `timeout` after it has been started.
+ *
+ * @param yield the yield_token of the calling fiber.
+ * @param timeout the time the operation is given to complete.
+ * @param cancel a function object that cancels the operation.
+ */
+template<class Executor, class Rep, class Period, class Cancel>
+deadline_token<Executor, typename std::decay<Cancel>::type>
+with_timeout(yield_token<Executor> const& yield,
+             std::chrono::duration<Rep, Period> timeout,
+             Cancel&& cancel);
+
+/**
+ * Suspends the calling fiber until `expiry`. The fiber is resumed on its
+ * executor, no earlier than `expiry` and no later than the end of the tick
+ * that contains it. Sleeping fibers share the timing wheel and timer of
+ * `with_deadline`, so a sleep doesn't need a timer object of its own.
+ *
+ * @throws broken_promise if the execution context is shut down before the
+ * fiber wakes up.
+ */
+template<class Executor>
+void
+sleep_until(yield_token<Executor>& yield,
+            std::chrono::steady_clock::time_point expiry);
+
+/**
+ * Suspends the calling fiber for at least `duration`, like `sleep_until()`.
+ */
+template<class Executor, class Rep, class Period>
+void
+sleep_for(yield_token<Executor>& yield,
+          std::chrono::duration<Rep, Period> duration);
+
+} // namespace ufiber
+
+#include <ufiber/impl/deadline.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/deadline.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_DEADLINE_HPP
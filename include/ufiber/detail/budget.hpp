@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_BUDGET_HPP
+#define UFIBER_DETAIL_BUDGET_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#include <chrono>
+#include <cstddef>
+
+#ifndef UFIBER_BUDGET_OPERATIONS
+#define UFIBER_BUDGET_OPERATIONS 0
+#endif // UFIBER_BUDGET_OPERATIONS
+
+#ifndef UFIBER_BUDGET_MICROSECONDS
+#define UFIBER_BUDGET_MICROSECONDS 0
+#endif // UFIBER_BUDGET_MICROSECONDS
+
+namespace ufiber
+{
+namespace detail
+{
+
+// How much a fiber may do between two suspensions before its next operation
+// yields to the executor first. A limit of zero is disabled, and the clock is
+// only read if the time limit is enabled.
+class run_budget
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    run_budget() noexcept
+      : operations_{UFIBER_BUDGET_OPERATIONS}
+      , time_{UFIBER_BUDGET_MICROSECONDS}
+    {
+        restart();
+    }
+
+    void set(std::size_t operations, std::chrono::microseconds time) noexcept
+    {
+        operations_ = operations;
+        time_ = time;
+        restart();
+    }
+
+    std::size_t operations() const noexcept
+    {
+        return operations_;
+    }
+
+    std::chrono::microseconds time() const noexcept
+    {
+        return time_;
+    }
+
+    // Called whenever the fiber has been resumed after a suspension
+    void restart() noexcept
+    {
+        used_ = 0;
+        if (time_.count() != 0)
+        {
+            start_ = clock_type::now();
+        }
+    }
+
+    // Called for each operation that completed without suspending the fiber
+    void on_inline_completion() noexcept
+    {
+        ++used_;
+    }
+
+    bool exhausted() const noexcept
+    {
+        return (operations_ != 0 && used_ >= operations_) ||
+               (time_.count() != 0 && clock_type::now() - start_ >= time_);
+    }
+
+private:
+    std::size_t operations_;
+    std::chrono::microseconds time_;
+    std::size_t used_ = 0;
+    clock_type::time_point start_;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_BUDGET_HPP
@@ -0,0 +1,379 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_DEADLINE_HPP
+#define UFIBER_DETAIL_DEADLINE_HPP
+
+#include <ufiber/detail/config.hpp>
+#include <ufiber/detail/ufiber.hpp>
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#ifndef UFIBER_DEADLINE_TICK_US
+#define UFIBER_DEADLINE_TICK_US 1000
+#endif // UFIBER_DEADLINE_TICK_US
+
+namespace ufiber
+{
+namespace detail
+{
+
+// A deadline of a pending operation. Entries live in the frame of the
+// suspended fiber.
+struct deadline_entry
+{
+    using clock = std::chrono::steady_clock;
+    static constexpr unsigned char unlinked = 0xff;
+    // In the service's list of entries whose cancellers are due
+    static constexpr unsigned char expired = 0xfe;
+
+    deadline_entry(clock::time_point expiry,
+                   void (*fire)(deadline_entry*)) noexcept
+      : expiry_{expiry}
+      , fire_{fire}
+    {
+    }
+
+    clock::time_point expiry_;
+    // Invoked after the service's lock has been released. Null for a
+    // sleep_entry.
+    void (*fire_)(deadline_entry*);
+    // Links of the wheel slot the entry is in, or of a list of expired entries
+    deadline_entry* prev_ = nullptr;
+    deadline_entry* next_ = nullptr;
+    std::uint64_t tick_ = 0;
+    unsigned char level_ = unlinked;
+    unsigned char slot_ = 0;
+};
+
+template<class Cancel>
+struct deadline_op : deadline_entry
+{
+    deadline_op(clock::time_point expiry, Cancel& cancel) noexcept
+      : deadline_entry{expiry, &deadline_op::do_fire}
+      , cancel_{cancel}
+    {
+    }
+
+    static void do_fire(deadline_entry* base)
+    {
+        static_cast<deadline_op*>(base)->cancel_();
+    }
+
+    Cancel& cancel_;
+};
+
+// The deadline of a sleeping fiber. Its handler is invoked after the service's
+// lock has been released, because that may resume the fiber on the spot.
+struct sleep_entry : deadline_entry
+{
+    sleep_entry(clock::time_point expiry,
+                void (*wake)(sleep_entry*, bool)) noexcept
+      : deadline_entry{expiry, nullptr}
+      , wake_{wake}
+    {
+    }
+
+    // Completes the sleep, or abandons it if the second argument is false
+    void (*wake_)(sleep_entry*, bool);
+};
+
+template<class Executor>
+struct sleep_op : sleep_entry
+{
+    sleep_op(clock::time_point expiry,
+             promise<>& p,
+             yield_token<Executor>& yield) noexcept
+      : sleep_entry{expiry, &sleep_op::do_wake}
+      , promise_{p}
+      , yield_{yield}
+      , work_{yield.get_executor()}
+    {
+    }
+
+    static void do_wake(sleep_entry* base, bool expired)
+    {
+        auto const self = static_cast<sleep_op*>(base);
+        // Once the handler has been dispatched or destroyed, the fiber may
+        // return from its sleep and destroy `self`.
+        auto work = std::move(self->work_);
+        completion_handler<Executor> handler{
+          &self->promise_, self->yield_, detail::get_fiber(self->yield_)};
+        if (expired)
+        {
+            boost::asio::dispatch(std::move(handler));
+        }
+    }
+
+    promise<>& promise_;
+    yield_token<Executor> yield_;
+    // A sleeping fiber keeps its executor running, like a pending operation
+    boost::asio::executor_work_guard<Executor> work_;
+};
+
+// A hierarchical timing wheel with 4 levels of 64 slots each. Level 0 holds
+// the entries that expire within the next 64 ticks, one slot per tick, and
+// each further level covers 64 times the range of the one below. Insertion
+// and removal are O(1). An entry of a higher level moves down when the wheel
+// reaches the start of its slot's range, and entries further away than the
+// top level can hold are placed in its last slot until they're in range.
+// Expirations are batched by tick.
+class timer_wheel
+{
+public:
+    using tick_type = std::uint64_t;
+
+    static constexpr unsigned bits = 6;
+    static constexpr unsigned levels = 4;
+    static constexpr tick_type slots = tick_type{1} << bits;
+
+    bool empty() const noexcept
+    {
+        return size_ == 0;
+    }
+
+    tick_type now() const noexcept
+    {
+        return now_;
+    }
+
+    // Inserts an entry that expires at tick `t`, or at the next tick if `t`
+    // has already been reached. Returns the tick at which the wheel has to be
+    // advanced next on behalf of the entry.
+    UFIBER_INLINE_DECL tick_type insert(deadline_entry* e,
+                                        tick_type t) noexcept;
+
+    UFIBER_INLINE_DECL void erase(deadline_entry* e) noexcept;
+
+    // Moves the wheel to tick `t` and returns the entries that have expired on
+    // the way, linked through their `next_` member in order of expiry.
+    UFIBER_INLINE_DECL deadline_entry* advance(tick_type t) noexcept;
+
+    // Unlinks and returns all entries, like advance()
+    UFIBER_INLINE_DECL deadline_entry* clear() noexcept;
+
+    // The tick at which advance() has work to do. The wheel must not be empty.
+    UFIBER_INLINE_DECL tick_type next_tick() const noexcept;
+
+private:
+    static std::uint64_t rotate_right(std::uint64_t x, unsigned n) noexcept
+    {
+        n &= 63;
+        return n == 0 ? x : (x >> n) | (x << (64 - n));
+    }
+
+    static unsigned lowest_bit(std::uint64_t x) noexcept
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned>(__builtin_ctzll(x));
+#else
+        unsigned n = 0;
+        while ((x & 1) == 0)
+        {
+            x >>= 1;
+            ++n;
+        }
+        return n;
+#endif // defined(__GNUC__)
+    }
+
+    UFIBER_INLINE_DECL tick_type place(deadline_entry* e) noexcept;
+
+    UFIBER_INLINE_DECL void cascade(unsigned level) noexcept;
+
+    // Unlinks all entries of a slot and appends them to `tail`
+    UFIBER_INLINE_DECL void take(unsigned level,
+                                 tick_type slot,
+                                 deadline_entry**& tail) noexcept;
+
+    deadline_entry* slots_[levels][slots] = {};
+    std::uint64_t occupied_[levels] = {};
+    tick_type now_ = 0;
+    std::size_t size_ = 0;
+};
+
+// The key that boost::asio::use_service() looks services up by. A template, so
+// that the static member can be defined in a header.
+template<class Service>
+struct service_id
+{
+    static boost::asio::execution_context::id id;
+};
+
+template<class Service>
+boost::asio::execution_context::id service_id<Service>::id;
+
+// Shares one steady_timer between all pending deadlines of an io_context. The
+// deadlines are kept in a timer_wheel, and the timer is re-armed only when an
+// entry needs the wheel to advance earlier than the armed tick, so operations
+// that are given the same timeout don't touch the timer queue. Expiries are
+// rounded up to the next tick, so a deadline never fires early.
+class deadline_service
+  : public boost::asio::execution_context::service
+  , public service_id<deadline_service>
+{
+public:
+    using clock = deadline_entry::clock;
+
+    UFIBER_INLINE_DECL explicit deadline_service(boost::asio::io_context& io);
+
+    // Invokes `start()` and registers an entry for the operation it has
+    // started. The operation is started without the lock, so that operations
+    // with deadlines don't serialize on it, and an initiation that completes
+    // another fiber inline can't deadlock. Since the entry is only inserted
+    // afterwards, a cancellation never precedes the start of its operation,
+    // and the timer is armed once the operation counts as outstanding work of
+    // its io_context.
+    template<class Start>
+    void add(deadline_entry& e, Start&& start)
+    {
+        start();
+        insert(e);
+    }
+
+    // Unlinks an entry. If its canceller is running on another thread, waits
+    // for it to return.
+    UFIBER_INLINE_DECL void remove(deadline_entry& e) noexcept;
+
+private:
+    struct wait_handler
+    {
+        void operator()(boost::system::error_code const& ec)
+        {
+            svc_.on_timer(ec);
+        }
+
+        deadline_service& svc_;
+    };
+
+    // An entry whose canceller is running without the lock
+    struct firing
+    {
+        deadline_entry* entry_;
+        std::thread::id thread_;
+        firing* next_;
+    };
+
+    UFIBER_INLINE_DECL void shutdown() override;
+
+    UFIBER_INLINE_DECL void insert(deadline_entry& e);
+
+    UFIBER_INLINE_DECL void arm(clock::time_point expiry);
+
+    // The list of expired entries whose cancellers haven't been invoked yet
+    UFIBER_INLINE_DECL void push_expired(deadline_entry* e) noexcept;
+
+    UFIBER_INLINE_DECL void erase_expired(deadline_entry* e) noexcept;
+
+    // Invokes the cancellers of the expired entries, one at a time
+    UFIBER_INLINE_DECL void fire_expired();
+
+    UFIBER_INLINE_DECL void on_timer(boost::system::error_code const& ec);
+
+    // Completes the sleeps in a list of expired entries
+    UFIBER_INLINE_DECL void wake(deadline_entry* sleepers);
+
+    // A constant, so that dividing by it compiles to a multiplication
+    static constexpr clock::rep tick_length() noexcept
+    {
+        return std::chrono::duration_cast<clock::duration>(
+                 std::chrono::microseconds{UFIBER_DEADLINE_TICK_US})
+          .count();
+    }
+
+    timer_wheel::tick_type tick_at(clock::time_point t) const noexcept
+    {
+        return t <= epoch_ ? 0 : static_cast<timer_wheel::tick_type>(
+                                   (t - epoch_).count() / tick_length());
+    }
+
+    // Rounds up, without overflowing for time_point::max()
+    timer_wheel::tick_type expiry_tick(clock::time_point t) const noexcept
+    {
+        if (t <= epoch_)
+        {
+            return 0;
+        }
+        auto const d = (t - epoch_).count();
+        return static_cast<timer_wheel::tick_type>(d / tick_length() +
+                                                   (d % tick_length() != 0));
+    }
+
+    clock::time_point time_of(timer_wheel::tick_type t) const noexcept
+    {
+        return epoch_ +
+               clock::duration{tick_length() * static_cast<clock::rep>(t)};
+    }
+
+    boost::asio::io_context& io_;
+    std::mutex mutex_;
+    timer_wheel wheel_;
+    clock::time_point const epoch_ = clock::now();
+    boost::asio::steady_timer timer_;
+    clock::time_point armed_ = clock::time_point::max();
+    deadline_entry* expired_ = nullptr;
+    firing* firing_ = nullptr;
+    std::condition_variable fired_;
+};
+
+// Removes the entry of an operation from its service once the fiber leaves
+// the frame that holds it, including by an exception.
+class deadline_scope
+{
+public:
+    deadline_scope(deadline_service& svc, deadline_entry& e) noexcept
+      : svc_{svc}
+      , e_{e}
+    {
+    }
+
+    deadline_scope(deadline_scope const&) = delete;
+    deadline_scope& operator=(deadline_scope const&) = delete;
+
+    ~deadline_scope()
+    {
+        svc_.remove(e_);
+    }
+
+private:
+    deadline_service& svc_;
+    deadline_entry& e_;
+};
+
+// The io_context that runs the timers of an execution context: the context
+// itself, or the reactor of a context that has one.
+inline boost::asio::io_context&
+timer_context(boost::asio::io_context& ctx) noexcept
+{
+    return ctx;
+}
+
+template<class Context>
+auto
+timer_context(Context& ctx) noexcept -> decltype(ctx.reactor())
+{
+    return ctx.reactor();
+}
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_DEADLINE_HPP
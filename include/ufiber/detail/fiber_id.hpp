@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_FIBER_ID_HPP
+#define UFIBER_DETAIL_FIBER_ID_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace ufiber
+{
+namespace detail
+{
+
+// Fibers are numbered from 1 in the order they were started, so that the IDs
+// in a trace match those in a registry dump.
+inline std::uint64_t
+next_fiber_id() noexcept
+{
+    static std::atomic<std::uint64_t> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_FIBER_ID_HPP
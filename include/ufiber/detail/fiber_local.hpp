@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_FIBER_LOCAL_HPP
+#define UFIBER_DETAIL_FIBER_LOCAL_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#ifndef UFIBER_FIBER_LOCAL_SLOTS
+#define UFIBER_FIBER_LOCAL_SLOTS 8
+#endif // UFIBER_FIBER_LOCAL_SLOTS
+
+namespace ufiber
+{
+namespace detail
+{
+
+struct local_slot
+{
+    void* value_ = nullptr;
+    void (*destroy_)(void*) = nullptr;
+    // The id of the fiber_local that has created the value
+    std::uint64_t owner_ = 0;
+};
+
+// Values of the fiber_local objects used by a fiber, indexed by the index of
+// the fiber_local. The first slots are stored inline, so a fiber that uses
+// only a few fiber_locals doesn't allocate the slot array.
+class fiber_locals
+{
+public:
+    fiber_locals() = default;
+    fiber_locals(fiber_locals const&) = delete;
+    fiber_locals& operator=(fiber_locals const&) = delete;
+
+    ~fiber_locals()
+    {
+        clear();
+    }
+
+    local_slot* find(std::size_t index) noexcept
+    {
+        if (index < UFIBER_FIBER_LOCAL_SLOTS)
+        {
+            return &inline_[index];
+        }
+        index -= UFIBER_FIBER_LOCAL_SLOTS;
+        return index < overflow_.size() ? &overflow_[index] : nullptr;
+    }
+
+    local_slot& get(std::size_t index)
+    {
+        auto const s = find(index);
+        if (s != nullptr)
+        {
+            return *s;
+        }
+        overflow_.resize(index - UFIBER_FIBER_LOCAL_SLOTS + 1);
+        return overflow_.back();
+    }
+
+    // Destroys the value of a slot, if it has one
+    void destroy(std::size_t index) noexcept
+    {
+        auto const s = find(index);
+        if (s == nullptr || s->value_ == nullptr)
+        {
+            return;
+        }
+        auto const value = s->value_;
+        auto const destroy = s->destroy_;
+        s->value_ = nullptr;
+        s->destroy_ = nullptr;
+        destroy(value);
+    }
+
+    // Destroys all values. Destructors that create new values are handled
+    // by repeating the pass a bounded number of times.
+    UFIBER_INLINE_DECL void clear() noexcept;
+
+private:
+    local_slot inline_[UFIBER_FIBER_LOCAL_SLOTS];
+    std::vector<local_slot> overflow_;
+};
+
+struct local_key
+{
+    std::size_t index_;
+    std::uint64_t id_;
+};
+
+// Hands out the slot indices of fiber_local objects. The index of a destroyed
+// fiber_local is reused under a new id, so that a value a fiber still holds
+// for the old object isn't mistaken for one of the new object. Such a value
+// is destroyed when its slot is written again or the fiber finishes. Reuse
+// keeps the slot arrays as large as the number of live fiber_locals.
+class local_registry
+{
+public:
+    static local_registry& instance() noexcept
+    {
+        static local_registry r;
+        return r;
+    }
+
+    UFIBER_INLINE_DECL local_key acquire() noexcept;
+
+    UFIBER_INLINE_DECL void release(std::size_t index) noexcept;
+
+private:
+    local_registry() = default;
+
+    std::mutex mutex_;
+    std::vector<std::size_t> free_;
+    std::size_t next_index_ = 0;
+    std::uint64_t next_id_ = 1;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_FIBER_LOCAL_HPP
@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_HANDLER_SLAB_HPP
+#define UFIBER_DETAIL_HANDLER_SLAB_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#ifndef UFIBER_HANDLER_SLAB_SIZE
+#define UFIBER_HANDLER_SLAB_SIZE 256
+#endif // UFIBER_HANDLER_SLAB_SIZE
+
+namespace ufiber
+{
+namespace detail
+{
+
+// Memory for the state of the operation a fiber is waiting for. Asio frees
+// an operation's state before invoking its handler, so the block is free
+// again by the time the fiber starts its next operation. States that are too
+// large, or that are allocated while the block is taken, come from the heap.
+class handler_slab
+{
+public:
+    handler_slab() = default;
+    handler_slab(handler_slab const&) = delete;
+    handler_slab& operator=(handler_slab const&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align)
+    {
+        if (size <= sizeof(storage_) && align <= alignof(storage_type) &&
+            !used_.exchange(true, std::memory_order_acquire))
+        {
+            return &storage_;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* p) noexcept
+    {
+        if (p == &storage_)
+        {
+            used_.store(false, std::memory_order_release);
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+private:
+    using storage_type =
+      typename std::aligned_storage<UFIBER_HANDLER_SLAB_SIZE>::type;
+
+    storage_type storage_;
+    std::atomic<bool> used_{false};
+};
+
+// The associated allocator of a fiber's completion handlers
+template<class T>
+class slab_allocator
+{
+public:
+    using value_type = T;
+
+    explicit slab_allocator(handler_slab& slab) noexcept
+      : slab_{&slab}
+    {
+    }
+
+    template<class U>
+    slab_allocator(slab_allocator<U> const& other) noexcept
+      : slab_{other.slab_}
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(slab_->allocate(sizeof(T) * n, alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept
+    {
+        slab_->deallocate(p);
+    }
+
+    friend bool operator==(slab_allocator const& lhs,
+                           slab_allocator const& rhs) noexcept
+    {
+        return lhs.slab_ == rhs.slab_;
+    }
+
+    friend bool operator!=(slab_allocator const& lhs,
+                           slab_allocator const& rhs) noexcept
+    {
+        return lhs.slab_ != rhs.slab_;
+    }
+
+private:
+    template<class U>
+    friend class slab_allocator;
+
+    handler_slab* slab_;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_HANDLER_SLAB_HPP
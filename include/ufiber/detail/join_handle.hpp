@@ -0,0 +1,269 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_JOIN_HANDLE_HPP
+#define UFIBER_DETAIL_JOIN_HANDLE_HPP
+
+#include <ufiber/detail/config.hpp>
+#include <ufiber/detail/ufiber.hpp>
+#include <ufiber/detail/wait_queue.hpp>
+
+#include <boost/context/stack_context.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+#include <boost/optional.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace ufiber
+{
+
+template<class T>
+class join_handle;
+
+namespace detail
+{
+
+template<class F, class Executor>
+using spawn_result_t = typename std::decay<decltype(
+  std::declval<typename std::decay<F>::type&>()(
+    std::declval<yield_token<Executor>>()))>::type;
+
+// State shared by a joinable fiber and its handle. It is placed at the top of
+// the fiber's stack allocation, and the stack is deallocated once both the
+// fiber has exited and the handle has released it.
+class join_state_base
+{
+public:
+    explicit join_state_base(void (*deallocate)(join_state_base*)) noexcept
+      : deallocate_{deallocate}
+    {
+    }
+
+    join_state_base(join_state_base const&) = delete;
+    join_state_base& operator=(join_state_base const&) = delete;
+
+    bool done() const noexcept
+    {
+        return done_.load(std::memory_order_acquire);
+    }
+
+    void set_exception(std::exception_ptr e) noexcept
+    {
+        exception_ = std::move(e);
+    }
+
+    // Completes `w` once the fiber has finished
+    UFIBER_INLINE_DECL void wait(waiter_base* w) noexcept;
+
+    // Called by the fiber after it has stored its result
+    UFIBER_INLINE_DECL void finish() noexcept;
+
+    void release() noexcept
+    {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            deallocate_(this);
+        }
+    }
+
+protected:
+    ~join_state_base() = default;
+
+    std::exception_ptr exception_;
+
+private:
+    std::atomic<int> refs_{2};
+    std::atomic<bool> done_{false};
+    std::mutex mutex_;
+    waiter_base* joiner_ = nullptr;
+    void (*deallocate_)(join_state_base*);
+};
+
+template<class T>
+class join_state : public join_state_base
+{
+public:
+    using join_state_base::join_state_base;
+
+    template<class F, class Token>
+    void run(F& f, Token&& token)
+    {
+        value_.emplace(f(std::forward<Token>(token)));
+    }
+
+    T get()
+    {
+        if (exception_)
+        {
+            std::rethrow_exception(exception_);
+        }
+        return std::move(*value_);
+    }
+
+protected:
+    ~join_state() = default;
+
+private:
+    boost::optional<T> value_;
+};
+
+template<>
+class join_state<void> : public join_state_base
+{
+public:
+    using join_state_base::join_state_base;
+
+    template<class F, class Token>
+    void run(F& f, Token&& token)
+    {
+        f(std::forward<Token>(token));
+    }
+
+    void get()
+    {
+        if (exception_)
+        {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+protected:
+    ~join_state() = default;
+};
+
+// Remembers the stack allocation that the state lives in, so that whichever
+// side releases the state last can return the stack to its allocator.
+template<class T, class StackAllocator>
+class stack_join_state final : public join_state<T>
+{
+public:
+    stack_join_state(StackAllocator const& sa,
+                     boost::context::stack_context const& sctx) noexcept
+      : join_state<T>{&stack_join_state::do_deallocate}
+      , sa_{sa}
+      , sctx_{sctx}
+    {
+    }
+
+private:
+    static void do_deallocate(join_state_base* base) noexcept
+    {
+        auto const self = static_cast<stack_join_state*>(base);
+        auto sa = std::move(self->sa_);
+        auto sctx = self->sctx_;
+        self->~stack_join_state();
+        sa.deallocate(sctx);
+    }
+
+    StackAllocator sa_;
+    boost::context::stack_context sctx_;
+};
+
+// StackAllocator handed to boost::context for a joinable fiber. When the fiber
+// exits, only the fiber's reference to the state is released.
+struct join_stack
+{
+    void deallocate(boost::context::stack_context&) noexcept
+    {
+        state_->release();
+    }
+
+    join_state_base* state_;
+};
+
+template<class F, class T>
+struct joinable_main
+{
+    template<class Executor>
+    void operator()(yield_token<Executor> token)
+    {
+        BOOST_TRY
+        {
+            state_->run(f_, std::move(token));
+        }
+        BOOST_CATCH(broken_promise const&)
+        {
+            state_->set_exception(std::current_exception());
+            state_->finish();
+            BOOST_RETHROW
+        }
+        BOOST_CATCH(...)
+        {
+            state_->set_exception(std::current_exception());
+        }
+        BOOST_CATCH_END
+        state_->finish();
+    }
+
+    F f_;
+    join_state<T>* state_;
+};
+
+template<class T, class Alloc, class Executor, class F>
+join_state<T>*
+spawn_joinable_fiber(Alloc&& sa, Executor const& ex, F&& f)
+{
+    using alloc_type = typename std::decay<Alloc>::type;
+    using state_type = stack_join_state<T, alloc_type>;
+    using fn_type = joinable_main<typename std::decay<F>::type, T>;
+
+    reclaim_list* reclaimer = detail::reclaimer_of(sa, 0);
+    auto const sctx = sa.allocate();
+    // The state takes the top of the stack, below which boost::context places
+    // the fiber's control structures and the first frame.
+    auto const top = reinterpret_cast<std::uintptr_t>(sctx.sp);
+    auto const align = alignof(state_type) > 16 ? alignof(state_type) : 16;
+    auto const addr = (top - sizeof(state_type)) & ~(align - 1);
+    auto inner = sctx;
+    inner.sp = reinterpret_cast<void*>(addr);
+    inner.size = sctx.size - (top - addr);
+
+    // Owns the stack from here on
+    auto const state = ::new (inner.sp) state_type{sa, sctx};
+    boost::context::fiber fiber;
+    BOOST_TRY
+    {
+        fiber = boost::context::fiber{
+          std::allocator_arg,
+          boost::context::preallocated{inner.sp, inner.size, sctx},
+          join_stack{state},
+          fiber_main<fn_type, Executor>{
+            fn_type{std::forward<F>(f), state},
+            ex,
+            inner,
+            reclaimer,
+            start_mode::post}};
+    }
+    BOOST_CATCH(...)
+    {
+        // The fiber was never created, so neither reference has been handed
+        // out, and releasing both returns the stack
+        state->release();
+        state->release();
+        BOOST_RETHROW
+    }
+    BOOST_CATCH_END
+    UFIBER_STATS(detail::stats_on_spawn(inner.size));
+    detail::initial_resume(std::move(fiber));
+    return state;
+}
+
+template<class T, class Alloc, class Executor, class F>
+join_handle<T>
+make_join_handle(Alloc&& sa, Executor const& ex, F&& f);
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_JOIN_HANDLE_HPP
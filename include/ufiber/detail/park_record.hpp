@@ -0,0 +1,162 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_PARK_RECORD_HPP
+#define UFIBER_DETAIL_PARK_RECORD_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#include <boost/context/stack_context.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace ufiber
+{
+
+class stack_reclaimer;
+
+namespace detail
+{
+
+class park_record;
+
+// List of fibers whose stacks may be trimmed while they are suspended.
+// Insertion and removal happen once per fiber, the switch path only touches
+// the atomic state of a fiber's own record.
+class reclaim_list
+{
+public:
+    reclaim_list() = default;
+    reclaim_list(reclaim_list const&) = delete;
+    reclaim_list& operator=(reclaim_list const&) = delete;
+
+private:
+    friend class park_record;
+    friend class ::ufiber::stack_reclaimer;
+
+    std::mutex mutex_;
+    park_record* head_ = nullptr;
+};
+
+// Tracks whether a fiber is parked and where its stack pointer was when it was
+// parked. A record that is not enrolled in a reclaim_list costs a single
+// branch per context switch.
+class park_record
+{
+public:
+    enum state : unsigned char
+    {
+        running,
+        parked,
+        trimming,
+        trimmed,
+    };
+
+    park_record(reclaim_list* list,
+                boost::context::stack_context const& sctx) noexcept
+      : list_{list}
+      , stack_{sctx}
+    {
+        if (list_ == nullptr)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock{list_->mutex_};
+        next_ = list_->head_;
+        if (next_ != nullptr)
+        {
+            next_->prev_ = this;
+        }
+        list_->head_ = this;
+    }
+
+    park_record(park_record const&) = delete;
+    park_record& operator=(park_record const&) = delete;
+
+    ~park_record()
+    {
+        if (list_ == nullptr)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock{list_->mutex_};
+        if (prev_ != nullptr)
+        {
+            prev_->next_ = next_;
+        }
+        else
+        {
+            list_->head_ = next_;
+        }
+        if (next_ != nullptr)
+        {
+            next_->prev_ = prev_;
+        }
+    }
+
+    bool enrolled() const noexcept
+    {
+        return list_ != nullptr;
+    }
+
+    // Called on the resuming side, after the fiber's stack has been switched
+    // away from. `sp` is an address on the fiber's stack at the point where
+    // it suspended.
+    void park(void* sp) noexcept
+    {
+        sp_ = sp;
+        since_.store(
+          std::chrono::steady_clock::now().time_since_epoch().count(),
+          std::memory_order_relaxed);
+        state_.store(parked, std::memory_order_release);
+    }
+
+    // Called right before the fiber is resumed. If the stack is being trimmed
+    // at the moment, waits until the trimming is done.
+    void unpark() noexcept
+    {
+        for (;;)
+        {
+            auto s = state_.load(std::memory_order_relaxed);
+            if (s == running)
+            {
+                return;
+            }
+            if (s == trimming)
+            {
+                std::this_thread::yield();
+            }
+            else if (state_.compare_exchange_weak(
+                       s, running, std::memory_order_acquire))
+            {
+                return;
+            }
+        }
+    }
+
+private:
+    friend class ::ufiber::stack_reclaimer;
+
+    reclaim_list* const list_;
+    boost::context::stack_context const stack_;
+    park_record* prev_ = nullptr;
+    park_record* next_ = nullptr;
+    void* sp_ = nullptr;
+    std::atomic<std::chrono::steady_clock::rep> since_{0};
+    std::atomic<state> state_{running};
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_PARK_RECORD_HPP
@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_REGISTRY_HPP
+#define UFIBER_DETAIL_REGISTRY_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#ifdef UFIBER_ENABLE_REGISTRY
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <typeinfo>
+
+#define UFIBER_REGISTRY(expr) expr
+
+namespace ufiber
+{
+namespace detail
+{
+
+class fiber_registry;
+
+// Describes a live fiber. Lives in the fiber's `fiber_context`, i.e. on the
+// fiber's own stack, and is linked into the registry for as long as the fiber
+// runs. Fields that change while the fiber runs are atomic, so that they can
+// be read by a dump on another thread.
+class fiber_record
+{
+public:
+    enum state_type
+    {
+        running,
+        suspended
+    };
+
+    UFIBER_INLINE_DECL explicit fiber_record(std::uint64_t id) noexcept;
+    UFIBER_INLINE_DECL ~fiber_record();
+
+    fiber_record(fiber_record const&) = delete;
+    fiber_record& operator=(fiber_record const&) = delete;
+
+    void set_name(char const* name) noexcept
+    {
+        name_.store(name, std::memory_order_relaxed);
+    }
+
+    void set_executor(std::type_info const& executor) noexcept
+    {
+        executor_.store(&executor, std::memory_order_relaxed);
+    }
+
+    void wait_for(std::type_info const& op,
+                  std::type_info const& signature) noexcept
+    {
+        operation_.store(&op, std::memory_order_relaxed);
+        signature_.store(&signature, std::memory_order_relaxed);
+    }
+
+    void on_suspend() noexcept
+    {
+        state_.store(suspended, std::memory_order_relaxed);
+    }
+
+    void on_resume() noexcept
+    {
+        resumed_at_.store(now(), std::memory_order_relaxed);
+        state_.store(running, std::memory_order_relaxed);
+    }
+
+    static std::int64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+
+private:
+    friend class fiber_registry;
+
+    fiber_record* prev_ = nullptr;
+    fiber_record* next_ = nullptr;
+    std::uint64_t id_;
+    std::atomic<char const*> name_{nullptr};
+    std::atomic<std::type_info const*> executor_{nullptr};
+    std::atomic<std::type_info const*> operation_{nullptr};
+    std::atomic<std::type_info const*> signature_{nullptr};
+    std::atomic<state_type> state_{running};
+    std::atomic<std::int64_t> resumed_at_;
+};
+
+class fiber_registry
+{
+public:
+    UFIBER_INLINE_DECL static fiber_registry& instance() noexcept;
+
+    // Calls `f(id, name, state, resumed_at, executor, operation, signature)`
+    // for each live fiber, with the registry locked.
+    template<class F>
+    void for_each(F&& f)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        for (auto r = head_; r != nullptr; r = r->next_)
+        {
+            f(r->id_,
+              r->name_.load(std::memory_order_relaxed),
+              r->state_.load(std::memory_order_relaxed),
+              r->resumed_at_.load(std::memory_order_relaxed),
+              r->executor_.load(std::memory_order_relaxed),
+              r->operation_.load(std::memory_order_relaxed),
+              r->signature_.load(std::memory_order_relaxed));
+        }
+    }
+
+private:
+    friend class fiber_record;
+
+    std::mutex mutex_;
+    fiber_record* head_ = nullptr;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#else // UFIBER_ENABLE_REGISTRY
+
+#define UFIBER_REGISTRY(expr)
+
+#endif // UFIBER_ENABLE_REGISTRY
+
+#endif // UFIBER_DETAIL_REGISTRY_HPP
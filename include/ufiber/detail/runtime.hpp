@@ -0,0 +1,214 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_RUNTIME_HPP
+#define UFIBER_DETAIL_RUNTIME_HPP
+
+#include <ufiber/deadline.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+
+#include <chrono>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#ifndef UFIBER_ACCEPT_BACKOFF_MS
+#define UFIBER_ACCEPT_BACKOFF_MS 10
+#endif // UFIBER_ACCEPT_BACKOFF_MS
+
+namespace ufiber
+{
+namespace detail
+{
+
+template<class F>
+using call_result_t =
+  decltype(std::declval<typename std::decay<F>::type&>()());
+
+template<class R>
+struct call_signature
+{
+    using type = void(R);
+};
+
+template<>
+struct call_signature<void>
+{
+    using type = void();
+};
+
+// Hands the result of a cross-shard call back to the caller's executor
+template<class Handler, class R>
+struct deliver_op
+{
+    void operator()()
+    {
+        handler_(std::move(result_));
+    }
+
+    Handler handler_;
+    R result_;
+};
+
+// Runs on the target shard. The work guard keeps the caller's executor from
+// running out of work while the call is in flight.
+template<class F, class Handler>
+struct call_op
+{
+    using caller_executor =
+      typename boost::asio::associated_executor<Handler>::type;
+
+    void operator()()
+    {
+        invoke(std::is_void<call_result_t<F>>{});
+    }
+
+    void invoke(std::true_type)
+    {
+        f_();
+        boost::asio::post(work_.get_executor(), std::move(handler_));
+    }
+
+    void invoke(std::false_type)
+    {
+        using op = deliver_op<Handler, call_result_t<F>>;
+        boost::asio::post(work_.get_executor(),
+                          op{std::move(handler_), f_()});
+    }
+
+    F f_;
+    Handler handler_;
+    boost::asio::executor_work_guard<caller_executor> work_;
+};
+
+template<class Executor>
+struct call_initiation
+{
+    template<class Handler, class F>
+    void operator()(Handler&& handler, F&& f) const
+    {
+        using handler_type = typename std::decay<Handler>::type;
+        using op = call_op<typename std::decay<F>::type, handler_type>;
+        auto work = boost::asio::make_work_guard(
+          boost::asio::get_associated_executor(handler));
+        boost::asio::post(
+          target_,
+          op{std::forward<F>(f), std::move(handler), std::move(work)});
+    }
+
+    Executor target_;
+};
+
+// Spawns a fiber from the thread of the shard that will run it
+template<class StackAllocator, class Executor, class F>
+struct spawn_op
+{
+    void operator()()
+    {
+        ufiber::spawn(std::allocator_arg, alloc_, ex_, std::move(f_));
+    }
+
+    StackAllocator alloc_;
+    Executor ex_;
+    F f_;
+};
+
+template<class Session, class Socket>
+struct session_op
+{
+    template<class Executor>
+    void operator()(yield_token<Executor> yield)
+    {
+        session_(std::move(socket_), yield);
+    }
+
+    Session session_;
+    Socket socket_;
+};
+
+enum class accept_action
+{
+    retry,
+    backoff,
+    stop
+};
+
+// What an acceptor does after a failed accept
+inline accept_action
+on_accept_error(boost::system::error_code const& ec) noexcept
+{
+    // A connection that failed before it was accepted only affects that
+    // connection
+    if (ec == boost::asio::error::connection_aborted ||
+        ec == boost::asio::error::connection_reset ||
+        ec == boost::system::errc::protocol_error)
+    {
+        return accept_action::retry;
+    }
+    // The pending connection stays queued and the listener stays readable
+    // until resources are freed, so retrying at once would spin
+    if (ec == boost::asio::error::no_descriptors ||
+        ec == boost::system::errc::too_many_files_open_in_system ||
+        ec == boost::asio::error::no_buffer_space ||
+        ec == boost::asio::error::no_memory)
+    {
+        return accept_action::backoff;
+    }
+    return accept_action::stop;
+}
+
+template<class Acceptor, class Socket, class StackAllocator, class Session>
+struct accept_loop
+{
+    template<class Executor>
+    void operator()(yield_token<Executor> yield)
+    {
+        Socket socket{acceptor_.get_executor()};
+        for (;;)
+        {
+            boost::system::error_code ec =
+              acceptor_.async_accept(socket, yield);
+            if (ec)
+            {
+                switch (on_accept_error(ec))
+                {
+                    case accept_action::retry:
+                        continue;
+                    case accept_action::backoff:
+                        ufiber::sleep_for(
+                          yield,
+                          std::chrono::milliseconds{UFIBER_ACCEPT_BACKOFF_MS});
+                        continue;
+                    case accept_action::stop:
+                        return;
+                }
+            }
+            auto const ex = socket.get_executor();
+            ufiber::spawn(std::allocator_arg,
+                          alloc_,
+                          ex,
+                          session_op<Session, Socket>{session_,
+                                                      std::move(socket)});
+        }
+    }
+
+    Acceptor acceptor_;
+    StackAllocator alloc_;
+    Session session_;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_RUNTIME_HPP
@@ -0,0 +1,360 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_SCHEDULER_HPP
+#define UFIBER_DETAIL_SCHEDULER_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace ufiber
+{
+
+class scheduler;
+
+namespace detail
+{
+
+// A function queued on a scheduler. Queues link operations through `next_`, so
+// that queueing never allocates.
+struct scheduler_op
+{
+    using func_type = void (*)(scheduler_op*, bool);
+
+    explicit scheduler_op(func_type func) noexcept
+      : func_{func}
+    {
+    }
+
+    // Deallocates the operation and then invokes its function
+    void run()
+    {
+        func_(this, true);
+    }
+
+    // Deallocates the operation without invoking its function
+    void destroy() noexcept
+    {
+        func_(this, false);
+    }
+
+    scheduler_op* next_ = nullptr;
+    func_type func_;
+};
+
+template<class F, class Alloc>
+struct executor_op : scheduler_op
+{
+    using alloc_type = typename std::allocator_traits<
+      Alloc>::template rebind_alloc<executor_op>;
+    using traits = std::allocator_traits<alloc_type>;
+
+    executor_op(F&& f, Alloc const& a)
+      : scheduler_op{&executor_op::do_run}
+      , f_{std::move(f)}
+      , alloc_{a}
+    {
+    }
+
+    template<class Function>
+    static executor_op* create(Function&& f, Alloc const& a)
+    {
+        alloc_type alloc{a};
+        executor_op* p = traits::allocate(alloc, 1);
+        BOOST_TRY
+        {
+            ::new (static_cast<void*>(p))
+              executor_op{F(std::forward<Function>(f)), a};
+        }
+        BOOST_CATCH(...)
+        {
+            traits::deallocate(alloc, p, 1);
+            BOOST_RETHROW
+        }
+        BOOST_CATCH_END
+        return p;
+    }
+
+    static void do_run(scheduler_op* base, bool invoke)
+    {
+        auto self = static_cast<executor_op*>(base);
+        alloc_type alloc{self->alloc_};
+        // The memory is released before the function runs, so that the
+        // function may reuse it for the operations it starts
+        F f{std::move(self->f_)};
+        self->~executor_op();
+        traits::deallocate(alloc, self, 1);
+        if (invoke)
+        {
+            f();
+        }
+    }
+
+    F f_;
+    Alloc alloc_;
+};
+
+// FIFO list of operations.
+class op_list
+{
+public:
+    void push(scheduler_op* op) noexcept
+    {
+        op->next_ = nullptr;
+        if (tail_ != nullptr)
+        {
+            tail_->next_ = op;
+        }
+        else
+        {
+            head_ = op;
+        }
+        tail_ = op;
+    }
+
+    scheduler_op* pop() noexcept
+    {
+        auto op = head_;
+        if (op != nullptr)
+        {
+            head_ = op->next_;
+            if (head_ == nullptr)
+            {
+                tail_ = nullptr;
+            }
+        }
+        return op;
+    }
+
+private:
+    scheduler_op* head_ = nullptr;
+    scheduler_op* tail_ = nullptr;
+};
+
+// Bounded run queue of a worker thread. Only the owning worker pushes, while
+// both the owner and other workers take operations from the head. A taker
+// reads the operations first and then claims them by advancing the head, so
+// the slots it has read can't have been reused if its claim succeeds.
+class run_queue
+{
+public:
+    static constexpr std::size_t capacity = 256;
+
+    // Returns false if the queue is full.
+    bool push(scheduler_op* op) noexcept
+    {
+        auto const t = tail_.load(std::memory_order_relaxed);
+        if (t - head_.load(std::memory_order_acquire) == capacity)
+        {
+            return false;
+        }
+        slots_[t & mask].store(op, std::memory_order_relaxed);
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    scheduler_op* pop() noexcept
+    {
+        auto h = head_.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if (h == tail_.load(std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+            auto op = slots_[h & mask].load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(h,
+                                            h + 1,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire))
+            {
+                return op;
+            }
+        }
+    }
+
+    // Moves half of the operations of `victim` into this queue and returns
+    // one more of them, or nullptr if `victim` is empty. Must be called by the
+    // owner of this queue, while it is empty.
+    scheduler_op* steal_from(run_queue& victim) noexcept
+    {
+        auto const t0 = tail_.load(std::memory_order_relaxed);
+        auto h = victim.head_.load(std::memory_order_acquire);
+        for (;;)
+        {
+            auto const t = victim.tail_.load(std::memory_order_acquire);
+            auto n = t - h;
+            if (n == 0)
+            {
+                return nullptr;
+            }
+            // A stale head makes the claim below fail, but it still has to
+            // yield a sane count
+            n = n > capacity ? 1 : n - n / 2;
+            auto const first =
+              victim.slots_[h & mask].load(std::memory_order_relaxed);
+            for (std::size_t i = 1; i < n; ++i)
+            {
+                slots_[(t0 + i - 1) & mask].store(
+                  victim.slots_[(h + i) & mask].load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+            }
+            if (victim.head_.compare_exchange_weak(h,
+                                                   h + n,
+                                                   std::memory_order_acq_rel,
+                                                   std::memory_order_acquire))
+            {
+                tail_.store(t0 + n - 1, std::memory_order_release);
+                return first;
+            }
+        }
+    }
+
+    bool empty() const noexcept
+    {
+        return head_.load(std::memory_order_relaxed) ==
+               tail_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::size_t mask = capacity - 1;
+
+    std::atomic<std::size_t> head_{0};
+    std::atomic<std::size_t> tail_{0};
+    std::atomic<scheduler_op*> slots_[capacity] = {};
+};
+
+struct scheduler_worker
+{
+    scheduler_worker(scheduler& owner, std::size_t index) noexcept
+      : owner_{owner}
+      , index_{index}
+      , rng_{static_cast<std::uint32_t>(index * 2654435761u + 1)}
+    {
+    }
+
+    // xorshift32, used to pick the first victim of a steal
+    std::uint32_t next_random() noexcept
+    {
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 17;
+        rng_ ^= rng_ << 5;
+        return rng_;
+    }
+
+    scheduler& owner_;
+    std::size_t const index_;
+    run_queue queue_;
+    // The most recently woken operation, which runs next on this thread while
+    // its data is likely still in cache. It can't be stolen.
+    scheduler_op* lifo_ = nullptr;
+    unsigned lifo_streak_ = 0;
+    std::uint32_t rng_;
+    std::size_t tick_ = 0;
+};
+
+// The worker running on the calling thread, if any
+inline scheduler_worker*&
+current_worker() noexcept
+{
+    static thread_local scheduler_worker* worker = nullptr;
+    return worker;
+}
+
+// Storage for the one pending wakeup of a scheduler's reactor
+struct wake_slot
+{
+    alignas(std::max_align_t) unsigned char storage_[64];
+    // Set while the wakeup is queued in the reactor
+    std::atomic<bool> queued_{false};
+};
+
+// Allocates the operation that wakes the reactor from its wake_slot, so that
+// waking the reactor can't fail. The reactor frees the operation before it
+// invokes the handler, which marks the slot as free again.
+template<class T>
+class wake_allocator
+{
+public:
+    using value_type = T;
+
+    explicit wake_allocator(wake_slot& slot) noexcept
+      : slot_{&slot}
+    {
+    }
+
+    template<class U>
+    wake_allocator(wake_allocator<U> const& other) noexcept
+      : slot_{other.slot_}
+    {
+    }
+
+    T* allocate(std::size_t n) noexcept
+    {
+        static_assert(sizeof(T) <= sizeof(wake_slot::storage_),
+                      "The wakeup operation doesn't fit in its slot");
+        static_assert(alignof(T) <= alignof(std::max_align_t),
+                      "The wakeup operation is overaligned");
+        assert(n == 1 && "Unexpected allocation");
+        static_cast<void>(n);
+        return reinterpret_cast<T*>(slot_->storage_);
+    }
+
+    void deallocate(T*, std::size_t) noexcept
+    {
+        slot_->queued_.store(false, std::memory_order_release);
+    }
+
+    template<class U>
+    bool operator==(wake_allocator<U> const& other) const noexcept
+    {
+        return slot_ == other.slot_;
+    }
+
+    template<class U>
+    bool operator!=(wake_allocator<U> const& other) const noexcept
+    {
+        return slot_ != other.slot_;
+    }
+
+private:
+    template<class>
+    friend class wake_allocator;
+
+    wake_slot* slot_;
+};
+
+// Makes the reactor's run_one() return
+struct reactor_wakeup
+{
+    using allocator_type = wake_allocator<void>;
+
+    allocator_type get_allocator() const noexcept
+    {
+        return allocator_type{*slot_};
+    }
+
+    void operator()() const noexcept
+    {
+    }
+
+    wake_slot* slot_;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_SCHEDULER_HPP
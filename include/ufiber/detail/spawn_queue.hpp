@@ -0,0 +1,296 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_SPAWN_QUEUE_HPP
+#define UFIBER_DETAIL_SPAWN_QUEUE_HPP
+
+#include <ufiber/detail/config.hpp>
+#include <ufiber/detail/ufiber.hpp>
+
+#include <boost/asio/post.hpp>
+#include <boost/context/stack_context.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace ufiber
+{
+namespace detail
+{
+
+// A fiber that has been spawned but not started, so it has no stack yet. Each
+// one holds a reference to the admission_core it was spawned through.
+struct deferred_spawn
+{
+    deferred_spawn(void (*launch)(deferred_spawn*),
+                   void (*destroy)(deferred_spawn*)) noexcept
+      : launch_{launch}
+      , destroy_{destroy}
+    {
+    }
+
+    deferred_spawn* next_ = nullptr;
+    // Posts the spawn to its executor, which allocates the stack and starts
+    // the fiber once it runs the posted handler. If posting throws, the spawn
+    // is still owned by the caller.
+    void (*launch_)(deferred_spawn*);
+    // Frees a spawn that will never be started
+    void (*destroy_)(deferred_spawn*);
+};
+
+// Counts the fibers of a spawn_queue that have been admitted, and keeps those
+// that have to wait for a slot in FIFO order.
+class admission_core
+{
+public:
+    explicit admission_core(std::size_t limit) noexcept
+      : limit_{limit}
+    {
+    }
+
+    admission_core(admission_core const&) = delete;
+    admission_core& operator=(admission_core const&) = delete;
+
+    // Takes a slot for `s` if one is free, otherwise queues it
+    UFIBER_INLINE_DECL bool admit(deferred_spawn* s) noexcept;
+
+    // Called when an admitted fiber has finished. Returns the queued spawn
+    // that takes over its slot, if any.
+    UFIBER_INLINE_DECL deferred_spawn* vacate() noexcept;
+
+    // Called when an admitted fiber has been abandoned by its executor.
+    // Returns all queued spawns, which will never be started. The fiber keeps
+    // its slot until it has been destroyed.
+    UFIBER_INLINE_DECL deferred_spawn* abandon() noexcept;
+
+    std::size_t live() const noexcept
+    {
+        return live_.load(std::memory_order_relaxed);
+    }
+
+    std::size_t pending() const noexcept
+    {
+        return pending_.load(std::memory_order_relaxed);
+    }
+
+    void add_ref() noexcept
+    {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() noexcept
+    {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    deferred_spawn* head_ = nullptr;
+    deferred_spawn* tail_ = nullptr;
+    std::atomic<std::size_t> live_{0};
+    std::atomic<std::size_t> pending_{0};
+    std::size_t const limit_;
+    std::atomic<std::size_t> refs_{1};
+};
+
+// Hands the slot of a finished fiber to the next queued spawn. A spawn that
+// can't be posted is destroyed, and the slot goes to the one after it.
+UFIBER_INLINE_DECL void
+start_next(admission_core* core) noexcept;
+
+UFIBER_INLINE_DECL void
+abandon_queued(admission_core* core) noexcept;
+
+// The StackAllocator of an admitted fiber. The fiber's slot is handed on by
+// the last instance, which is destroyed once the fiber's stack has been
+// deallocated, or once allocating the stack has failed. The number of stacks
+// is therefore bounded by the limit as well.
+template<class StackAllocator>
+class admitted_stack
+{
+public:
+    admitted_stack(StackAllocator&& sa, admission_core* core) noexcept
+      : sa_{std::move(sa)}
+      , core_{core}
+    {
+    }
+
+    admitted_stack(admitted_stack&& other) noexcept
+      : sa_{std::move(other.sa_)}
+      , core_{other.core_}
+    {
+        other.core_ = nullptr;
+    }
+
+    admitted_stack& operator=(admitted_stack&&) = delete;
+
+    ~admitted_stack()
+    {
+        if (core_ != nullptr)
+        {
+            detail::start_next(core_);
+            core_->release();
+        }
+    }
+
+    boost::context::stack_context allocate()
+    {
+        return sa_.allocate();
+    }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept
+    {
+        sa_.deallocate(sctx);
+    }
+
+    template<class S = StackAllocator>
+    auto reclaimer() const -> decltype(std::declval<S const&>().reclaimer())
+    {
+        return sa_.reclaimer();
+    }
+
+private:
+    StackAllocator sa_;
+    admission_core* core_;
+};
+
+// Main function of an admitted fiber
+template<class F>
+struct admitted_main
+{
+    template<class Executor>
+    void operator()(yield_token<Executor> yield)
+    {
+        BOOST_TRY
+        {
+            f_(std::move(yield));
+        }
+        BOOST_CATCH(broken_promise const&)
+        {
+            // The executor is shutting down, so the queued fibers would never
+            // run
+            detail::abandon_queued(core_);
+            BOOST_RETHROW
+        }
+        BOOST_CATCH_END
+    }
+
+    F f_;
+    // Kept alive by the fiber's admitted_stack
+    admission_core* core_;
+};
+
+// The function object and stack allocator of a fiber, stored in a single
+// allocation until the fiber is started.
+template<class Executor, class StackAllocator, class F>
+class deferred_fiber : public deferred_spawn
+{
+public:
+    deferred_fiber(Executor const& ex,
+                   StackAllocator&& sa,
+                   F&& f,
+                   admission_core* core)
+      : deferred_spawn{&deferred_fiber::do_launch, &deferred_fiber::do_destroy}
+      , ex_{ex}
+      , sa_{std::move(sa)}
+      , f_{std::move(f)}
+      , core_{core}
+    {
+    }
+
+private:
+    class launcher
+    {
+    public:
+        explicit launcher(deferred_fiber* self) noexcept
+          : self_{self}
+        {
+        }
+
+        launcher(launcher&& other) noexcept
+          : self_{other.self_}
+        {
+            other.self_ = nullptr;
+        }
+
+        launcher& operator=(launcher&&) = delete;
+
+        ~launcher()
+        {
+            if (self_ != nullptr)
+            {
+                // Destroyed by the executor without being run
+                detail::abandon_queued(self_->core_);
+                detail::start_next(self_->core_);
+                do_destroy(self_);
+            }
+        }
+
+        void operator()()
+        {
+            std::unique_ptr<deferred_fiber> self{self_};
+            self_ = nullptr;
+            auto const core = self->core_;
+            // The reference of the spawn is handed to the stack
+            detail::spawn_fiber(
+              admitted_stack<StackAllocator>{std::move(self->sa_), core},
+              self->ex_,
+              admitted_main<F>{std::move(self->f_), core});
+        }
+
+        deferred_fiber* self_;
+    };
+
+    static void do_launch(deferred_spawn* s)
+    {
+        auto const self = static_cast<deferred_fiber*>(s);
+        launcher l{self};
+        BOOST_TRY
+        {
+            boost::asio::post(self->ex_, std::move(l));
+        }
+        BOOST_CATCH(...)
+        {
+            // A launcher that the executor has taken over and destroyed has
+            // already cleaned up
+            if (l.self_ != nullptr)
+            {
+                l.self_ = nullptr;
+                BOOST_RETHROW
+            }
+        }
+        BOOST_CATCH_END
+    }
+
+    static void do_destroy(deferred_spawn* s) noexcept
+    {
+        auto const self = static_cast<deferred_fiber*>(s);
+        auto const core = self->core_;
+        delete self;
+        core->release();
+    }
+
+    Executor ex_;
+    StackAllocator sa_;
+    F f_;
+    admission_core* core_;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_SPAWN_QUEUE_HPP
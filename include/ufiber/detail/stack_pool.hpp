@@ -0,0 +1,282 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_STACK_POOL_HPP
+#define UFIBER_DETAIL_STACK_POOL_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#include <boost/context/stack_context.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace ufiber
+{
+namespace detail
+{
+
+// A free stack is linked into the pool through a node placed at the top of its
+// own memory. The fiber's control record used to live there, but it has been
+// destroyed by the time the stack is handed back to the allocator.
+struct stack_node
+{
+    stack_node* next_;
+    boost::context::stack_context sctx_;
+    // Set in the first node of a batch on the global list
+    stack_node* next_batch_;
+    stack_node* batch_last_;
+    std::size_t batch_size_;
+};
+
+inline stack_node*
+make_stack_node(boost::context::stack_context const& sctx) noexcept
+{
+    auto top = reinterpret_cast<std::uintptr_t>(sctx.sp) - sizeof(stack_node);
+    top &= ~static_cast<std::uintptr_t>(alignof(stack_node) - 1);
+    auto node = ::new (reinterpret_cast<void*>(top)) stack_node;
+    node->next_ = nullptr;
+    node->sctx_ = sctx;
+    return node;
+}
+
+// Free stacks shared by all threads, kept in batches: chains of stacks that
+// have been released together. Batches are linked and unlinked whole, so the
+// lock is held for a few steps regardless of the number of free stacks, and a
+// thread never sees the list empty while another one is taking stacks from it.
+//
+// The list is not lock-free. A lock-free stack of batches would have to guard
+// against ABA with a tag next to the head pointer: a double-width CAS, which
+// needs libatomic or -mcx16, or tag bits in the pointer, which the alignment
+// of a node at the top of a stack of any StackAllocator can't guarantee. The
+// thread caches already take the list off the fast path: a thread touches it
+// once per batch of stacks, and a refill takes several batches under one
+// acquisition instead of one CAS loop each.
+class stack_freelist
+{
+public:
+    stack_freelist() = default;
+    stack_freelist(stack_freelist const&) = delete;
+    stack_freelist& operator=(stack_freelist const&) = delete;
+
+    // Adds the chain from `first` to `last`, of `count` stacks, as a batch
+    void push(stack_node* first, stack_node* last, std::size_t count) noexcept
+    {
+        first->batch_last_ = last;
+        first->batch_size_ = count;
+        std::lock_guard<std::mutex> lock{mutex_};
+        first->next_batch_ = head_;
+        head_ = first;
+    }
+
+    // Takes batches until at least `count` stacks have been taken or the list
+    // is empty. Returns them as one chain and adds their number to `taken`.
+    stack_node* pop(std::size_t count, std::size_t& taken) noexcept
+    {
+        stack_node* first = nullptr;
+        stack_node* last = nullptr;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            while (head_ != nullptr && taken < count)
+            {
+                auto const b = head_;
+                head_ = b->next_batch_;
+                if (last == nullptr)
+                {
+                    first = b;
+                }
+                else
+                {
+                    last->next_ = b;
+                }
+                last = b->batch_last_;
+                taken += b->batch_size_;
+            }
+        }
+        if (last != nullptr)
+        {
+            last->next_ = nullptr;
+        }
+        return first;
+    }
+
+    stack_node* pop_all() noexcept
+    {
+        std::size_t taken = 0;
+        return pop((std::numeric_limits<std::size_t>::max)(), taken);
+    }
+
+private:
+    std::mutex mutex_;
+    stack_node* head_ = nullptr;
+};
+
+template<class StackAllocator>
+struct stack_pool_state
+{
+    stack_pool_state(StackAllocator&& sa,
+                     std::size_t high_watermark,
+                     std::size_t low_watermark)
+      : sa_{std::move(sa)}
+      , high_watermark_{high_watermark}
+      , low_watermark_{low_watermark < high_watermark ? low_watermark
+                                                      : high_watermark}
+    {
+    }
+
+    ~stack_pool_state()
+    {
+        release(global_.pop_all());
+    }
+
+    void release(stack_node* n) noexcept
+    {
+        while (n != nullptr)
+        {
+            auto sctx = n->sctx_;
+            n = n->next_;
+            sa_.deallocate(sctx);
+        }
+    }
+
+    StackAllocator sa_;
+    std::size_t const high_watermark_;
+    std::size_t const low_watermark_;
+    stack_freelist global_;
+};
+
+// Per-thread cache of free stacks. Each thread keeps one entry per pool it has
+// touched; in practice there is one pool, so the lookup is a single compare.
+template<class StackAllocator>
+class stack_cache
+{
+public:
+    using state_type = stack_pool_state<StackAllocator>;
+
+    struct entry
+    {
+        std::shared_ptr<state_type> state_;
+        stack_node* head_;
+        std::size_t size_;
+    };
+
+    stack_cache() = default;
+    stack_cache(stack_cache const&) = delete;
+    stack_cache& operator=(stack_cache const&) = delete;
+
+    ~stack_cache()
+    {
+        for (auto& e : entries_)
+        {
+            flush(e, e.size_);
+        }
+    }
+
+    static stack_cache& local() noexcept
+    {
+        static thread_local stack_cache cache;
+        return cache;
+    }
+
+    entry& get(std::shared_ptr<state_type> const& state)
+    {
+        for (auto& e : entries_)
+        {
+            if (e.state_ == state)
+            {
+                return e;
+            }
+        }
+        entries_.push_back(entry{state, nullptr, 0});
+        return entries_.back();
+    }
+
+    void erase(state_type const* state) noexcept
+    {
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->state_.get() == state)
+            {
+                flush(*it, it->size_);
+                entries_.erase(it);
+                return;
+            }
+        }
+    }
+
+    static stack_node* pop(entry& e) noexcept
+    {
+        if (e.head_ == nullptr)
+        {
+            refill(e);
+            if (e.head_ == nullptr)
+            {
+                return nullptr;
+            }
+        }
+        auto n = e.head_;
+        e.head_ = n->next_;
+        --e.size_;
+        return n;
+    }
+
+    static void push(entry& e, stack_node* n) noexcept
+    {
+        n->next_ = e.head_;
+        e.head_ = n;
+        ++e.size_;
+        if (e.size_ > e.state_->high_watermark_)
+        {
+            flush(e, e.size_ - e.state_->low_watermark_);
+        }
+    }
+
+private:
+    // Moves `count` stacks from the head of the thread's list to the global
+    // overflow list.
+    static void flush(entry& e, std::size_t count) noexcept
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        auto first = e.head_;
+        auto last = first;
+        for (std::size_t i = 1; i < count; ++i)
+        {
+            last = last->next_;
+        }
+        e.head_ = last->next_;
+        e.size_ -= count;
+        e.state_->global_.push(first, last, count);
+    }
+
+    // Takes whole batches from the global list until the cache holds the low
+    // watermark (but at least one stack). A batch holds at most the high
+    // watermark, so the cache stays within bounds that push() restores.
+    static void refill(entry& e) noexcept
+    {
+        auto const keep =
+          e.state_->low_watermark_ > 0 ? e.state_->low_watermark_ : 1;
+        e.head_ = e.state_->global_.pop(keep, e.size_);
+    }
+
+    std::vector<entry> entries_;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_STACK_POOL_HPP
@@ -0,0 +1,41 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_STACK_PROFILE_HPP
+#define UFIBER_DETAIL_STACK_PROFILE_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#include <boost/context/stack_context.hpp>
+
+#include <cstddef>
+
+#ifndef UFIBER_STACK_PROFILE_WINDOW
+#define UFIBER_STACK_PROFILE_WINDOW 256
+#endif // UFIBER_STACK_PROFILE_WINDOW
+
+namespace ufiber
+{
+namespace detail
+{
+
+// Fills the stack with a sentinel pattern. The lowest page is skipped, because
+// it may be a guard page.
+UFIBER_INLINE_DECL void
+fill_stack(boost::context::stack_context const& sctx) noexcept;
+
+// Returns the number of bytes between the top of the stack and the lowest
+// address that no longer holds the sentinel pattern.
+UFIBER_INLINE_DECL std::size_t
+measure_stack(boost::context::stack_context const& sctx) noexcept;
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_STACK_PROFILE_HPP
@@ -0,0 +1,186 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_STATS_HPP
+#define UFIBER_DETAIL_STATS_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#ifdef UFIBER_ENABLE_STATS
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#define UFIBER_STATS(expr) expr
+
+namespace ufiber
+{
+namespace detail
+{
+
+// Counters owned by a single thread. Only the owning thread writes to them, so
+// an increment is a plain load and store, while readers on other threads still
+// see untorn values.
+struct stats_block
+{
+    enum counter
+    {
+        spawned,
+        completed,
+        suspends,
+        resumes,
+        stack_bytes,
+        broken_promises,
+        inline_completions,
+        budget_yields,
+        count
+    };
+
+    void add(counter c, std::int64_t n) noexcept
+    {
+        auto& v = values_[c];
+        v.store(v.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+
+    std::int64_t get(counter c) const noexcept
+    {
+        return values_[c].load(std::memory_order_relaxed);
+    }
+
+    std::atomic<std::int64_t> values_[count] = {};
+};
+
+class stats_registry;
+
+// A thread's counters, linked into the registry for the thread's lifetime.
+struct thread_stats : stats_block
+{
+    UFIBER_INLINE_DECL thread_stats();
+    UFIBER_INLINE_DECL ~thread_stats();
+
+    thread_stats(thread_stats const&) = delete;
+    thread_stats& operator=(thread_stats const&) = delete;
+
+    thread_stats* prev_ = nullptr;
+    thread_stats* next_ = nullptr;
+};
+
+class stats_registry
+{
+public:
+    UFIBER_INLINE_DECL static stats_registry& instance() noexcept;
+
+    // Sums the counters of all live threads and those of exited threads
+    UFIBER_INLINE_DECL void collect(stats_block& out);
+
+    void on_spawn() noexcept
+    {
+        auto live = live_.fetch_add(1, std::memory_order_relaxed) + 1;
+        auto peak = peak_live_.load(std::memory_order_relaxed);
+        while (live > peak && !peak_live_.compare_exchange_weak(
+                                peak, live, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void on_complete() noexcept
+    {
+        live_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    std::int64_t live() const noexcept
+    {
+        return live_.load(std::memory_order_relaxed);
+    }
+
+    std::int64_t peak_live() const noexcept
+    {
+        return peak_live_.load(std::memory_order_relaxed);
+    }
+
+private:
+    friend struct thread_stats;
+
+    std::mutex mutex_;
+    thread_stats* head_ = nullptr;
+    stats_block retired_;
+    // Live fibers may finish on a different thread than the one they were
+    // spawned on, so their peak cannot be derived from per-thread counters.
+    // These are only touched when a fiber starts or finishes.
+    std::atomic<std::int64_t> live_{0};
+    std::atomic<std::int64_t> peak_live_{0};
+};
+
+inline thread_stats&
+local_stats() noexcept
+{
+    static thread_local thread_stats stats;
+    return stats;
+}
+
+inline void
+stats_on_spawn(std::size_t stack_size) noexcept
+{
+    auto& s = local_stats();
+    s.add(stats_block::spawned, 1);
+    s.add(stats_block::stack_bytes, static_cast<std::int64_t>(stack_size));
+    stats_registry::instance().on_spawn();
+}
+
+inline void
+stats_on_complete(std::size_t stack_size) noexcept
+{
+    auto& s = local_stats();
+    s.add(stats_block::completed, 1);
+    s.add(stats_block::stack_bytes, -static_cast<std::int64_t>(stack_size));
+    stats_registry::instance().on_complete();
+}
+
+inline void
+stats_on_suspend() noexcept
+{
+    local_stats().add(stats_block::suspends, 1);
+}
+
+inline void
+stats_on_resume() noexcept
+{
+    local_stats().add(stats_block::resumes, 1);
+}
+
+inline void
+stats_on_inline_completion() noexcept
+{
+    local_stats().add(stats_block::inline_completions, 1);
+}
+
+inline void
+stats_on_budget_yield() noexcept
+{
+    local_stats().add(stats_block::budget_yields, 1);
+}
+
+inline void
+stats_on_broken_promise() noexcept
+{
+    local_stats().add(stats_block::broken_promises, 1);
+}
+
+} // namespace detail
+} // namespace ufiber
+
+#else // UFIBER_ENABLE_STATS
+
+#define UFIBER_STATS(expr)
+
+#endif // UFIBER_ENABLE_STATS
+
+#endif // UFIBER_DETAIL_STATS_HPP
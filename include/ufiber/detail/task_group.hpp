@@ -0,0 +1,202 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_TASK_GROUP_HPP
+#define UFIBER_DETAIL_TASK_GROUP_HPP
+
+#include <ufiber/detail/config.hpp>
+#include <ufiber/detail/ufiber.hpp>
+#include <ufiber/detail/wait_queue.hpp>
+
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+namespace ufiber
+{
+
+class stop_token;
+
+namespace detail
+{
+
+// A callback registered with a group, invoked when the group is cancelled.
+struct stop_callback_base
+{
+    explicit stop_callback_base(void (*invoke)(stop_callback_base*)) noexcept
+      : invoke_{invoke}
+    {
+    }
+
+    stop_callback_base* prev_ = nullptr;
+    stop_callback_base* next_ = nullptr;
+    bool linked_ = false;
+    void (*invoke_)(stop_callback_base*);
+};
+
+// State of a task_group that its children refer to. It is reference counted,
+// so that children that are still unwinding after their group has been
+// destroyed (e.g. during the shutdown of an execution context) don't touch
+// freed memory.
+class group_core
+{
+public:
+    explicit group_core(std::size_t limit) noexcept
+      : limit_{limit}
+    {
+    }
+
+    group_core(group_core const&) = delete;
+    group_core& operator=(group_core const&) = delete;
+
+    bool stop_requested() const noexcept
+    {
+        return stopped_.load(std::memory_order_acquire);
+    }
+
+    // Invokes the registered callbacks with the lock held, so that a
+    // callback's owner can't destroy it while it runs.
+    UFIBER_INLINE_DECL void request_stop() noexcept;
+
+    // Returns false, without registering `cb`, if stop has been requested
+    UFIBER_INLINE_DECL bool add_callback(stop_callback_base* cb) noexcept;
+
+    UFIBER_INLINE_DECL void remove_callback(stop_callback_base* cb) noexcept;
+
+    // Takes a slot for a new child if one is free
+    UFIBER_INLINE_DECL bool try_reserve() noexcept;
+
+    // Completes `w` once a slot has been taken on its behalf
+    UFIBER_INLINE_DECL void reserve(waiter_base* w) noexcept;
+
+    UFIBER_INLINE_DECL bool idle() noexcept;
+
+    // Completes `w` once all children have finished
+    UFIBER_INLINE_DECL void wait(waiter_base* w) noexcept;
+
+    // Called once by every child, with the exception that escaped from it.
+    // Releases the child's reference.
+    UFIBER_INLINE_DECL void finish(std::exception_ptr e) noexcept;
+
+    UFIBER_INLINE_DECL std::exception_ptr take_error() noexcept;
+
+    void add_ref() noexcept
+    {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() noexcept
+    {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::atomic<bool> stopped_{false};
+    stop_callback_base* callbacks_ = nullptr;
+    std::size_t live_ = 0;
+    std::size_t const limit_;
+    waiter_list spawners_;
+    waiter_base* waiter_ = nullptr;
+    std::exception_ptr error_;
+    std::atomic<std::size_t> refs_{1};
+};
+
+UFIBER_INLINE_DECL stop_token
+make_stop_token(group_core* core) noexcept;
+
+template<class F, class Yield, class Token>
+auto
+invoke_task(F& f, Yield&& yield, Token&& token, int)
+  -> decltype(f(std::forward<Yield>(yield), std::forward<Token>(token)))
+{
+    return f(std::forward<Yield>(yield), std::forward<Token>(token));
+}
+
+template<class F, class Yield, class Token>
+auto
+invoke_task(F& f, Yield&& yield, Token&&, long)
+  -> decltype(f(std::forward<Yield>(yield)))
+{
+    return f(std::forward<Yield>(yield));
+}
+
+// Main function of a child. The child's slot and its reference to the group
+// are handed back exactly once, also if the fiber is abandoned before the
+// function has been invoked.
+template<class F>
+class task_main
+{
+public:
+    task_main(F&& f, group_core* core) noexcept
+      : f_{std::move(f)}
+      , core_{core}
+    {
+    }
+
+    task_main(task_main&& other) noexcept
+      : f_{std::move(other.f_)}
+      , core_{other.core_}
+    {
+        other.core_ = nullptr;
+    }
+
+    task_main& operator=(task_main&&) = delete;
+
+    ~task_main()
+    {
+        if (core_ != nullptr)
+        {
+            core_->finish(std::exception_ptr{});
+        }
+    }
+
+    template<class Executor>
+    void operator()(yield_token<Executor> yield)
+    {
+        auto const core = core_;
+        core_ = nullptr;
+        BOOST_TRY
+        {
+            if (!core->stop_requested())
+            {
+                detail::invoke_task(
+                  f_, std::move(yield), detail::make_stop_token(core), 0);
+            }
+        }
+        BOOST_CATCH(broken_promise const&)
+        {
+            core->finish(std::current_exception());
+            BOOST_RETHROW
+        }
+        BOOST_CATCH(...)
+        {
+            core->finish(std::current_exception());
+            return;
+        }
+        BOOST_CATCH_END
+        core->finish(std::exception_ptr{});
+    }
+
+private:
+    F f_;
+    group_core* core_;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_TASK_GROUP_HPP
@@ -0,0 +1,170 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_TRACE_HPP
+#define UFIBER_DETAIL_TRACE_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#ifdef UFIBER_ENABLE_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef UFIBER_TRACE_BUFFER_SIZE
+#define UFIBER_TRACE_BUFFER_SIZE 16384
+#endif // UFIBER_TRACE_BUFFER_SIZE
+
+#define UFIBER_TRACE(expr) expr
+
+namespace ufiber
+{
+namespace detail
+{
+
+enum class trace_kind : std::uint8_t
+{
+    start,
+    suspend,
+    resume,
+    finish
+};
+
+struct trace_record
+{
+    std::uint64_t time;
+    std::uint64_t fiber;
+    trace_kind kind;
+    std::size_t thread;
+};
+
+// Single producer ring of events, written only by the thread that owns it.
+// Readers copy the ring without blocking the writer and discard the entries
+// that may have been overwritten while they were copied.
+class trace_buffer
+{
+public:
+    static constexpr std::size_t capacity = UFIBER_TRACE_BUFFER_SIZE;
+    static_assert((capacity & (capacity - 1)) == 0,
+                  "UFIBER_TRACE_BUFFER_SIZE must be a power of 2");
+
+    explicit trace_buffer(std::size_t thread) noexcept
+      : thread_{thread}
+    {
+    }
+
+    void push(std::uint64_t time, std::uint64_t fiber, trace_kind k) noexcept
+    {
+        auto const h = committed_.load(std::memory_order_relaxed);
+        reserved_.store(h + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        auto& e = entries_[h & (capacity - 1)];
+        e.time_.store(time, std::memory_order_relaxed);
+        e.tag_.store(fiber << 8 | static_cast<std::uint8_t>(k),
+                     std::memory_order_relaxed);
+        committed_.store(h + 1, std::memory_order_release);
+    }
+
+    UFIBER_INLINE_DECL void snapshot(std::vector<trace_record>& out) const;
+
+private:
+    struct entry
+    {
+        std::atomic<std::uint64_t> time_{0};
+        std::atomic<std::uint64_t> tag_{0};
+    };
+
+    std::atomic<std::uint64_t> committed_{0};
+    std::atomic<std::uint64_t> reserved_{0};
+    std::size_t thread_;
+    entry entries_[capacity];
+};
+
+// Owns the buffers of all threads that have recorded an event. Buffers outlive
+// their threads, so that the events of a thread pool that has been shut down
+// can still be dumped. The buffer of an exited thread is handed to the next
+// thread that records an event, which appends to it, so the number of
+// buffers is bounded by the number of threads recording at the same time.
+class trace_registry
+{
+public:
+    UFIBER_INLINE_DECL static trace_registry& instance() noexcept;
+
+    UFIBER_INLINE_DECL trace_buffer* acquire() noexcept;
+
+    UFIBER_INLINE_DECL void release(trace_buffer* buffer) noexcept;
+
+    UFIBER_INLINE_DECL std::vector<trace_record> snapshot();
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<trace_buffer>> buffers_;
+    std::vector<trace_buffer*> free_;
+};
+
+// The buffer of the calling thread, which is released when the thread exits
+struct trace_buffer_ref
+{
+    trace_buffer_ref() = default;
+    trace_buffer_ref(trace_buffer_ref const&) = delete;
+    trace_buffer_ref& operator=(trace_buffer_ref const&) = delete;
+
+    ~trace_buffer_ref()
+    {
+        if (buffer_ != nullptr)
+        {
+            trace_registry::instance().release(buffer_);
+        }
+    }
+
+    trace_buffer* buffer_ = nullptr;
+};
+
+inline std::atomic<bool>&
+trace_active() noexcept
+{
+    static std::atomic<bool> active{false};
+    return active;
+}
+
+inline void
+trace_event(std::uint64_t fiber, trace_kind k) noexcept
+{
+    if (!trace_active().load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    static thread_local trace_buffer_ref ref;
+    if (ref.buffer_ == nullptr)
+    {
+        ref.buffer_ = trace_registry::instance().acquire();
+        if (ref.buffer_ == nullptr)
+        {
+            return;
+        }
+    }
+    auto const now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch());
+    ref.buffer_->push(static_cast<std::uint64_t>(now.count()), fiber, k);
+}
+
+} // namespace detail
+} // namespace ufiber
+
+#else // UFIBER_ENABLE_TRACING
+
+#define UFIBER_TRACE(expr)
+
+#endif // UFIBER_ENABLE_TRACING
+
+#endif // UFIBER_DETAIL_TRACE_HPP
@@ -10,10 +10,24 @@
 #ifndef UFIBER_DETAIL_UFIBER_HPP
 #define UFIBER_DETAIL_UFIBER_HPP
 
+#include <ufiber/arena.hpp>
+#include <ufiber/detail/budget.hpp>
 #include <ufiber/detail/config.hpp>
-
+#include <ufiber/detail/fiber_id.hpp>
+#include <ufiber/detail/fiber_local.hpp>
+#include <ufiber/detail/handler_slab.hpp>
+#include <ufiber/detail/park_record.hpp>
+#include <ufiber/detail/registry.hpp>
+#include <ufiber/detail/stats.hpp>
+#include <ufiber/detail/trace.hpp>
+#include <ufiber/detail/watchdog.hpp>
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/post.hpp>
+#include <boost/config.hpp>
 #include <boost/context/fiber.hpp>
+#include <boost/context/fixedsize_stack.hpp>
 #include <boost/core/no_exceptions_support.hpp>
 
 #include <atomic>
@@ -31,10 +45,36 @@ namespace detail
 {
 
 class void_fn_ref;
+class fiber_context;
 
 [[noreturn]] UFIBER_INLINE_DECL void
 throw_broken_promise();
 
+// The fiber running on the calling thread. The compiler must not reuse the
+// address of one thread's variable after a fiber has been resumed on another
+// thread, so the function is kept out of line, and the empty asm statement
+// stops it from being treated as a const function whose calls can be merged.
+BOOST_NOINLINE inline fiber_context*&
+current_fiber() noexcept
+{
+    static thread_local fiber_context* current = nullptr;
+#if defined(__GNUC__)
+    __asm__ __volatile__("");
+#endif // defined(__GNUC__)
+    return current;
+}
+
+// Tracks an operation started by fiber_context::initiate(), so that a
+// completion handler invoked before the fiber has switched out doesn't need to
+// switch back into it.
+enum class handoff : unsigned char
+{
+    idle,
+    initiating,
+    suspending,
+    completed,
+};
+
 class fiber_context
 {
 public:
@@ -44,7 +84,9 @@ public:
         fiber_context& ctx_;
     };
 
-    UFIBER_INLINE_DECL explicit fiber_context(boost::context::fiber&& f);
+    UFIBER_INLINE_DECL fiber_context(boost::context::fiber&& f,
+                                     boost::context::stack_context const& sctx,
+                                     reclaim_list* reclaimer) noexcept;
     fiber_context(fiber_context&&) = delete;
     fiber_context(fiber_context const&) = delete;
 
@@ -54,22 +96,121 @@ public:
     template<class F>
     void suspend_with(F&& init) noexcept
     {
+        // The address of a local approximates the fiber's stack pointer at the
+        // point of suspension.
+        char marker = 0;
+        UFIBER_STATS(detail::stats_on_suspend());
+        UFIBER_TRACE(detail::trace_event(id_, trace_kind::suspend));
+        UFIBER_REGISTRY(record_.on_suspend());
         fiber_ = std::move(fiber_).resume_with(
-          [this, &init](boost::context::fiber&& f) {
+          [this, &init, &marker](boost::context::fiber&& f) {
               fiber_ = std::move(f);
+              if (park_.enrolled())
+              {
+                  park_.park(&marker);
+              }
               init();
               return boost::context::fiber{};
           });
         assert(fiber_ && "Expected caller fiber");
         // fiber_ should contain the main thread's stack at this point
+        detail::current_fiber() = this;
+        budget_.restart();
+    }
+
+    // Starts an asynchronous operation on the fiber's own stack and suspends
+    // only if its completion handler hasn't been invoked in the meantime.
+    // Resuming the fiber through a resumer is then a no-op.
+    template<class F>
+    void initiate(F&& op)
+    {
+        handoff_.store(handoff::initiating, std::memory_order_relaxed);
+        BOOST_TRY
+        {
+            op();
+        }
+        BOOST_CATCH(...)
+        {
+            handoff_.store(handoff::idle, std::memory_order_relaxed);
+            BOOST_RETHROW
+        }
+        BOOST_CATCH_END
+        auto expected = handoff::initiating;
+        if (!handoff_.compare_exchange_strong(expected,
+                                              handoff::suspending,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_acquire))
+        {
+            handoff_.store(handoff::idle, std::memory_order_relaxed);
+            UFIBER_STATS(detail::stats_on_inline_completion());
+            budget_.on_inline_completion();
+            return;
+        }
+        suspend_with([this]() noexcept {
+            auto state = handoff::suspending;
+            if (!handoff_.compare_exchange_strong(state,
+                                                  handoff::idle,
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_acquire))
+            {
+                // Completed while the fiber was switching out
+                handoff_.store(handoff::idle, std::memory_order_relaxed);
+                resume_suspended();
+            }
+        });
     }
 
     UFIBER_INLINE_DECL void resume() noexcept;
 
     UFIBER_INLINE_DECL boost::context::fiber final_suspend() noexcept;
 
+    fiber_locals& locals() noexcept
+    {
+        return locals_;
+    }
+
+    handler_slab& slab() noexcept
+    {
+        return slab_;
+    }
+
+    fiber_arena& arena() noexcept
+    {
+        return arena_;
+    }
+
+    run_budget& budget() noexcept
+    {
+        return budget_;
+    }
+
+#ifdef UFIBER_ENABLE_REGISTRY
+    fiber_record& record() noexcept
+    {
+        return record_;
+    }
+#endif // UFIBER_ENABLE_REGISTRY
+
 private:
+    UFIBER_INLINE_DECL void resume_suspended() noexcept;
+
     boost::context::fiber fiber_;
+    std::atomic<handoff> handoff_{handoff::idle};
+    park_record park_;
+    fiber_locals locals_;
+    handler_slab slab_;
+    run_budget budget_;
+    // The context lives on the fiber's stack, so the arena's first block does
+    // as well
+    alignas(std::max_align_t) char arena_block_[UFIBER_ARENA_STACK_BLOCK];
+    fiber_arena arena_{arena_block_, sizeof(arena_block_)};
+#if defined(UFIBER_ENABLE_TRACING) || defined(UFIBER_ENABLE_REGISTRY) ||      \
+  defined(UFIBER_ENABLE_WATCHDOG)
+    std::uint64_t id_ = detail::next_fiber_id();
+#endif
+#ifdef UFIBER_ENABLE_REGISTRY
+    fiber_record record_{id_};
+#endif // UFIBER_ENABLE_REGISTRY
 };
 
 template<class Executor>
@@ -195,32 +336,138 @@ struct completion_handler
     Executor executor_;
 };
 
+// Identifies a fiber that has yielded in the fiber registry
+struct yield_op
+{
+};
+
+// Reschedules the fiber behind the handlers that are already queued on its
+// executor. The handler is allocated from the fiber's slab.
+template<class Executor>
+void
+yield_fiber(yield_token<Executor>& yield)
+{
+    promise<> p;
+    fiber_context& ctx = detail::get_fiber(yield);
+    UFIBER_REGISTRY(ctx.record().wait_for(typeid(yield_op), typeid(void())));
+    ctx.initiate([&] {
+        boost::asio::post(completion_handler<Executor>{&p, yield, ctx});
+    });
+    p.get_value();
+}
+
+// Yields before an operation is initiated if the fiber has used up its budget
+template<class Executor>
+void
+charge_budget(yield_token<Executor>& yield)
+{
+    if (detail::get_fiber(yield).budget().exhausted())
+    {
+        UFIBER_STATS(detail::stats_on_budget_yield());
+        detail::yield_fiber(yield);
+    }
+}
+
+// How a new fiber gets onto its executor before invoking its main function
+enum class start_mode
+{
+    post,
+    dispatch,
+};
+
 template<class F, class Executor, class Exception = broken_promise>
 struct fiber_main
 {
     boost::context::fiber operator()(boost::context::fiber&& fiber)
     {
-        fiber_context ctx{std::move(fiber)};
+        fiber_context ctx{std::move(fiber), stack_, reclaimer_};
+        detail::current_fiber() = &ctx;
+        UFIBER_REGISTRY(ctx.record().set_executor(typeid(Executor)));
         BOOST_TRY
         {
             yield_token<Executor> token{std::move(executor_), ctx};
-            boost::asio::post(token);
+            if (start_ == start_mode::dispatch)
+            {
+                // Doesn't suspend if the spawning thread runs the executor
+                boost::asio::dispatch(token);
+            }
+            else
+            {
+                boost::asio::post(token);
+            }
             f_(std::move(token));
         }
         BOOST_CATCH(Exception const&)
         {
+            UFIBER_STATS(detail::stats_on_broken_promise());
             // Ignoring this exception allows an application to cleanup properly
             // if there are pending operations when
             // execution_context::shutdown() is called.
         }
         BOOST_CATCH_END
+        ctx.locals().clear();
+        ctx.arena().release();
+        UFIBER_STATS(detail::stats_on_complete(stack_.size));
         return ctx.final_suspend();
     }
 
     F f_;
     Executor executor_;
+    boost::context::stack_context stack_;
+    reclaim_list* reclaimer_;
+    start_mode start_;
 };
 
+// A StackAllocator may opt into having the stacks of its suspended fibers
+// trimmed by providing a `reclaimer()` member function.
+template<class StackAllocator>
+auto
+reclaimer_of(StackAllocator const& sa, int) -> decltype(sa.reclaimer())
+{
+    return sa.reclaimer();
+}
+
+template<class StackAllocator>
+reclaim_list*
+reclaimer_of(StackAllocator const&, long)
+{
+    return nullptr;
+}
+
+template<class Alloc, class Executor, class F>
+void
+spawn_fiber(Alloc&& sa,
+            Executor const& ex,
+            F&& f,
+            start_mode start = start_mode::post)
+{
+    // The stack is allocated up front, so that the fiber knows the bounds of
+    // its own stack.
+    reclaim_list* reclaimer = detail::reclaimer_of(sa, 0);
+    auto sctx = sa.allocate();
+    boost::context::fiber fiber;
+    BOOST_TRY
+    {
+        // The fiber's record takes the allocator and the main function without
+        // throwing, so until the fiber exists the stack is still ours, e.g. if
+        // moving `f` throws.
+        fiber = boost::context::fiber{
+          std::allocator_arg,
+          boost::context::preallocated{sctx.sp, sctx.size, sctx},
+          std::forward<Alloc>(sa),
+          fiber_main<typename std::decay<F>::type, Executor>{
+            std::forward<F>(f), ex, sctx, reclaimer, start}};
+    }
+    BOOST_CATCH(...)
+    {
+        sa.deallocate(sctx);
+        BOOST_RETHROW
+    }
+    BOOST_CATCH_END
+    UFIBER_STATS(detail::stats_on_spawn(sctx.size));
+    detail::initial_resume(std::move(fiber));
+}
+
 } // namespace detail
 } // namespace ufiber
 
@@ -241,11 +488,16 @@ public:
     template<class Op, class Token, class... Ts>
     static return_type initiate(Op&& op, Token&& token, Ts&&... ts)
     {
+        ::ufiber::detail::charge_budget(token);
         ::ufiber::detail::promise<Args...> promise;
         ::ufiber::detail::fiber_context& ctx =
           ::ufiber::detail::get_fiber(token);
-        completion_handler_type handler{&promise, token, ctx};
-        ctx.suspend_with([&]() noexcept {
+        UFIBER_REGISTRY(
+          ctx.record().wait_for(typeid(Op), typeid(void(Args...))));
+        ctx.initiate([&] {
+            // If the initiation throws, the handler is destroyed before the
+            // fiber stops expecting a completion.
+            completion_handler_type handler{&promise, token, ctx};
             op(std::move(handler), std::forward<Ts>(ts)...);
         });
         return promise.get_value();
@@ -270,6 +522,22 @@ public:
     }
 };
 
+template<class Executor, class A, class... Args>
+class associated_allocator<
+  ::ufiber::detail::completion_handler<Executor, Args...>,
+  A>
+{
+public:
+    using type = ::ufiber::detail::slab_allocator<void>;
+
+    static type get(
+      ::ufiber::detail::completion_handler<Executor, Args...> const& h,
+      A const& = A()) noexcept
+    {
+        return type{h.promise_.get_deleter().ctx_.slab()};
+    }
+};
+
 } // asio
 
 } // boost
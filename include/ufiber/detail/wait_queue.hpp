@@ -0,0 +1,197 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_WAIT_QUEUE_HPP
+#define UFIBER_DETAIL_WAIT_QUEUE_HPP
+
+#include <ufiber/detail/config.hpp>
+#include <ufiber/detail/ufiber.hpp>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <mutex>
+
+namespace ufiber
+{
+
+class mutex;
+
+namespace detail
+{
+
+// A suspended fiber waiting in a synchronization primitive. Waiters live on the
+// stack of the suspended fiber, so queueing them never allocates.
+struct waiter_base
+{
+    explicit waiter_base(void (*complete)(waiter_base*)) noexcept
+      : complete_{complete}
+    {
+    }
+
+    // Schedules the waiting fiber on its own executor. The waiter must not be
+    // touched afterwards, since the fiber may already be running.
+    void complete() noexcept
+    {
+        complete_(this);
+    }
+
+    waiter_base* next_ = nullptr;
+    // The mutex that a condition_variable waiter reacquires when notified
+    ufiber::mutex* mutex_ = nullptr;
+    void (*complete_)(waiter_base*);
+};
+
+// `Base` lets a primitive attach its own per-waiter state to the node.
+template<class Executor, class Base = waiter_base>
+struct fiber_waiter : Base
+{
+    fiber_waiter() noexcept
+      : Base{&fiber_waiter::do_complete}
+    {
+    }
+
+    static void do_complete(waiter_base* base) noexcept
+    {
+        auto& self = *static_cast<fiber_waiter*>(base);
+        auto handler = std::move(*self.handler_);
+        auto work = std::move(*self.work_);
+        self.handler_ = boost::none;
+        self.work_ = boost::none;
+        boost::asio::post(std::move(handler));
+    }
+
+    boost::optional<completion_handler<Executor>> handler_;
+    // A suspended waiter counts as outstanding work of its executor, like any
+    // other pending asynchronous operation.
+    boost::optional<boost::asio::executor_work_guard<Executor>> work_;
+};
+
+// FIFO list of waiters.
+class waiter_list
+{
+public:
+    void push(waiter_base* w) noexcept
+    {
+        w->next_ = nullptr;
+        if (tail_ != nullptr)
+        {
+            tail_->next_ = w;
+        }
+        else
+        {
+            head_ = w;
+        }
+        tail_ = w;
+    }
+
+    waiter_base* pop() noexcept
+    {
+        auto w = head_;
+        if (w != nullptr)
+        {
+            head_ = w->next_;
+            if (head_ == nullptr)
+            {
+                tail_ = nullptr;
+            }
+        }
+        return w;
+    }
+
+    // Removes all waiters, returning them as a list linked through `next_`
+    waiter_base* pop_all() noexcept
+    {
+        auto w = head_;
+        head_ = tail_ = nullptr;
+        return w;
+    }
+
+    waiter_base* front() const noexcept
+    {
+        return head_;
+    }
+
+    bool empty() const noexcept
+    {
+        return head_ == nullptr;
+    }
+
+private:
+    waiter_base* head_ = nullptr;
+    waiter_base* tail_ = nullptr;
+};
+
+// Wait queue of a counting primitive whose fast path is a single atomic
+// operation on the count. A fiber that failed to take a unit of the count
+// calls `wait()` while it initiates its suspension, still on its own stack. A
+// releaser that observed waiters calls `wake_one()`, possibly before the
+// waiter has made it into the queue, in which case the wakeup is remembered
+// and handed to the next waiter.
+class wait_queue
+{
+public:
+    UFIBER_INLINE_DECL void wait(waiter_base* w) noexcept;
+
+    UFIBER_INLINE_DECL void wake_one() noexcept;
+
+private:
+    std::mutex mutex_;
+    waiter_list waiters_;
+    std::size_t pending_ = 0;
+};
+
+// Suspends the fiber owning `yield` in `w`. `enqueue()` is invoked on the
+// fiber's stack by fiber_context::initiate(), before the fiber switches out.
+// A wakeup may therefore complete the waiter while the fiber is still running,
+// which the handoff state of the fiber_context turns into an inline
+// completion instead of a resumption of a running fiber. If `enqueue()`
+// throws, it must not have queued the waiter.
+template<class Executor, class Base, class Enqueue>
+void
+suspend_waiter(yield_token<Executor>& yield,
+               fiber_waiter<Executor, Base>& w,
+               Enqueue&& enqueue)
+{
+    struct initiation
+    {
+        void operator()(completion_handler<Executor>&& handler)
+        {
+            w_.work_.emplace(handler.executor_);
+            w_.handler_.emplace(std::move(handler));
+            BOOST_TRY
+            {
+                enqueue_();
+            }
+            BOOST_CATCH(...)
+            {
+                // Destroyed while the initiation is still in progress, so
+                // that the fiber isn't resumed by its handler
+                w_.handler_ = boost::none;
+                w_.work_ = boost::none;
+                BOOST_RETHROW
+            }
+            BOOST_CATCH_END
+        }
+
+        fiber_waiter<Executor, Base>& w_;
+        Enqueue& enqueue_;
+    };
+
+    boost::asio::async_initiate<yield_token<Executor>&, void()>(
+      initiation{w, enqueue}, yield);
+}
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_WAIT_QUEUE_HPP
@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_WATCHDOG_HPP
+#define UFIBER_DETAIL_WATCHDOG_HPP
+
+#include <ufiber/detail/config.hpp>
+
+#ifdef UFIBER_ENABLE_WATCHDOG
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#define UFIBER_WATCHDOG(expr) expr
+
+namespace ufiber
+{
+namespace detail
+{
+
+struct watchdog_stamp
+{
+    std::uint64_t run;
+    std::uint64_t fiber;
+    // When the run started, in steady_clock ticks
+    std::int64_t since;
+};
+
+// Identifies the fiber that is currently running on a thread. Every time a
+// fiber is resumed, the thread stores a new run number, so the monitor can
+// tell that a slot which holds the same run number in two samples belongs to
+// a fiber that hasn't suspended in between. A run number of 0 means that no
+// fiber is running. The slot also holds the time at which the run started, so
+// the monitor measures a run from its start rather than from the sample that
+// first saw it.
+struct watchdog_slot
+{
+    UFIBER_INLINE_DECL watchdog_slot();
+    UFIBER_INLINE_DECL ~watchdog_slot();
+
+    watchdog_slot(watchdog_slot const&) = delete;
+    watchdog_slot& operator=(watchdog_slot const&) = delete;
+
+    watchdog_stamp load() const noexcept
+    {
+        return watchdog_stamp{run_.load(std::memory_order_relaxed),
+                              fiber_.load(std::memory_order_relaxed),
+                              since_.load(std::memory_order_relaxed)};
+    }
+
+    void store(watchdog_stamp s) noexcept
+    {
+        fiber_.store(s.fiber, std::memory_order_relaxed);
+        since_.store(s.since, std::memory_order_relaxed);
+        run_.store(s.run, std::memory_order_relaxed);
+    }
+
+    std::atomic<std::uint64_t> run_{0};
+    std::atomic<std::uint64_t> fiber_{0};
+    std::atomic<std::int64_t> since_{0};
+    std::uint64_t next_run_ = 0;
+    std::size_t index_ = 0;
+    watchdog_slot* prev_ = nullptr;
+    watchdog_slot* next_ = nullptr;
+};
+
+class watchdog_registry
+{
+public:
+    UFIBER_INLINE_DECL static watchdog_registry& instance() noexcept;
+
+    // Calls `f(index, stamp)` for each thread that has run a fiber
+    template<class F>
+    void for_each(F&& f)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        for (auto s = head_; s != nullptr; s = s->next_)
+        {
+            auto const stamp = s->load();
+            // The fiber may have been switched in between the two loads
+            if (s->run_.load(std::memory_order_relaxed) == stamp.run)
+            {
+                f(s->index_, stamp);
+            }
+        }
+    }
+
+private:
+    friend struct watchdog_slot;
+
+    std::mutex mutex_;
+    watchdog_slot* head_ = nullptr;
+    std::size_t next_index_ = 0;
+};
+
+inline watchdog_slot&
+local_watchdog_slot() noexcept
+{
+    static thread_local watchdog_slot slot;
+    return slot;
+}
+
+// Marks the start of a fiber's run on this thread and returns the previous
+// stamp, which is not empty if a fiber resumes another one directly.
+inline watchdog_stamp
+watchdog_enter(std::uint64_t fiber) noexcept
+{
+    auto& slot = local_watchdog_slot();
+    auto const prev = slot.load();
+    slot.store(watchdog_stamp{
+      ++slot.next_run_,
+      fiber,
+      std::chrono::steady_clock::now().time_since_epoch().count()});
+    return prev;
+}
+
+inline void
+watchdog_identify(std::uint64_t fiber) noexcept
+{
+    local_watchdog_slot().fiber_.store(fiber, std::memory_order_relaxed);
+}
+
+inline void
+watchdog_leave(watchdog_stamp prev) noexcept
+{
+    local_watchdog_slot().store(prev);
+}
+
+} // namespace detail
+} // namespace ufiber
+
+#else // UFIBER_ENABLE_WATCHDOG
+
+#define UFIBER_WATCHDOG(expr)
+
+#endif // UFIBER_ENABLE_WATCHDOG
+
+#endif // UFIBER_DETAIL_WATCHDOG_HPP
@@ -0,0 +1,272 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_DETAIL_WHEN_HPP
+#define UFIBER_DETAIL_WHEN_HPP
+
+#include <ufiber/detail/config.hpp>
+#include <ufiber/detail/ufiber.hpp>
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/optional.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace ufiber
+{
+
+class leg_token;
+
+namespace detail
+{
+
+// What a leg stores for its completion signature: nothing, the single
+// argument, or a tuple of all arguments.
+template<class... Args>
+struct leg_value
+{
+    using type = std::tuple<typename std::decay<Args>::type...>;
+};
+
+template<class Arg>
+struct leg_value<Arg>
+{
+    using type = typename std::decay<Arg>::type;
+};
+
+// The return type of an initiating function invoked with a leg_token, which
+// carries the completion signature back to when_all and when_any.
+template<class... Args>
+struct leg_signature
+{
+    using result_type = typename leg_value<Args...>::type;
+};
+
+template<class Op>
+using leg_result_t = typename decltype(
+  std::declval<typename std::decay<Op>::type&>()(
+    std::declval<leg_token>()))::result_type;
+
+struct leg_cancel
+{
+    void* op_;
+    void (*cancel_)(void*);
+};
+
+template<class Op>
+void
+cancel_leg(void* op)
+{
+    static_cast<Op*>(op)->cancel();
+}
+
+template<class Op>
+auto
+make_leg_cancel(Op& op, int) -> decltype(op.cancel(), leg_cancel())
+{
+    return leg_cancel{std::addressof(op), &detail::cancel_leg<Op>};
+}
+
+template<class Op>
+leg_cancel
+make_leg_cancel(Op&, long)
+{
+    return leg_cancel{nullptr, nullptr};
+}
+
+// Shared by the completion handlers of the legs started by one when_all or
+// when_any call. It lives on the suspended fiber's stack. An extra count is
+// held while the legs are being started, so that the fiber can't be resumed
+// before the last leg has been started. If starting a leg throws, only the
+// legs that have bound a handler are waited for.
+class when_state_base
+{
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    when_state_base(std::size_t legs,
+                    void* const* slots,
+                    leg_cancel const* cancels,
+                    bool any,
+                    void (*finish)(when_state_base*)) noexcept
+      : remaining_{legs + 1}
+      , legs_{legs}
+      , slots_{slots}
+      , cancels_{cancels}
+      , any_{any}
+      , finish_{finish}
+    {
+    }
+
+    when_state_base(when_state_base const&) = delete;
+    when_state_base& operator=(when_state_base const&) = delete;
+
+    void* slot(std::size_t index) const noexcept
+    {
+        return slots_[index];
+    }
+
+    std::size_t winner() const noexcept
+    {
+        return winner_.load(std::memory_order_relaxed);
+    }
+
+    bool abandoned() const noexcept
+    {
+        return abandoned_.load(std::memory_order_relaxed);
+    }
+
+    // Called by the fiber when a leg's handler is created, while the legs
+    // are being started
+    void bind() noexcept
+    {
+        ++bound_;
+    }
+
+    // Called once all legs have been started
+    UFIBER_INLINE_DECL void started() noexcept;
+
+    // Called instead of started() if starting a leg has thrown. Cancels the
+    // legs that have bound a handler and stops waiting for the others.
+    UFIBER_INLINE_DECL void abort() noexcept;
+
+    // Called once by every leg. A leg whose handler was destroyed without
+    // being invoked is abandoned.
+    UFIBER_INLINE_DECL void complete(std::size_t index,
+                                     bool abandoned) noexcept;
+
+private:
+    UFIBER_INLINE_DECL void cancel_losers() noexcept;
+
+    UFIBER_INLINE_DECL void release() noexcept;
+
+    std::atomic<std::size_t> remaining_;
+    std::atomic<std::size_t> winner_{npos};
+    std::atomic<bool> started_{false};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> abandoned_{false};
+    std::size_t const legs_;
+    std::size_t bound_ = 0;
+    void* const* slots_;
+    leg_cancel const* cancels_;
+    bool const any_;
+    void (*finish_)(when_state_base*);
+};
+
+template<class Executor>
+class when_state : public when_state_base
+{
+public:
+    when_state(std::size_t legs,
+               void* const* slots,
+               leg_cancel const* cancels,
+               bool any,
+               void* promise,
+               yield_token<Executor>& yield,
+               fiber_context& ctx)
+      : when_state_base{legs, slots, cancels, any, &when_state::do_finish}
+      , handler_{promise, yield, ctx}
+      , work_{handler_.executor_}
+    {
+    }
+
+private:
+    static void do_finish(when_state_base* base) noexcept
+    {
+        auto& self = *static_cast<when_state*>(base);
+        // Both are moved off the fiber's stack, which may be gone once the
+        // fiber has been resumed.
+        auto work = std::move(self.work_);
+        auto handler = std::move(self.handler_);
+        if (self.abandoned())
+        {
+            // Destroying the handler resumes the fiber with broken_promise
+            return;
+        }
+        boost::asio::dispatch(std::move(handler));
+    }
+
+    completion_handler<Executor> handler_;
+    // The legs may run on other executors, so the fiber's own executor is
+    // kept busy until it is resumed.
+    boost::asio::executor_work_guard<Executor> work_;
+};
+
+template<class... Args>
+class leg_handler
+{
+public:
+    using result_type = typename leg_value<Args...>::type;
+
+    explicit leg_handler(leg_token const& token) noexcept;
+
+    leg_handler(leg_handler&& other) noexcept
+      : state_{other.state_}
+      , index_{other.index_}
+    {
+        other.state_ = nullptr;
+    }
+
+    leg_handler& operator=(leg_handler&&) = delete;
+
+    ~leg_handler()
+    {
+        if (state_ != nullptr)
+        {
+            state_->complete(index_, true);
+        }
+    }
+
+    template<class... Ts>
+    void operator()(Ts&&... ts)
+    {
+        auto const state = state_;
+        state_ = nullptr;
+        static_cast<boost::optional<result_type>*>(state->slot(index_))
+          ->emplace(std::forward<Ts>(ts)...);
+        state->complete(index_, false);
+    }
+
+private:
+    when_state_base* state_;
+    std::size_t index_;
+};
+
+template<class Executor, class... Ops>
+struct when_launcher;
+
+template<class Op, class Cancel>
+struct cancellable_op
+{
+    template<class Token>
+    auto operator()(Token&& token) -> decltype(
+      std::declval<Op&>()(std::forward<Token>(token)))
+    {
+        return op_(std::forward<Token>(token));
+    }
+
+    void cancel()
+    {
+        cancel_();
+    }
+
+    Op op_;
+    Cancel cancel_;
+};
+
+} // namespace detail
+} // namespace ufiber
+
+#endif // UFIBER_DETAIL_WHEN_HPP
@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_FIBER_LOCAL_HPP
+#define UFIBER_FIBER_LOCAL_HPP
+
+#include <ufiber/ufiber.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @file
+ * Storage local to a fiber.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Returns whether the calling code runs on a fiber.
+ */
+inline bool
+in_fiber() noexcept
+{
+    return detail::current_fiber() != nullptr;
+}
+
+/**
+ * A variable with a separate value for each fiber, which stays with the fiber
+ * when an executor resumes it on another thread. Use it where `thread_local`
+ * would otherwise be used, e.g. for per-request caches.
+ *
+ * A value is created the first time a fiber accesses it, and destroyed when
+ * the fiber's main function has returned or has been unwound by
+ * `broken_promise`. Access is an index into a per-fiber slot array, without
+ * locking or hashing. The index of a destroyed fiber_local is reused, so
+ * fiber_locals with automatic or member storage don't grow the slot arrays.
+ *
+ * All member functions except the constructor and destructor must be called
+ * from a fiber.
+ *
+ * @tparam T the type of the values, which must be DefaultConstructible for
+ * `get()`.
+ */
+template<class T>
+class fiber_local
+{
+public:
+    fiber_local() noexcept
+      : key_{detail::local_registry::instance().acquire()}
+    {
+    }
+
+    /**
+     * Destroying a fiber_local does not destroy values that fibers have
+     * created through it. These are destroyed when the fibers finish, or when
+     * a fiber_local that reuses the index sets a value.
+     */
+    ~fiber_local()
+    {
+        detail::local_registry::instance().release(key_.index_);
+    }
+
+    fiber_local(fiber_local const&) = delete;
+    fiber_local& operator=(fiber_local const&) = delete;
+
+    /**
+     * Returns the value of the calling fiber, default constructing it first if
+     * the fiber doesn't have one yet.
+     */
+    T& get()
+    {
+        auto const s = find();
+        if (s != nullptr && s->value_ != nullptr)
+        {
+            return *static_cast<T*>(s->value_);
+        }
+        return emplace();
+    }
+
+    /**
+     * Replaces the value of the calling fiber with a `T` constructed from
+     * `args`.
+     */
+    template<class... Args>
+    T& emplace(Args&&... args);
+
+    /**
+     * Returns whether the calling fiber has a value.
+     */
+    bool has_value() noexcept
+    {
+        auto const s = find();
+        return s != nullptr && s->value_ != nullptr;
+    }
+
+    /**
+     * Destroys the value of the calling fiber, if it has one.
+     */
+    void reset() noexcept;
+
+    T& operator*()
+    {
+        return get();
+    }
+
+    T* operator->()
+    {
+        return &get();
+    }
+
+private:
+    static void destroy(void* p) noexcept
+    {
+        delete static_cast<T*>(p);
+    }
+
+    static detail::fiber_locals& locals() noexcept
+    {
+        assert(in_fiber() && "fiber_local used outside of a fiber");
+        return detail::current_fiber()->locals();
+    }
+
+    // The slot of the calling fiber, if it holds a value of this object
+    detail::local_slot* find() noexcept
+    {
+        auto const s = locals().find(key_.index_);
+        return s != nullptr && s->owner_ == key_.id_ ? s : nullptr;
+    }
+
+    detail::local_key const key_;
+};
+
+} // namespace ufiber
+
+#include <ufiber/impl/fiber_local.hpp>
+
+#endif // UFIBER_FIBER_LOCAL_HPP
@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_ARENA_IPP
+#define UFIBER_IMPL_ARENA_IPP
+
+#include <ufiber/arena.hpp>
+
+#include <new>
+#include <utility>
+
+namespace ufiber
+{
+
+void
+fiber_arena::reset() noexcept
+{
+    auto keep = spare_;
+    for (auto b = blocks_; b != nullptr;)
+    {
+        auto const next = b->next_;
+        if (keep == nullptr || b->size_ > keep->size_)
+        {
+            std::swap(keep, b);
+        }
+        if (b != nullptr)
+        {
+            ::operator delete(b);
+        }
+        b = next;
+    }
+    spare_ = keep;
+    blocks_ = nullptr;
+    current_ = initial_;
+    end_ = initial_ + initial_size_;
+}
+
+void
+fiber_arena::release() noexcept
+{
+    reset();
+    if (spare_ != nullptr)
+    {
+        ::operator delete(spare_);
+        spare_ = nullptr;
+    }
+}
+
+void*
+fiber_arena::grow(std::size_t size, std::size_t align)
+{
+    // Aligning the start of the usable space skips fewer than `align` bytes
+    auto const need = sizeof(block) + size + align;
+    block* b = nullptr;
+    if (spare_ != nullptr && spare_->size_ >= need)
+    {
+        b = spare_;
+        spare_ = nullptr;
+    }
+    else
+    {
+        std::size_t n = UFIBER_ARENA_MIN_BLOCK;
+        if (blocks_ != nullptr)
+        {
+            n = blocks_->size_ * 2;
+        }
+        if (n < need)
+        {
+            n = need;
+        }
+        b = static_cast<block*>(::operator new(n));
+        b->size_ = n;
+    }
+    b->next_ = blocks_;
+    blocks_ = b;
+    use(b);
+    auto const p = align_up(current_, align);
+    current_ = p + size;
+    return p;
+}
+
+void
+fiber_arena::use(block* b) noexcept
+{
+    current_ = reinterpret_cast<char*>(b + 1);
+    end_ = reinterpret_cast<char*>(b) + b->size_;
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_ARENA_IPP
@@ -0,0 +1,294 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_CHANNEL_HPP
+#define UFIBER_IMPL_CHANNEL_HPP
+
+#include <ufiber/channel.hpp>
+
+namespace ufiber
+{
+
+template<class T>
+channel<T>::channel(std::size_t capacity)
+  : buffer_{new storage_type[capacity]}
+  , capacity_{capacity}
+{
+}
+
+template<class T>
+channel<T>::~channel()
+{
+    for (std::size_t i = 0; i < size_; ++i)
+    {
+        slot(i)->~T();
+    }
+}
+
+template<class T>
+template<class Executor>
+boost::system::error_code
+channel<T>::send(T value, yield_token<Executor>& yield)
+{
+    op_type* woken = nullptr;
+    status s;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        s = send_locked(value, woken);
+    }
+    if (woken != nullptr)
+    {
+        woken->complete();
+    }
+    if (s != status::would_block)
+    {
+        return s == status::closed ? channel_errc::closed
+                                   : boost::system::error_code{};
+    }
+
+    // The value is kept on this fiber's stack until a receiver takes it
+    boost::optional<T> v{std::move(value)};
+    detail::fiber_waiter<Executor, op_type> w;
+    w.value_ = &v;
+    detail::suspend_waiter(yield, w, [&] {
+        op_type* woken = nullptr;
+        status s;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            s = send_locked(*v, woken);
+            if (s == status::would_block)
+            {
+                senders_.push(&w);
+            }
+        }
+        if (woken != nullptr)
+        {
+            woken->complete();
+        }
+        if (s != status::would_block)
+        {
+            if (s == status::closed)
+            {
+                w.ec_ = channel_errc::closed;
+            }
+            w.complete();
+        }
+    });
+    return w.ec_;
+}
+
+template<class T>
+template<class Executor>
+std::tuple<boost::system::error_code, T>
+channel<T>::receive(yield_token<Executor>& yield)
+{
+    boost::optional<T> v;
+    op_type* woken = nullptr;
+    status s;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        s = receive_locked(v, woken);
+    }
+    if (woken != nullptr)
+    {
+        woken->complete();
+    }
+
+    boost::system::error_code ec;
+    if (s == status::closed)
+    {
+        ec = channel_errc::closed;
+    }
+    else if (s == status::would_block)
+    {
+        detail::fiber_waiter<Executor, op_type> w;
+        w.value_ = &v;
+        detail::suspend_waiter(yield, w, [&] {
+            op_type* woken = nullptr;
+            status s;
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                s = receive_locked(v, woken);
+                if (s == status::would_block)
+                {
+                    receivers_.push(&w);
+                }
+            }
+            if (woken != nullptr)
+            {
+                woken->complete();
+            }
+            if (s != status::would_block)
+            {
+                if (s == status::closed)
+                {
+                    w.ec_ = channel_errc::closed;
+                }
+                w.complete();
+            }
+        });
+        ec = w.ec_;
+    }
+
+    if (ec)
+    {
+        return std::tuple<boost::system::error_code, T>{ec, T{}};
+    }
+    return std::tuple<boost::system::error_code, T>{ec, std::move(*v)};
+}
+
+template<class T>
+bool
+channel<T>::try_send(T& value)
+{
+    op_type* woken = nullptr;
+    status s;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        s = send_locked(value, woken);
+    }
+    if (woken != nullptr)
+    {
+        woken->complete();
+    }
+    return s == status::done;
+}
+
+template<class T>
+bool
+channel<T>::try_receive(T& value)
+{
+    boost::optional<T> v;
+    op_type* woken = nullptr;
+    status s;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        s = receive_locked(v, woken);
+    }
+    if (woken != nullptr)
+    {
+        woken->complete();
+    }
+    if (s != status::done)
+    {
+        return false;
+    }
+    value = std::move(*v);
+    return true;
+}
+
+template<class T>
+void
+channel<T>::close() noexcept
+{
+    detail::waiter_base* senders;
+    detail::waiter_base* receivers;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        closed_ = true;
+        senders = senders_.pop_all();
+        receivers = receivers_.pop_all();
+    }
+    for (auto list : {senders, receivers})
+    {
+        while (list != nullptr)
+        {
+            auto op = static_cast<op_type*>(list);
+            list = list->next_;
+            op->ec_ = channel_errc::closed;
+            op->complete();
+        }
+    }
+}
+
+template<class T>
+bool
+channel<T>::is_closed() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return closed_;
+}
+
+template<class T>
+auto
+channel<T>::send_locked(T& value, op_type*& woken) -> status
+{
+    if (closed_)
+    {
+        return status::closed;
+    }
+    if (!receivers_.empty())
+    {
+        // Receivers only wait while the buffer is empty. The receiver is
+        // dequeued once it holds the value, so it keeps waiting if the move
+        // throws.
+        auto const r = static_cast<op_type*>(receivers_.front());
+        r->value_->emplace(std::move(value));
+        woken = static_cast<op_type*>(receivers_.pop());
+        return status::done;
+    }
+    if (size_ < capacity_)
+    {
+        ::new (static_cast<void*>(slot(size_))) T(std::move(value));
+        ++size_;
+        return status::done;
+    }
+    return status::would_block;
+}
+
+template<class T>
+auto
+channel<T>::receive_locked(boost::optional<T>& value, op_type*& woken)
+  -> status
+{
+    if (size_ > 0)
+    {
+        auto front = slot(0);
+        value.emplace(std::move(*front));
+        front->~T();
+        head_ = (head_ + 1) % capacity_;
+        --size_;
+        if (!senders_.empty())
+        {
+            // Refill the buffer from the longest waiting sender. If its value
+            // can't be moved, the value that has been received is kept and
+            // the sender keeps waiting for the next receiver.
+            auto const s = static_cast<op_type*>(senders_.front());
+            BOOST_TRY
+            {
+                ::new (static_cast<void*>(slot(size_)))
+                  T(std::move(**s->value_));
+                ++size_;
+                woken = static_cast<op_type*>(senders_.pop());
+            }
+            BOOST_CATCH(...)
+            {
+            }
+            BOOST_CATCH_END
+        }
+        return status::done;
+    }
+    if (!senders_.empty())
+    {
+        // Only possible with an unbuffered channel
+        auto const s = static_cast<op_type*>(senders_.front());
+        value.emplace(std::move(**s->value_));
+        woken = static_cast<op_type*>(senders_.pop());
+        return status::done;
+    }
+    if (closed_)
+    {
+        return status::closed;
+    }
+    return status::would_block;
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_CHANNEL_HPP
@@ -0,0 +1,51 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_CHANNEL_IPP
+#define UFIBER_IMPL_CHANNEL_IPP
+
+#include <ufiber/channel.hpp>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+class channel_category_impl final : public boost::system::error_category
+{
+public:
+    char const* name() const noexcept override
+    {
+        return "ufiber.channel";
+    }
+
+    std::string message(int ev) const override
+    {
+        switch (static_cast<channel_errc>(ev))
+        {
+            case channel_errc::closed:
+                return "Channel closed";
+        }
+        return "Unknown channel error";
+    }
+};
+
+} // namespace detail
+
+boost::system::error_category const&
+channel_category() noexcept
+{
+    static detail::channel_category_impl const category;
+    return category;
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_CHANNEL_IPP
@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_DEADLINE_HPP
+#define UFIBER_IMPL_DEADLINE_HPP
+
+#include <ufiber/deadline.hpp>
+
+#include <boost/asio/async_result.hpp>
+
+namespace ufiber
+{
+
+template<class Executor, class Cancel>
+deadline_token<Executor, typename std::decay<Cancel>::type>
+with_deadline(yield_token<Executor> const& yield,
+              std::chrono::steady_clock::time_point expiry,
+              Cancel&& cancel)
+{
+    using cancel_type = typename std::decay<Cancel>::type;
+    return deadline_token<Executor, cancel_type>{
+      yield, expiry, cancel_type(std::forward<Cancel>(cancel))};
+}
+
+template<class Executor, class Rep, class Period, class Cancel>
+deadline_token<Executor, typename std::decay<Cancel>::type>
+with_timeout(yield_token<Executor> const& yield,
+             std::chrono::duration<Rep, Period> timeout,
+             Cancel&& cancel)
+{
+    return with_deadline(
+      yield,
+      std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          timeout),
+      std::forward<Cancel>(cancel));
+}
+
+template<class Executor>
+void
+sleep_until(yield_token<Executor>& yield,
+            std::chrono::steady_clock::time_point expiry)
+{
+    auto& svc = boost::asio::use_service<detail::deadline_service>(
+      detail::timer_context(yield.get_executor().context()));
+    detail::fiber_context& ctx = detail::get_fiber(yield);
+    detail::promise<> promise;
+    detail::sleep_op<Executor> entry{expiry, promise, yield};
+    UFIBER_REGISTRY(ctx.record().wait_for(typeid(detail::sleep_op<Executor>),
+                                          typeid(void())));
+    ctx.initiate([&] { svc.add(entry, [] {}); });
+    promise.get_value();
+}
+
+template<class Executor, class Rep, class Period>
+void
+sleep_for(yield_token<Executor>& yield,
+          std::chrono::duration<Rep, Period> duration)
+{
+    ufiber::sleep_until(
+      yield,
+      std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          duration));
+}
+
+} // namespace ufiber
+
+namespace boost
+{
+
+namespace asio
+{
+
+template<class Executor, class Cancel, class... Args>
+class async_result<::ufiber::deadline_token<Executor, Cancel>, void(Args...)>
+{
+public:
+    using completion_handler_type =
+      ::ufiber::detail::completion_handler<Executor, Args...>;
+
+    using return_type = ::ufiber::detail::result_t<Args...>;
+
+    template<class Op, class Token, class... Ts>
+    static return_type initiate(Op&& op, Token&& token, Ts&&... ts)
+    {
+        auto& yield = token.yield_;
+        ::ufiber::detail::charge_budget(yield);
+        ::ufiber::detail::promise<Args...> promise;
+        ::ufiber::detail::fiber_context& ctx =
+          ::ufiber::detail::get_fiber(yield);
+        auto& svc =
+          boost::asio::use_service<::ufiber::detail::deadline_service>(
+            ::ufiber::detail::timer_context(yield.get_executor().context()));
+        ::ufiber::detail::deadline_op<Cancel> entry{token.expiry_,
+                                                    token.cancel_};
+        // Also runs when the fiber is resumed with broken_promise, or when
+        // initiation throws, so the entry never outlives this frame.
+        ::ufiber::detail::deadline_scope scope{svc, entry};
+        UFIBER_REGISTRY(
+          ctx.record().wait_for(typeid(Op), typeid(void(Args...))));
+        ctx.initiate([&] {
+            completion_handler_type handler{&promise, yield, ctx};
+            svc.add(entry, [&] {
+                op(std::move(handler), std::forward<Ts>(ts)...);
+            });
+        });
+        return promise.get_value();
+    }
+
+    return_type get() = delete;
+};
+
+} // asio
+
+} // boost
+
+#endif // UFIBER_IMPL_DEADLINE_HPP
@@ -0,0 +1,474 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_DEADLINE_IPP
+#define UFIBER_IMPL_DEADLINE_IPP
+
+#include <ufiber/deadline.hpp>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+timer_wheel::tick_type
+timer_wheel::insert(deadline_entry* e, tick_type t) noexcept
+{
+    e->tick_ = t > now_ ? t : now_ + 1;
+    ++size_;
+    return place(e);
+}
+
+void
+timer_wheel::erase(deadline_entry* e) noexcept
+{
+    auto& head = slots_[e->level_][e->slot_];
+    if (e->next_ == e)
+    {
+        head = nullptr;
+        occupied_[e->level_] &= ~(std::uint64_t{1} << e->slot_);
+    }
+    else
+    {
+        e->prev_->next_ = e->next_;
+        e->next_->prev_ = e->prev_;
+        if (head == e)
+        {
+            head = e->next_;
+        }
+    }
+    e->level_ = deadline_entry::unlinked;
+    --size_;
+}
+
+deadline_entry*
+timer_wheel::advance(tick_type t) noexcept
+{
+    deadline_entry* expired = nullptr;
+    auto tail = &expired;
+    // Jumps from one tick with work to the next. The slots that are passed on
+    // the way are empty, so their cascades would do nothing.
+    while (size_ != 0)
+    {
+        auto const next = next_tick();
+        if (next > t)
+        {
+            break;
+        }
+        now_ = next;
+        for (auto level = levels - 1; level > 0; --level)
+        {
+            auto const mask = (tick_type{1} << (bits * level)) - 1;
+            if ((now_ & mask) == 0)
+            {
+                cascade(level);
+            }
+        }
+        take(0, now_ & (slots - 1), tail);
+    }
+    if (now_ < t)
+    {
+        now_ = t;
+    }
+    *tail = nullptr;
+    return expired;
+}
+
+deadline_entry*
+timer_wheel::clear() noexcept
+{
+    deadline_entry* all = nullptr;
+    auto tail = &all;
+    for (unsigned level = 0; level < levels; ++level)
+    {
+        for (tick_type slot = 0; slot < slots; ++slot)
+        {
+            take(level, slot, tail);
+        }
+    }
+    *tail = nullptr;
+    return all;
+}
+
+timer_wheel::tick_type
+timer_wheel::next_tick() const noexcept
+{
+    auto best = ~tick_type{0};
+    for (unsigned level = 0; level < levels; ++level)
+    {
+        if (occupied_[level] == 0)
+        {
+            continue;
+        }
+        // Slots are visited in the order of their ranges, starting after the
+        // current one. The current slot itself may hold the entries of its
+        // range in the next rotation of the level.
+        auto const shift = bits * level;
+        auto const current = (now_ >> shift) & (slots - 1);
+        auto const distance =
+          lowest_bit(rotate_right(occupied_[level],
+                                  static_cast<unsigned>(current + 1))) +
+          1;
+        auto const t = ((now_ >> shift) + distance) << shift;
+        if (t < best)
+        {
+            best = t;
+        }
+    }
+    return best;
+}
+
+timer_wheel::tick_type
+timer_wheel::place(deadline_entry* e) noexcept
+{
+    auto const range = tick_type{1} << (bits * levels);
+    auto t = e->tick_;
+    if (t - now_ >= range)
+    {
+        t = now_ + range - 1;
+    }
+    auto const delta = t - now_;
+    unsigned level = 0;
+    while (level + 1 < levels && (delta >> (bits * (level + 1))) != 0)
+    {
+        ++level;
+    }
+    auto const shift = bits * level;
+    auto const slot = (t >> shift) & (slots - 1);
+    auto& head = slots_[level][slot];
+    if (head == nullptr)
+    {
+        e->prev_ = e;
+        e->next_ = e;
+        head = e;
+        occupied_[level] |= std::uint64_t{1} << slot;
+    }
+    else
+    {
+        // Appended, so that entries of the same tick expire in FIFO order
+        e->prev_ = head->prev_;
+        e->next_ = head;
+        head->prev_->next_ = e;
+        head->prev_ = e;
+    }
+    e->level_ = static_cast<unsigned char>(level);
+    e->slot_ = static_cast<unsigned char>(slot);
+    return (t >> shift) << shift;
+}
+
+void
+timer_wheel::cascade(unsigned level) noexcept
+{
+    auto const slot = (now_ >> (bits * level)) & (slots - 1);
+    auto const head = slots_[level][slot];
+    if (head == nullptr)
+    {
+        return;
+    }
+    slots_[level][slot] = nullptr;
+    occupied_[level] &= ~(std::uint64_t{1} << slot);
+    auto e = head;
+    do
+    {
+        auto const next = e->next_;
+        place(e);
+        e = next;
+    } while (e != head);
+}
+
+void
+timer_wheel::take(unsigned level,
+                  tick_type slot,
+                  deadline_entry**& tail) noexcept
+{
+    auto const head = slots_[level][slot];
+    if (head == nullptr)
+    {
+        return;
+    }
+    slots_[level][slot] = nullptr;
+    occupied_[level] &= ~(std::uint64_t{1} << slot);
+    auto e = head;
+    do
+    {
+        auto const next = e->next_;
+        e->level_ = deadline_entry::unlinked;
+        *tail = e;
+        tail = &e->next_;
+        --size_;
+        e = next;
+    } while (e != head);
+}
+
+deadline_service::deadline_service(boost::asio::io_context& io)
+  : boost::asio::execution_context::service{io}
+  , io_{io}
+  , timer_{io}
+{
+}
+
+void
+deadline_service::remove(deadline_entry& e) noexcept
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (e.level_ == deadline_entry::expired)
+    {
+        erase_expired(&e);
+        return;
+    }
+    if (e.level_ != deadline_entry::unlinked)
+    {
+        wheel_.erase(&e);
+        return;
+    }
+    for (;;)
+    {
+        auto f = firing_;
+        while (f != nullptr && f->entry_ != &e)
+        {
+            f = f->next_;
+        }
+        // A canceller that has resumed its own fiber inline on this thread
+        // never touches the entry again once it returns
+        if (f == nullptr || f->thread_ == std::this_thread::get_id())
+        {
+            return;
+        }
+        fired_.wait(lock);
+    }
+}
+
+void
+deadline_service::shutdown()
+{
+    deadline_entry* all = nullptr;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        all = wheel_.clear();
+        while (expired_ != nullptr)
+        {
+            erase_expired(expired_);
+        }
+    }
+    // The operations of the other entries are abandoned by their own
+    // services. Sleeping fibers are unwound with broken_promise, which needs
+    // the lock to be released, since they may remove other entries.
+    while (all != nullptr)
+    {
+        auto const e = all;
+        all = e->next_;
+        if (e->fire_ == nullptr)
+        {
+            auto const s = static_cast<sleep_entry*>(e);
+            s->wake_(s, false);
+        }
+    }
+}
+
+void
+deadline_service::insert(deadline_entry& e)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    // The wheel may lag behind the clock since it was last advanced, which
+    // places the entry on a coarser level, but never makes it expire late.
+    auto const at = wheel_.insert(&e, expiry_tick(e.expiry_));
+    if (time_of(at) < armed_)
+    {
+        BOOST_TRY
+        {
+            arm(time_of(at));
+        }
+        BOOST_CATCH(...)
+        {
+            wheel_.erase(&e);
+            BOOST_RETHROW
+        }
+        BOOST_CATCH_END
+    }
+}
+
+void
+deadline_service::arm(clock::time_point expiry)
+{
+    // Left unarmed if the wait can't be started, so the next entry tries again
+    armed_ = clock::time_point::max();
+    timer_.expires_at(expiry);
+    timer_.async_wait(wait_handler{*this});
+    armed_ = expiry;
+    // A pending wait must not keep the io_context running on its own: only
+    // the operations that have deadlines count as outstanding work.
+    io_.get_executor().on_work_finished();
+}
+
+void
+deadline_service::push_expired(deadline_entry* e) noexcept
+{
+    e->level_ = deadline_entry::expired;
+    if (expired_ == nullptr)
+    {
+        e->prev_ = e;
+        e->next_ = e;
+        expired_ = e;
+    }
+    else
+    {
+        e->prev_ = expired_->prev_;
+        e->next_ = expired_;
+        expired_->prev_->next_ = e;
+        expired_->prev_ = e;
+    }
+}
+
+void
+deadline_service::erase_expired(deadline_entry* e) noexcept
+{
+    if (e->next_ == e)
+    {
+        expired_ = nullptr;
+    }
+    else
+    {
+        e->prev_->next_ = e->next_;
+        e->next_->prev_ = e->prev_;
+        if (expired_ == e)
+        {
+            expired_ = e->next_;
+        }
+    }
+    e->level_ = deadline_entry::unlinked;
+}
+
+void
+deadline_service::on_timer(boost::system::error_code const& ec)
+{
+    // Balances on_work_finished() in arm(), since the wait's own work is
+    // released after this handler returns.
+    io_.get_executor().on_work_started();
+    if (ec == boost::asio::error::operation_aborted)
+    {
+        // The wait has been replaced by one for an earlier deadline
+        return;
+    }
+
+    deadline_entry* sleepers = nullptr;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        armed_ = clock::time_point::max();
+        auto expired = wheel_.advance(tick_at(clock::now()));
+        auto tail = &sleepers;
+        while (expired != nullptr)
+        {
+            auto const e = expired;
+            expired = e->next_;
+            if (e->fire_ != nullptr)
+            {
+                push_expired(e);
+            }
+            else
+            {
+                *tail = e;
+                tail = &e->next_;
+            }
+        }
+        *tail = nullptr;
+        if (!wheel_.empty())
+        {
+            arm(time_of(wheel_.next_tick()));
+        }
+    }
+    fire_expired();
+    wake(sleepers);
+}
+
+void
+deadline_service::fire_expired()
+{
+    // Unlinks a firing record and wakes the fibers that wait for it in
+    // remove(), even if the canceller throws
+    struct retire
+    {
+        ~retire()
+        {
+            {
+                std::lock_guard<std::mutex> lock{svc_.mutex_};
+                auto p = &svc_.firing_;
+                while (*p != &f_)
+                {
+                    p = &(*p)->next_;
+                }
+                *p = f_.next_;
+            }
+            svc_.fired_.notify_all();
+        }
+
+        deadline_service& svc_;
+        firing& f_;
+    };
+
+    for (;;)
+    {
+        firing f{nullptr, std::this_thread::get_id(), nullptr};
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (expired_ == nullptr)
+            {
+                return;
+            }
+            // The fiber can't leave the frame that holds the entry until the
+            // firing record is retired, so the operation is still pending or
+            // its completion has not been observed yet.
+            f.entry_ = expired_;
+            erase_expired(f.entry_);
+            f.next_ = firing_;
+            firing_ = &f;
+        }
+        retire r{*this, f};
+        f.entry_->fire_(f.entry_);
+    }
+}
+
+void
+deadline_service::wake(deadline_entry* sleepers)
+{
+    while (sleepers != nullptr)
+    {
+        auto const s = static_cast<sleep_entry*>(sleepers);
+        sleepers = s->next_;
+        BOOST_TRY
+        {
+            s->wake_(s, true);
+        }
+        BOOST_CATCH(...)
+        {
+            // The handler of `s` has been destroyed, which resumed its fiber
+            // with broken_promise. The remaining sleeps are due at the next
+            // tick.
+            std::lock_guard<std::mutex> lock{mutex_};
+            while (sleepers != nullptr)
+            {
+                auto const e = sleepers;
+                sleepers = e->next_;
+                auto const at = wheel_.insert(e, wheel_.now() + 1);
+                if (time_of(at) < armed_)
+                {
+                    arm(time_of(at));
+                }
+            }
+            BOOST_RETHROW
+        }
+        BOOST_CATCH_END
+    }
+}
+
+} // namespace detail
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_DEADLINE_IPP
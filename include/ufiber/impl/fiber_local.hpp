@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_FIBER_LOCAL_HPP
+#define UFIBER_IMPL_FIBER_LOCAL_HPP
+
+#include <ufiber/fiber_local.hpp>
+
+#include <memory>
+
+namespace ufiber
+{
+
+template<class T>
+template<class... Args>
+T&
+fiber_local<T>::emplace(Args&&... args)
+{
+    // The value is constructed before the slot is looked up, since its
+    // constructor may use other fiber_locals and grow the slot array. The
+    // slot may hold a value of a destroyed fiber_local that had the same
+    // index, which is destroyed too.
+    std::unique_ptr<T> value{new T(std::forward<Args>(args)...)};
+    locals().destroy(key_.index_);
+    auto& s = locals().get(key_.index_);
+    s.value_ = value.get();
+    s.destroy_ = &fiber_local::destroy;
+    s.owner_ = key_.id_;
+    return *value.release();
+}
+
+template<class T>
+void
+fiber_local<T>::reset() noexcept
+{
+    if (find() != nullptr)
+    {
+        locals().destroy(key_.index_);
+    }
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_FIBER_LOCAL_HPP
@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_JOIN_HANDLE_HPP
+#define UFIBER_IMPL_JOIN_HANDLE_HPP
+
+#include <ufiber/join_handle.hpp>
+
+#include <cassert>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+template<class T, class Alloc, class Executor, class F>
+join_handle<T>
+make_join_handle(Alloc&& sa, Executor const& ex, F&& f)
+{
+    return join_handle<T>{detail::spawn_joinable_fiber<T>(
+      std::forward<Alloc>(sa), ex, std::forward<F>(f))};
+}
+
+} // namespace detail
+
+template<class T>
+template<class Executor>
+T
+join_handle<T>::async_join(yield_token<Executor>& yield)
+{
+    assert(joinable() && "Expected a joinable handle");
+    if (!state_->done())
+    {
+        detail::fiber_waiter<Executor> w;
+        detail::suspend_waiter(yield, w, [&] { state_->wait(&w); });
+    }
+    // The result is moved out before the child's stack can be deallocated
+    join_handle released{std::move(*this)};
+    return released.state_->get();
+}
+
+template<class E, class F>
+auto
+spawn_joinable(E const& ex, F&& f) -> typename std::enable_if<
+  boost::asio::is_executor<E>::value,
+  join_handle<detail::spawn_result_t<F, E>>>::type
+{
+    return detail::make_join_handle<detail::spawn_result_t<F, E>>(
+      boost::context::fixedsize_stack{}, ex, std::forward<F>(f));
+}
+
+template<class Ctx, class F>
+auto
+spawn_joinable(Ctx& ctx, F&& f) -> typename std::enable_if<
+  std::is_convertible<Ctx&, boost::asio::execution_context&>::value,
+  join_handle<
+    detail::spawn_result_t<F, typename Ctx::executor_type>>>::type
+{
+    return detail::make_join_handle<
+      detail::spawn_result_t<F, typename Ctx::executor_type>>(
+      boost::context::fixedsize_stack{},
+      ctx.get_executor(),
+      std::forward<F>(f));
+}
+
+template<class Alloc, class E, class F>
+join_handle<detail::spawn_result_t<F, E>>
+spawn_joinable(std::allocator_arg_t, Alloc&& sa, E const& ex, F&& f)
+{
+    return detail::make_join_handle<detail::spawn_result_t<F, E>>(
+      std::forward<Alloc>(sa), ex, std::forward<F>(f));
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_JOIN_HANDLE_HPP
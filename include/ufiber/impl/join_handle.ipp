@@ -0,0 +1,55 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_JOIN_HANDLE_IPP
+#define UFIBER_IMPL_JOIN_HANDLE_IPP
+
+#include <ufiber/join_handle.hpp>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+void
+join_state_base::wait(waiter_base* w) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (!done_.load(std::memory_order_relaxed))
+        {
+            joiner_ = w;
+            return;
+        }
+    }
+    w->complete();
+}
+
+void
+join_state_base::finish() noexcept
+{
+    waiter_base* w;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        done_.store(true, std::memory_order_release);
+        w = joiner_;
+        joiner_ = nullptr;
+    }
+    if (w != nullptr)
+    {
+        w->complete();
+    }
+}
+
+} // namespace detail
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_JOIN_HANDLE_IPP
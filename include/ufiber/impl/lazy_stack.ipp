@@ -0,0 +1,147 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_LAZY_STACK_IPP
+#define UFIBER_IMPL_LAZY_STACK_IPP
+
+#include <ufiber/lazy_stack.hpp>
+
+#include <boost/assert.hpp>
+#include <boost/context/stack_traits.hpp>
+#include <boost/core/ignore_unused.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <new>
+
+extern "C" {
+#include <sys/mman.h>
+}
+
+#if defined(BOOST_USE_VALGRIND)
+#include <valgrind/valgrind.h>
+#endif
+
+namespace ufiber
+{
+
+stack_reclaimer::stack_reclaimer(std::chrono::steady_clock::duration threshold,
+                                 advice adv) noexcept
+  : threshold_{threshold}
+  , advice_{adv}
+{
+}
+
+std::size_t
+stack_reclaimer::reclaim() noexcept
+{
+    using record = detail::park_record;
+    auto const page = boost::context::stack_traits::page_size();
+    auto const now = std::chrono::steady_clock::now().time_since_epoch();
+#if defined(MADV_FREE)
+    int const adv = advice_ == advice::free ? MADV_FREE : MADV_DONTNEED;
+#else
+    int const adv = MADV_DONTNEED;
+#endif
+
+    std::size_t released = 0;
+    std::unique_lock<std::mutex> lock{list_.mutex_};
+    for (auto r = list_.head_; r != nullptr; r = r->next_)
+    {
+        auto s = r->state_.load(std::memory_order_acquire);
+        if (s != record::parked ||
+            now.count() - r->since_.load(std::memory_order_relaxed) <
+              threshold_.count())
+        {
+            continue;
+        }
+        if (!r->state_.compare_exchange_strong(
+              s, record::trimming, std::memory_order_acquire))
+        {
+            continue;
+        }
+
+        // Skip the guard page and keep one page below the suspension point,
+        // which holds the frames of the context switch itself.
+        auto const bottom =
+          reinterpret_cast<std::uintptr_t>(r->stack_.sp) - r->stack_.size;
+        auto const lo = (bottom + 2 * page - 1) & ~(page - 1);
+        auto const hi =
+          (reinterpret_cast<std::uintptr_t>(r->sp_) & ~(page - 1)) - page;
+
+        lock.unlock();
+        if (hi > lo &&
+            ::madvise(reinterpret_cast<void*>(lo), hi - lo, adv) == 0)
+        {
+            released += hi - lo;
+        }
+        // A trimming record cannot be removed from the list, because its
+        // fiber cannot be resumed and terminate in the meantime.
+        lock.lock();
+        r->state_.store(record::trimmed, std::memory_order_release);
+    }
+    return released;
+}
+
+lazy_stack::lazy_stack(std::size_t size, stack_reclaimer* reclaimer) noexcept
+  : size_{size}
+  , reclaimer_{reclaimer}
+{
+}
+
+boost::context::stack_context
+lazy_stack::allocate()
+{
+    auto const page = boost::context::stack_traits::page_size();
+    // One additional page at the bottom is used as the guard page
+    std::size_t const size = ((size_ + page - 1) / page + 1) * page;
+    int flags = MAP_PRIVATE | MAP_ANON;
+#if defined(MAP_NORESERVE)
+    flags |= MAP_NORESERVE;
+#endif
+#if defined(BOOST_CONTEXT_USE_MAP_STACK)
+    flags |= MAP_STACK;
+#endif
+    void* vp = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (vp == MAP_FAILED)
+    {
+        boost::throw_exception(std::bad_alloc{});
+    }
+
+    int const result = ::mprotect(vp, page, PROT_NONE);
+    boost::ignore_unused(result);
+    BOOST_ASSERT(result == 0);
+
+    boost::context::stack_context sctx;
+    sctx.size = size;
+    sctx.sp = static_cast<char*>(vp) + size;
+#if defined(BOOST_USE_VALGRIND)
+    sctx.valgrind_stack_id = VALGRIND_STACK_REGISTER(sctx.sp, vp);
+#endif
+    return sctx;
+}
+
+void
+lazy_stack::deallocate(boost::context::stack_context& sctx) noexcept
+{
+    BOOST_ASSERT(sctx.sp);
+#if defined(BOOST_USE_VALGRIND)
+    VALGRIND_STACK_DEREGISTER(sctx.valgrind_stack_id);
+#endif
+    ::munmap(static_cast<char*>(sctx.sp) - sctx.size, sctx.size);
+}
+
+detail::reclaim_list*
+lazy_stack::reclaimer() const noexcept
+{
+    return reclaimer_ != nullptr ? &reclaimer_->list_ : nullptr;
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_LAZY_STACK_IPP
@@ -0,0 +1,32 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_REGISTRY_HPP
+#define UFIBER_IMPL_REGISTRY_HPP
+
+#include <ufiber/registry.hpp>
+
+namespace ufiber
+{
+
+template<class Executor>
+void
+set_fiber_name(yield_token<Executor>& yield, char const* name) noexcept
+{
+#ifdef UFIBER_ENABLE_REGISTRY
+    detail::get_fiber(yield).record().set_name(name);
+#else
+    (void)yield;
+    (void)name;
+#endif // UFIBER_ENABLE_REGISTRY
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_REGISTRY_HPP
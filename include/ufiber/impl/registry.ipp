@@ -0,0 +1,154 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_REGISTRY_IPP
+#define UFIBER_IMPL_REGISTRY_IPP
+
+#include <ufiber/registry.hpp>
+
+#include <boost/core/demangle.hpp>
+
+#include <ostream>
+
+namespace ufiber
+{
+
+#ifdef UFIBER_ENABLE_REGISTRY
+
+namespace detail
+{
+
+fiber_record::fiber_record(std::uint64_t id) noexcept
+  : id_{id}
+  , resumed_at_{now()}
+{
+    auto& r = fiber_registry::instance();
+    std::lock_guard<std::mutex> lock{r.mutex_};
+    next_ = r.head_;
+    if (next_ != nullptr)
+    {
+        next_->prev_ = this;
+    }
+    r.head_ = this;
+}
+
+fiber_record::~fiber_record()
+{
+    auto& r = fiber_registry::instance();
+    std::lock_guard<std::mutex> lock{r.mutex_};
+    if (prev_ != nullptr)
+    {
+        prev_->next_ = next_;
+    }
+    else
+    {
+        r.head_ = next_;
+    }
+    if (next_ != nullptr)
+    {
+        next_->prev_ = prev_;
+    }
+}
+
+fiber_registry&
+fiber_registry::instance() noexcept
+{
+    static fiber_registry registry;
+    return registry;
+}
+
+} // namespace detail
+
+std::vector<fiber_info>
+live_fibers()
+{
+    auto const name_of = [](std::type_info const* t) {
+        return t == nullptr ? std::string{} : boost::core::demangle(t->name());
+    };
+    // Demangling allocates, so the registry only stays locked while the raw
+    // fields are copied.
+    struct raw_info
+    {
+        std::uint64_t id;
+        char const* name;
+        detail::fiber_record::state_type state;
+        std::int64_t resumed_at;
+        std::type_info const* executor;
+        std::type_info const* operation;
+        std::type_info const* signature;
+    };
+    std::vector<raw_info> raw;
+    detail::fiber_registry::instance().for_each(
+      [&raw](std::uint64_t id,
+             char const* name,
+             detail::fiber_record::state_type state,
+             std::int64_t resumed_at,
+             std::type_info const* executor,
+             std::type_info const* operation,
+             std::type_info const* signature) {
+          raw.push_back(raw_info{
+            id, name, state, resumed_at, executor, operation, signature});
+      });
+
+    auto const now = detail::fiber_record::now();
+    std::vector<fiber_info> fibers;
+    fibers.reserve(raw.size());
+    for (auto const& r : raw)
+    {
+        fibers.push_back(fiber_info{
+          r.id,
+          r.name == nullptr ? std::string{} : std::string{r.name},
+          r.state == detail::fiber_record::running ? fiber_state::running
+                                                   : fiber_state::suspended,
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds{now - r.resumed_at}),
+          name_of(r.executor),
+          name_of(r.operation),
+          name_of(r.signature)});
+    }
+    return fibers;
+}
+
+#else // UFIBER_ENABLE_REGISTRY
+
+std::vector<fiber_info>
+live_fibers()
+{
+    return {};
+}
+
+#endif // UFIBER_ENABLE_REGISTRY
+
+void
+dump_fibers(std::ostream& os)
+{
+    for (auto const& f : live_fibers())
+    {
+        os << "fiber " << f.id;
+        if (!f.name.empty())
+        {
+            os << " \"" << f.name << '"';
+        }
+        os << (f.state == fiber_state::running ? " running" : " suspended")
+           << ", last resumed "
+           << std::chrono::duration_cast<std::chrono::milliseconds>(
+                f.since_resume)
+                .count()
+           << " ms ago, executor: " << f.executor;
+        if (f.state == fiber_state::suspended && !f.signature.empty())
+        {
+            os << ", waiting on: " << f.signature << " in " << f.operation;
+        }
+        os << '\n';
+    }
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_REGISTRY_IPP
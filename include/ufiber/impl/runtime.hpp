@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_RUNTIME_HPP
+#define UFIBER_IMPL_RUNTIME_HPP
+
+#include <ufiber/runtime.hpp>
+
+#include <boost/asio/async_result.hpp>
+
+namespace ufiber
+{
+
+template<class F>
+void
+runtime::spawn_on(std::size_t i, F&& f)
+{
+    using op = detail::spawn_op<stack_pool::allocator_type,
+                                executor_type,
+                                typename std::decay<F>::type>;
+    auto& s = *shards_[i];
+    boost::asio::post(
+      s.io_,
+      op{s.pool_.get_allocator(), s.io_.get_executor(), std::forward<F>(f)});
+}
+
+template<class F>
+void
+runtime::post(std::size_t i, F&& f)
+{
+    boost::asio::post(shards_[i]->io_, std::forward<F>(f));
+}
+
+template<class F, class Executor>
+detail::call_result_t<F>
+runtime::call_on(std::size_t i, F&& f, yield_token<Executor>& yield)
+{
+    using signature =
+      typename detail::call_signature<detail::call_result_t<F>>::type;
+    return boost::asio::async_initiate<yield_token<Executor>&, signature>(
+      detail::call_initiation<executor_type>{get_executor(i)},
+      yield,
+      std::forward<F>(f));
+}
+
+template<class Session>
+boost::asio::ip::tcp::endpoint
+runtime::listen(boost::asio::ip::tcp::endpoint const& endpoint,
+                Session session)
+{
+    using loop = detail::accept_loop<acceptor_type,
+                                     socket_type,
+                                     stack_pool::allocator_type,
+                                     Session>;
+    auto acceptors = open_acceptors(endpoint);
+    auto const local = acceptors.front().local_endpoint();
+    for (std::size_t i = 0; i < acceptors.size(); ++i)
+    {
+        auto& s = *shards_[i];
+        ufiber::spawn(
+          std::allocator_arg,
+          s.pool_.get_allocator(),
+          s.io_.get_executor(),
+          loop{std::move(acceptors[i]), s.pool_.get_allocator(), session});
+    }
+    return local;
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_RUNTIME_HPP
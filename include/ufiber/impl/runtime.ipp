@@ -0,0 +1,287 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_RUNTIME_IPP
+#define UFIBER_IMPL_RUNTIME_IPP
+
+#include <ufiber/runtime.hpp>
+
+#include <boost/asio/executor_work_guard.hpp>
+
+#include <cstddef>
+
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif // __linux__
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+#ifdef SO_REUSEPORT
+// SettableSocketOption that lets several sockets bind to the same port
+class reuse_port
+{
+public:
+    explicit reuse_port(bool enabled) noexcept
+      : value_{enabled ? 1 : 0}
+    {
+    }
+
+    template<class Protocol>
+    int level(Protocol const&) const noexcept
+    {
+        return SOL_SOCKET;
+    }
+
+    template<class Protocol>
+    int name(Protocol const&) const noexcept
+    {
+        return SO_REUSEPORT;
+    }
+
+    template<class Protocol>
+    int const* data(Protocol const&) const noexcept
+    {
+        return &value_;
+    }
+
+    template<class Protocol>
+    std::size_t size(Protocol const&) const noexcept
+    {
+        return sizeof(value_);
+    }
+
+private:
+    int value_;
+};
+#endif // SO_REUSEPORT
+
+// CPUs the process may run on, empty if unknown
+inline std::vector<int>
+allowed_cpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif // __linux__
+    return cpus;
+}
+
+// Pins the calling thread to a CPU, restoring its previous affinity when
+// destroyed. Pinning is best effort, failures are ignored.
+class thread_pin
+{
+public:
+    explicit thread_pin(int cpu) noexcept
+    {
+#ifdef __linux__
+        auto const self = pthread_self();
+        CPU_ZERO(&prev_);
+        saved_ =
+          pthread_getaffinity_np(self, sizeof(prev_), &prev_) == 0;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(self, sizeof(set), &set);
+#else
+        (void)cpu;
+#endif // __linux__
+    }
+
+    thread_pin(thread_pin const&) = delete;
+    thread_pin& operator=(thread_pin const&) = delete;
+
+    ~thread_pin()
+    {
+#ifdef __linux__
+        if (saved_)
+        {
+            pthread_setaffinity_np(pthread_self(), sizeof(prev_), &prev_);
+        }
+#endif // __linux__
+    }
+
+private:
+#ifdef __linux__
+    cpu_set_t prev_;
+    bool saved_ = false;
+#endif // __linux__
+};
+
+} // namespace detail
+
+runtime::runtime(std::size_t shards, bool pin)
+  : pin_{pin}
+{
+    if (shards == 0)
+    {
+        shards = detail::allowed_cpus().size();
+    }
+    if (shards == 0)
+    {
+        shards = std::thread::hardware_concurrency();
+    }
+    if (shards == 0)
+    {
+        shards = 1;
+    }
+    shards_.reserve(shards);
+    for (std::size_t i = 0; i < shards; ++i)
+    {
+        shards_.emplace_back(new shard);
+    }
+}
+
+std::size_t
+runtime::current_shard() const noexcept
+{
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+    {
+        if (shards_[i]->io_.get_executor().running_in_this_thread())
+        {
+            return i;
+        }
+    }
+    return shards_.size();
+}
+
+void
+runtime::run()
+{
+    auto const cpus = pin_ ? detail::allowed_cpus() : std::vector<int>{};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto const body = [&](std::size_t i) {
+        auto& io = shards_[i]->io_;
+        std::unique_ptr<detail::thread_pin> pin;
+        if (!cpus.empty())
+        {
+            pin.reset(new detail::thread_pin{cpus[i % cpus.size()]});
+        }
+        // A shard keeps running while it is idle, until the runtime is
+        // stopped
+        auto guard = boost::asio::make_work_guard(io);
+        BOOST_TRY
+        {
+            io.run();
+        }
+        BOOST_CATCH(...)
+        {
+            {
+                std::lock_guard<std::mutex> lock{error_mutex};
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+            stop();
+        }
+        BOOST_CATCH_END
+    };
+
+    for (auto& s : shards_)
+    {
+        if (s->io_.stopped())
+        {
+            s->io_.restart();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(shards_.size() - 1);
+    BOOST_TRY
+    {
+        for (std::size_t i = 1; i < shards_.size(); ++i)
+        {
+            threads.emplace_back(body, i);
+        }
+    }
+    BOOST_CATCH(...)
+    {
+        stop();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_RETHROW
+    }
+    BOOST_CATCH_END
+
+    body(0);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void
+runtime::stop() noexcept
+{
+    for (auto& s : shards_)
+    {
+        s->io_.stop();
+    }
+}
+
+std::vector<runtime::acceptor_type>
+runtime::open_acceptors(boost::asio::ip::tcp::endpoint const& endpoint)
+{
+#ifdef SO_REUSEPORT
+    auto const n = shards_.size();
+#else
+    std::size_t const n = 1;
+#endif // SO_REUSEPORT
+    std::vector<acceptor_type> acceptors;
+    acceptors.reserve(n);
+    auto ep = endpoint;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        acceptor_type a{shards_[i]->io_.get_executor()};
+        a.open(ep.protocol());
+        a.set_option(acceptor_type::reuse_address{true});
+#ifdef SO_REUSEPORT
+        a.set_option(detail::reuse_port{true});
+#endif // SO_REUSEPORT
+        a.bind(ep);
+        a.listen();
+        // The other shards must join the group on the port picked by the
+        // first one, if the caller has asked for any port
+        ep = a.local_endpoint();
+        acceptors.push_back(std::move(a));
+    }
+    return acceptors;
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_RUNTIME_IPP
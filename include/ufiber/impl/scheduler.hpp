@@ -0,0 +1,57 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_SCHEDULER_HPP
+#define UFIBER_IMPL_SCHEDULER_HPP
+
+#include <ufiber/scheduler.hpp>
+
+#include <type_traits>
+
+namespace ufiber
+{
+
+inline scheduler::executor_type
+scheduler::get_executor() noexcept
+{
+    return executor_type{*this};
+}
+
+template<class F, class Alloc>
+void
+scheduler::executor_type::dispatch(F&& f, Alloc const& a) const
+{
+    if (running_in_this_thread())
+    {
+        typename std::decay<F>::type tmp(std::forward<F>(f));
+        tmp();
+        return;
+    }
+    post(std::forward<F>(f), a);
+}
+
+template<class F, class Alloc>
+void
+scheduler::executor_type::post(F&& f, Alloc const& a) const
+{
+    using op = detail::executor_op<typename std::decay<F>::type, Alloc>;
+    sched_->submit(op::create(std::forward<F>(f), a), false);
+}
+
+template<class F, class Alloc>
+void
+scheduler::executor_type::defer(F&& f, Alloc const& a) const
+{
+    using op = detail::executor_op<typename std::decay<F>::type, Alloc>;
+    sched_->submit(op::create(std::forward<F>(f), a), true);
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_SCHEDULER_HPP
@@ -0,0 +1,471 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_SCHEDULER_IPP
+#define UFIBER_IMPL_SCHEDULER_IPP
+
+#include <ufiber/scheduler.hpp>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+
+#include <exception>
+#include <functional>
+#include <thread>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+// Number of operations a worker runs between checks of the shared queue and
+// polls of the reactor
+constexpr std::size_t scheduler_event_interval = 61;
+
+// Number of consecutive operations a worker takes from its LIFO slot, before
+// the slot's operation has to wait its turn in the queue
+constexpr unsigned scheduler_max_lifo_streak = 3;
+
+class worker_scope
+{
+public:
+    explicit worker_scope(scheduler_worker& w) noexcept
+      : prev_{current_worker()}
+    {
+        current_worker() = &w;
+    }
+
+    worker_scope(worker_scope const&) = delete;
+    worker_scope& operator=(worker_scope const&) = delete;
+
+    ~worker_scope()
+    {
+        current_worker() = prev_;
+    }
+
+private:
+    scheduler_worker* prev_;
+};
+
+} // namespace detail
+
+scheduler::scheduler(boost::asio::io_context& reactor, std::size_t threads)
+  : reactor_{reactor}
+{
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        workers_.emplace_back(new detail::scheduler_worker{*this, i});
+    }
+}
+
+scheduler::~scheduler()
+{
+    shutdown();
+    // Destroying an operation may abandon a fiber, which then runs to
+    // completion and may post more operations.
+    for (;;)
+    {
+        detail::scheduler_op* op = pop_injected();
+        for (auto& w : workers_)
+        {
+            if (op != nullptr)
+            {
+                break;
+            }
+            op = w->lifo_;
+            w->lifo_ = nullptr;
+            if (op == nullptr)
+            {
+                op = w->queue_.pop();
+            }
+        }
+        if (op == nullptr)
+        {
+            break;
+        }
+        op->destroy();
+    }
+    // stop() may have woken a thread that was already returning from the
+    // reactor, which leaves the wakeup queued there. Its operation lives in
+    // `wake_`, so the reactor has to run it before this object goes away.
+    while (wake_.queued_.load(std::memory_order_acquire))
+    {
+        if (reactor_.stopped())
+        {
+            reactor_.restart();
+        }
+        if (reactor_.poll_one() == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+std::size_t
+scheduler::run()
+{
+    if (stopped())
+    {
+        return 0;
+    }
+    if (outstanding_.load(std::memory_order_acquire) == 0)
+    {
+        stop();
+        return 0;
+    }
+
+    if (reactor_.stopped())
+    {
+        reactor_.restart();
+    }
+    // Keeps the thread waiting in the reactor from returning when there is no
+    // I/O in flight
+    auto guard = boost::asio::make_work_guard(reactor_);
+
+    std::atomic<std::size_t> total{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto const body = [&](detail::scheduler_worker& w) {
+        BOOST_TRY
+        {
+            total += run_worker(w);
+        }
+        BOOST_CATCH(...)
+        {
+            {
+                std::lock_guard<std::mutex> lock{error_mutex};
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+            stop();
+        }
+        BOOST_CATCH_END
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers_.size() - 1);
+    BOOST_TRY
+    {
+        for (std::size_t i = 1; i < workers_.size(); ++i)
+        {
+            threads.emplace_back(body, std::ref(*workers_[i]));
+        }
+    }
+    BOOST_CATCH(...)
+    {
+        stop();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_RETHROW
+    }
+    BOOST_CATCH_END
+
+    body(*workers_[0]);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    guard.reset();
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return total;
+}
+
+void
+scheduler::stop() noexcept
+{
+    stopped_.store(true, std::memory_order_release);
+    std::lock_guard<std::mutex> lock{idle_mutex_};
+    cv_.notify_all();
+    if (polling_)
+    {
+        wake_reactor();
+    }
+}
+
+void
+scheduler::work_started() noexcept
+{
+    outstanding_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+scheduler::work_finished() noexcept
+{
+    if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        stop();
+    }
+}
+
+void
+scheduler::submit(detail::scheduler_op* op, bool is_continuation) noexcept
+{
+    work_started();
+    auto const w = detail::current_worker();
+    if (w == nullptr || &w->owner_ != this)
+    {
+        inject(op);
+        return;
+    }
+    if (is_continuation)
+    {
+        push_local(*w, op);
+        return;
+    }
+    auto const prev = w->lifo_;
+    w->lifo_ = op;
+    if (prev != nullptr)
+    {
+        push_local(*w, prev);
+    }
+}
+
+bool
+scheduler::running_in_this_thread() const noexcept
+{
+    auto const w = detail::current_worker();
+    return w != nullptr && &w->owner_ == this;
+}
+
+std::size_t
+scheduler::run_worker(detail::scheduler_worker& w)
+{
+    struct finish_guard
+    {
+        ~finish_guard()
+        {
+            s_.work_finished();
+        }
+
+        scheduler& s_;
+    };
+
+    detail::worker_scope scope{w};
+    std::size_t n = 0;
+    while (!stopped())
+    {
+        auto const op = next_op(w);
+        if (op == nullptr)
+        {
+            park();
+            continue;
+        }
+        {
+            finish_guard guard{*this};
+            op->run();
+        }
+        ++n;
+        if (w.tick_ % detail::scheduler_event_interval == 0)
+        {
+            reactor_.poll();
+        }
+    }
+    return n;
+}
+
+detail::scheduler_op*
+scheduler::next_op(detail::scheduler_worker& w) noexcept
+{
+    detail::scheduler_op* op = nullptr;
+    ++w.tick_;
+    // Check the shared queue every now and then, even when there is local
+    // work, so that it can't be starved.
+    if (w.tick_ % detail::scheduler_event_interval == 0)
+    {
+        op = pop_injected();
+        if (op != nullptr)
+        {
+            return op;
+        }
+    }
+    if (w.lifo_ != nullptr)
+    {
+        op = w.lifo_;
+        w.lifo_ = nullptr;
+        if (w.lifo_streak_ < detail::scheduler_max_lifo_streak)
+        {
+            ++w.lifo_streak_;
+            return op;
+        }
+        // Fibers waking each other up must not starve the rest of the queue
+        push_local(w, op);
+    }
+    w.lifo_streak_ = 0;
+    op = w.queue_.pop();
+    if (op != nullptr)
+    {
+        return op;
+    }
+    op = pop_injected();
+    if (op != nullptr)
+    {
+        return op;
+    }
+    return steal(w);
+}
+
+detail::scheduler_op*
+scheduler::pop_injected() noexcept
+{
+    if (injected_size_.load(std::memory_order_relaxed) == 0)
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock{inject_mutex_};
+    auto const op = injected_.pop();
+    if (op != nullptr)
+    {
+        injected_size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return op;
+}
+
+detail::scheduler_op*
+scheduler::steal(detail::scheduler_worker& w) noexcept
+{
+    auto const n = workers_.size();
+    auto const start = w.next_random() % n;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto& victim = *workers_[(start + i) % n];
+        if (&victim == &w)
+        {
+            continue;
+        }
+        auto const op = w.queue_.steal_from(victim.queue_);
+        if (op != nullptr)
+        {
+            if (!w.queue_.empty())
+            {
+                // Let another idle thread take some of the stolen work
+                wake_one();
+            }
+            return op;
+        }
+    }
+    return nullptr;
+}
+
+void
+scheduler::push_local(detail::scheduler_worker& w,
+                      detail::scheduler_op* op) noexcept
+{
+    if (!w.queue_.push(op))
+    {
+        inject(op);
+        return;
+    }
+    wake_one();
+}
+
+void
+scheduler::inject(detail::scheduler_op* op) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{inject_mutex_};
+        injected_.push(op);
+        injected_size_.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake_one();
+}
+
+bool
+scheduler::has_work() const noexcept
+{
+    if (injected_size_.load(std::memory_order_relaxed) != 0)
+    {
+        return true;
+    }
+    for (auto const& w : workers_)
+    {
+        if (!w->queue_.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+scheduler::park()
+{
+    std::unique_lock<std::mutex> lock{idle_mutex_};
+    idle_.fetch_add(1, std::memory_order_relaxed);
+    // Pairs with the fence in wake_one(), either the work queued before it is
+    // visible here, or the queueing thread sees this thread as idle.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!stopped() && !has_work())
+    {
+        if (!polling_)
+        {
+            polling_ = true;
+            lock.unlock();
+            reactor_.run_one();
+            lock.lock();
+            polling_ = false;
+        }
+        else
+        {
+            ++waiting_;
+            cv_.wait(lock);
+            --waiting_;
+        }
+    }
+    idle_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void
+scheduler::wake_one() noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle_.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock{idle_mutex_};
+    if (waiting_ > 0)
+    {
+        cv_.notify_one();
+    }
+    else if (polling_)
+    {
+        wake_reactor();
+    }
+}
+
+void
+scheduler::wake_reactor() noexcept
+{
+    // Called with idle_mutex_ held. A wakeup that is still queued makes the
+    // next run_one() of the reactor return, so one is enough. Its operation
+    // lives in `wake_`, so posting it doesn't allocate.
+    if (!wake_.queued_.load(std::memory_order_acquire))
+    {
+        wake_.queued_.store(true, std::memory_order_relaxed);
+        boost::asio::post(reactor_, detail::reactor_wakeup{&wake_});
+    }
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_SCHEDULER_IPP
@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_SPAWN_QUEUE_HPP
+#define UFIBER_IMPL_SPAWN_QUEUE_HPP
+
+#include <ufiber/spawn_queue.hpp>
+
+#include <type_traits>
+#include <utility>
+
+namespace ufiber
+{
+
+template<class Executor>
+spawn_queue<Executor>::spawn_queue(Executor const& ex, std::size_t max_live)
+  : ex_{ex}
+  , core_{new detail::admission_core{max_live}}
+{
+}
+
+template<class Executor>
+spawn_queue<Executor>::~spawn_queue()
+{
+    core_->release();
+}
+
+template<class Executor>
+template<class F>
+void
+spawn_queue<Executor>::spawn(F&& f)
+{
+    spawn(std::allocator_arg,
+          boost::context::fixedsize_stack{},
+          std::forward<F>(f));
+}
+
+template<class Executor>
+template<class StackAllocator, class F>
+void
+spawn_queue<Executor>::spawn(std::allocator_arg_t,
+                             StackAllocator&& sa,
+                             F&& f)
+{
+    using alloc_type = typename std::decay<StackAllocator>::type;
+    using fn_type = typename std::decay<F>::type;
+    using entry_type = detail::deferred_fiber<Executor, alloc_type, fn_type>;
+
+    auto const entry =
+      new entry_type{ex_,
+                     alloc_type(std::forward<StackAllocator>(sa)),
+                     fn_type(std::forward<F>(f)),
+                     core_};
+    core_->add_ref();
+    if (!core_->admit(entry))
+    {
+        return;
+    }
+    BOOST_TRY
+    {
+        entry->launch_(entry);
+    }
+    BOOST_CATCH(...)
+    {
+        detail::start_next(core_);
+        entry->destroy_(entry);
+        BOOST_RETHROW
+    }
+    BOOST_CATCH_END
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_SPAWN_QUEUE_HPP
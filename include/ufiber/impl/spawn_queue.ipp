@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_SPAWN_QUEUE_IPP
+#define UFIBER_IMPL_SPAWN_QUEUE_IPP
+
+#include <ufiber/spawn_queue.hpp>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+bool
+admission_core::admit(deferred_spawn* s) noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto const live = live_.load(std::memory_order_relaxed);
+    if (limit_ == 0 || live < limit_)
+    {
+        live_.store(live + 1, std::memory_order_relaxed);
+        return true;
+    }
+    s->next_ = nullptr;
+    if (tail_ != nullptr)
+    {
+        tail_->next_ = s;
+    }
+    else
+    {
+        head_ = s;
+    }
+    tail_ = s;
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+deferred_spawn*
+admission_core::vacate() noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto const next = head_;
+    if (next == nullptr)
+    {
+        live_.fetch_sub(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    head_ = next->next_;
+    if (head_ == nullptr)
+    {
+        tail_ = nullptr;
+    }
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    return next;
+}
+
+deferred_spawn*
+admission_core::abandon() noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto const queued = head_;
+    head_ = nullptr;
+    tail_ = nullptr;
+    pending_.store(0, std::memory_order_relaxed);
+    return queued;
+}
+
+void
+start_next(admission_core* core) noexcept
+{
+    for (;;)
+    {
+        auto const next = core->vacate();
+        if (next == nullptr)
+        {
+            return;
+        }
+        BOOST_TRY
+        {
+            next->launch_(next);
+            return;
+        }
+        BOOST_CATCH(...)
+        {
+            next->destroy_(next);
+        }
+        BOOST_CATCH_END
+    }
+}
+
+void
+abandon_queued(admission_core* core) noexcept
+{
+    for (auto s = core->abandon(); s != nullptr;)
+    {
+        auto const next = s->next_;
+        s->destroy_(s);
+        s = next;
+    }
+}
+
+} // namespace detail
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_SPAWN_QUEUE_IPP
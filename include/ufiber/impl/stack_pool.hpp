@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_STACK_POOL_HPP
+#define UFIBER_IMPL_STACK_POOL_HPP
+
+#include <ufiber/stack_pool.hpp>
+
+namespace ufiber
+{
+
+template<class StackAllocator>
+basic_pooled_stack<StackAllocator>::basic_pooled_stack(
+  std::shared_ptr<state_type> state) noexcept
+  : state_{std::move(state)}
+{
+}
+
+template<class StackAllocator>
+boost::context::stack_context
+basic_pooled_stack<StackAllocator>::allocate()
+{
+    using cache_type = detail::stack_cache<StackAllocator>;
+    auto& e = cache_type::local().get(state_);
+    auto n = cache_type::pop(e);
+    if (n == nullptr)
+    {
+        return state_->sa_.allocate();
+    }
+    return n->sctx_;
+}
+
+template<class StackAllocator>
+void
+basic_pooled_stack<StackAllocator>::deallocate(
+  boost::context::stack_context& sctx) noexcept
+{
+    using cache_type = detail::stack_cache<StackAllocator>;
+    BOOST_TRY
+    {
+        cache_type::push(cache_type::local().get(state_),
+                         detail::make_stack_node(sctx));
+    }
+    BOOST_CATCH(...)
+    {
+        // Registering the pool in this thread's cache failed, give the stack
+        // back to the pool's global list instead.
+        auto n = detail::make_stack_node(sctx);
+        state_->global_.push(n, n, 1);
+    }
+    BOOST_CATCH_END
+}
+
+template<class StackAllocator>
+basic_stack_pool<StackAllocator>::basic_stack_pool(
+  StackAllocator sa,
+  stack_pool_options const& opts)
+  : state_{std::make_shared<detail::stack_pool_state<StackAllocator>>(
+      std::move(sa),
+      opts.high_watermark,
+      opts.low_watermark)}
+{
+    prewarm(opts.prewarm);
+}
+
+template<class StackAllocator>
+basic_stack_pool<StackAllocator>::~basic_stack_pool()
+{
+    detail::stack_cache<StackAllocator>::local().erase(state_.get());
+}
+
+template<class StackAllocator>
+void
+basic_stack_pool<StackAllocator>::prewarm(std::size_t n)
+{
+    // Grouped into batches of the size a refill takes
+    auto const batch =
+      state_->low_watermark_ > 0 ? state_->low_watermark_ : 1;
+    while (n != 0)
+    {
+        auto const count = n < batch ? n : batch;
+        auto const last = detail::make_stack_node(state_->sa_.allocate());
+        auto first = last;
+        std::size_t built = 1;
+        BOOST_TRY
+        {
+            for (; built < count; ++built)
+            {
+                auto const node =
+                  detail::make_stack_node(state_->sa_.allocate());
+                node->next_ = first;
+                first = node;
+            }
+        }
+        BOOST_CATCH(...)
+        {
+            state_->global_.push(first, last, built);
+            BOOST_RETHROW
+        }
+        BOOST_CATCH_END
+        state_->global_.push(first, last, count);
+        n -= count;
+    }
+}
+
+template<class StackAllocator>
+typename basic_stack_pool<StackAllocator>::allocator_type
+basic_stack_pool<StackAllocator>::get_allocator() const noexcept
+{
+    return allocator_type{state_};
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_STACK_POOL_HPP
@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_STACK_PROFILE_HPP
+#define UFIBER_IMPL_STACK_PROFILE_HPP
+
+#include <ufiber/stack_profile.hpp>
+
+namespace ufiber
+{
+
+template<class Tag>
+stack_profile&
+stack_profile_for() noexcept
+{
+    static stack_profile profile;
+    return profile;
+}
+
+template<class StackAllocator>
+measured_stack<StackAllocator>::measured_stack(StackAllocator sa,
+                                               stack_profile& profile) noexcept
+  : sa_{std::move(sa)}
+  , profile_{&profile}
+{
+}
+
+template<class StackAllocator>
+boost::context::stack_context
+measured_stack<StackAllocator>::allocate()
+{
+    auto sctx = sa_.allocate();
+    detail::fill_stack(sctx);
+    return sctx;
+}
+
+template<class StackAllocator>
+void
+measured_stack<StackAllocator>::deallocate(
+  boost::context::stack_context& sctx) noexcept
+{
+    profile_->record(detail::measure_stack(sctx));
+    sa_.deallocate(sctx);
+}
+
+template<class Tag>
+adaptive_stack<Tag>::adaptive_stack(std::size_t max_size,
+                                    std::size_t min_size) noexcept
+  : max_size_{max_size}
+  , min_size_{min_size < max_size ? min_size : max_size}
+{
+}
+
+template<class Tag>
+boost::context::stack_context
+adaptive_stack<Tag>::allocate()
+{
+    auto const size =
+      stack_profile_for<Tag>().recommended_size(min_size_, max_size_);
+    auto sctx = boost::context::protected_fixedsize_stack{size}.allocate();
+    detail::fill_stack(sctx);
+    return sctx;
+}
+
+template<class Tag>
+void
+adaptive_stack<Tag>::deallocate(boost::context::stack_context& sctx) noexcept
+{
+    auto const page = boost::context::stack_traits::page_size();
+    auto const used = detail::measure_stack(sctx);
+    // A fiber that got close to the guard page may have been lucky, so go
+    // back to the upper bound for the following fibers.
+    stack_profile_for<Tag>().record(used, used + 2 * page >= sctx.size);
+    // Deallocation only depends on the size stored in sctx
+    boost::context::protected_fixedsize_stack{}.deallocate(sctx);
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_STACK_PROFILE_HPP
@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_STACK_PROFILE_IPP
+#define UFIBER_IMPL_STACK_PROFILE_IPP
+
+#include <ufiber/stack_profile.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+unsigned char const stack_sentinel = 0xA5;
+
+inline void
+store_max(std::atomic<std::size_t>& peak, std::size_t value) noexcept
+{
+    auto p = peak.load(std::memory_order_relaxed);
+    while (value > p &&
+           !peak.compare_exchange_weak(p, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void
+fill_stack(boost::context::stack_context const& sctx) noexcept
+{
+    auto const page = boost::context::stack_traits::page_size();
+    auto const top = static_cast<unsigned char*>(sctx.sp);
+    auto const bottom = top - sctx.size + page;
+    std::memset(bottom, stack_sentinel, top - bottom);
+}
+
+std::size_t
+measure_stack(boost::context::stack_context const& sctx) noexcept
+{
+    auto const page = boost::context::stack_traits::page_size();
+    auto const top = static_cast<unsigned char const*>(sctx.sp);
+    auto p = top - sctx.size + page;
+
+    // Compare a word at a time, the bottom of the stack is page aligned
+    std::uint64_t pattern;
+    std::memset(&pattern, stack_sentinel, sizeof(pattern));
+    while (p + sizeof(pattern) <= top)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        if (word != pattern)
+        {
+            break;
+        }
+        p += sizeof(pattern);
+    }
+    while (p < top && *p == stack_sentinel)
+    {
+        ++p;
+    }
+    return static_cast<std::size_t>(top - p);
+}
+
+} // namespace detail
+
+void
+stack_profile::record(std::size_t used, bool exhausted) noexcept
+{
+    detail::store_max(peak_, used);
+    total_.fetch_add(used, std::memory_order_relaxed);
+    auto const n = samples_.fetch_add(1, std::memory_order_relaxed) + 1;
+    // The recommendation only follows the last two windows, so that a single
+    // deep fiber doesn't keep the stacks of all later fibers at its size. The
+    // rotation isn't atomic with the samples recorded concurrently, which may
+    // only land in the newer window.
+    if (n % UFIBER_STACK_PROFILE_WINDOW == 0)
+    {
+        previous_.store(current_.exchange(0, std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+    // An exhausted sample saturates its window
+    detail::store_max(current_,
+                      exhausted ? (std::numeric_limits<std::size_t>::max)()
+                                : used);
+}
+
+std::size_t
+stack_profile::peak() const noexcept
+{
+    return peak_.load(std::memory_order_relaxed);
+}
+
+std::size_t
+stack_profile::samples() const noexcept
+{
+    return samples_.load(std::memory_order_relaxed);
+}
+
+std::size_t
+stack_profile::mean() const noexcept
+{
+    auto const n = samples();
+    return n == 0 ? 0 : total_.load(std::memory_order_relaxed) / n;
+}
+
+std::size_t
+stack_profile::recommended_size(std::size_t min_size,
+                                std::size_t max_size) const noexcept
+{
+    auto const current = current_.load(std::memory_order_relaxed);
+    auto const previous = previous_.load(std::memory_order_relaxed);
+    auto const used = current > previous ? current : previous;
+    if (used == 0 || used == (std::numeric_limits<std::size_t>::max)())
+    {
+        return max_size;
+    }
+    auto const page = boost::context::stack_traits::page_size();
+    auto size = used + used / 2;
+    size = (size + page - 1) / page * page;
+    if (size < min_size)
+    {
+        return min_size;
+    }
+    return size < max_size ? size : max_size;
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_STACK_PROFILE_IPP
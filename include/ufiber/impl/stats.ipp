@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_STATS_IPP
+#define UFIBER_IMPL_STATS_IPP
+
+#include <ufiber/stats.hpp>
+
+namespace ufiber
+{
+
+#ifdef UFIBER_ENABLE_STATS
+
+namespace detail
+{
+
+thread_stats::thread_stats()
+{
+    auto& r = stats_registry::instance();
+    std::lock_guard<std::mutex> lock{r.mutex_};
+    next_ = r.head_;
+    if (next_ != nullptr)
+    {
+        next_->prev_ = this;
+    }
+    r.head_ = this;
+}
+
+thread_stats::~thread_stats()
+{
+    // Fold the counters of an exiting thread into the registry, so that the
+    // aggregated totals never go backwards.
+    auto& r = stats_registry::instance();
+    std::lock_guard<std::mutex> lock{r.mutex_};
+    for (int c = 0; c < count; ++c)
+    {
+        r.retired_.add(static_cast<counter>(c), get(static_cast<counter>(c)));
+    }
+    if (prev_ != nullptr)
+    {
+        prev_->next_ = next_;
+    }
+    else
+    {
+        r.head_ = next_;
+    }
+    if (next_ != nullptr)
+    {
+        next_->prev_ = prev_;
+    }
+}
+
+stats_registry&
+stats_registry::instance() noexcept
+{
+    static stats_registry registry;
+    return registry;
+}
+
+void
+stats_registry::collect(stats_block& out)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (int c = 0; c < stats_block::count; ++c)
+    {
+        auto const counter = static_cast<stats_block::counter>(c);
+        out.add(counter, retired_.get(counter));
+        for (auto* t = head_; t != nullptr; t = t->next_)
+        {
+            out.add(counter, t->get(counter));
+        }
+    }
+}
+
+inline fiber_stats
+make_stats(stats_block const& b)
+{
+    auto const& r = stats_registry::instance();
+    auto const value = [&b](stats_block::counter c) {
+        auto const v = b.get(c);
+        return static_cast<std::uint64_t>(v > 0 ? v : 0);
+    };
+    fiber_stats s;
+    s.spawned = value(stats_block::spawned);
+    s.completed = value(stats_block::completed);
+    s.live = static_cast<std::uint64_t>(r.live());
+    s.peak_live = static_cast<std::uint64_t>(r.peak_live());
+    s.suspends = value(stats_block::suspends);
+    s.resumes = value(stats_block::resumes);
+    s.inline_completions = value(stats_block::inline_completions);
+    s.budget_yields = value(stats_block::budget_yields);
+    s.stack_bytes = value(stats_block::stack_bytes);
+    s.broken_promises = value(stats_block::broken_promises);
+    return s;
+}
+
+} // namespace detail
+
+fiber_stats
+get_stats()
+{
+    detail::stats_block total;
+    detail::stats_registry::instance().collect(total);
+    return detail::make_stats(total);
+}
+
+fiber_stats
+get_thread_stats()
+{
+    return detail::make_stats(detail::local_stats());
+}
+
+#else // UFIBER_ENABLE_STATS
+
+fiber_stats
+get_stats()
+{
+    return fiber_stats{};
+}
+
+fiber_stats
+get_thread_stats()
+{
+    return fiber_stats{};
+}
+
+#endif // UFIBER_ENABLE_STATS
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_STATS_IPP
@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_SYNC_HPP
+#define UFIBER_IMPL_SYNC_HPP
+
+#include <ufiber/sync.hpp>
+
+namespace ufiber
+{
+
+template<class Executor>
+void
+mutex::lock(yield_token<Executor>& yield)
+{
+    if (count_.fetch_sub(1, std::memory_order_acquire) > 0)
+    {
+        return;
+    }
+    // unlock() hands the mutex over to us, there's no need to retry
+    detail::fiber_waiter<Executor> w;
+    detail::suspend_waiter(yield, w, [&] { queue_.wait(&w); });
+}
+
+template<class Executor>
+void
+condition_variable::wait(mutex& m, yield_token<Executor>& yield)
+{
+    detail::fiber_waiter<Executor> w;
+    w.mutex_ = &m;
+    detail::suspend_waiter(yield, w, [&] {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            waiters_.push(&w);
+        }
+        m.unlock();
+    });
+}
+
+template<class Executor, class Predicate>
+void
+condition_variable::wait(mutex& m,
+                         yield_token<Executor>& yield,
+                         Predicate pred)
+{
+    while (!pred())
+    {
+        wait(m, yield);
+    }
+}
+
+template<class Executor>
+void
+semaphore::acquire(yield_token<Executor>& yield)
+{
+    if (count_.fetch_sub(1, std::memory_order_acquire) > 0)
+    {
+        return;
+    }
+    detail::fiber_waiter<Executor> w;
+    detail::suspend_waiter(yield, w, [&] { queue_.wait(&w); });
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_SYNC_HPP
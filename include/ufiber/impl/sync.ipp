@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_SYNC_IPP
+#define UFIBER_IMPL_SYNC_IPP
+
+#include <ufiber/sync.hpp>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+void
+wait_queue::wait(waiter_base* w) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (pending_ == 0)
+        {
+            waiters_.push(w);
+            return;
+        }
+        --pending_;
+    }
+    w->complete();
+}
+
+void
+wait_queue::wake_one() noexcept
+{
+    waiter_base* w;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        w = waiters_.pop();
+        if (w == nullptr)
+        {
+            // The waiter has taken its unit of the count, but hasn't been
+            // queued yet
+            ++pending_;
+            return;
+        }
+    }
+    w->complete();
+}
+
+} // namespace detail
+
+bool
+mutex::try_lock() noexcept
+{
+    std::ptrdiff_t expected = 1;
+    return count_.compare_exchange_strong(
+      expected, 0, std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+void
+mutex::unlock() noexcept
+{
+    if (count_.fetch_add(1, std::memory_order_release) < 0)
+    {
+        queue_.wake_one();
+    }
+}
+
+void
+mutex::lock_for(detail::waiter_base* w) noexcept
+{
+    if (count_.fetch_sub(1, std::memory_order_acquire) > 0)
+    {
+        w->complete();
+    }
+    else
+    {
+        queue_.wait(w);
+    }
+}
+
+void
+condition_variable::notify_one() noexcept
+{
+    detail::waiter_base* w;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        w = waiters_.pop();
+    }
+    if (w != nullptr)
+    {
+        w->mutex_->lock_for(w);
+    }
+}
+
+void
+condition_variable::notify_all() noexcept
+{
+    detail::waiter_base* w;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        w = waiters_.pop_all();
+    }
+    while (w != nullptr)
+    {
+        // The waiter may be resumed, and its stack reused, by lock_for()
+        auto next = w->next_;
+        w->mutex_->lock_for(w);
+        w = next;
+    }
+}
+
+bool
+semaphore::try_acquire() noexcept
+{
+    auto count = count_.load(std::memory_order_relaxed);
+    while (count > 0)
+    {
+        if (count_.compare_exchange_weak(count,
+                                         count - 1,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+semaphore::release(std::ptrdiff_t n) noexcept
+{
+    auto const prev = count_.fetch_add(n, std::memory_order_release);
+    if (prev >= 0)
+    {
+        return;
+    }
+    auto const waiters = -prev < n ? -prev : n;
+    for (std::ptrdiff_t i = 0; i < waiters; ++i)
+    {
+        queue_.wake_one();
+    }
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_SYNC_IPP
@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_TASK_GROUP_HPP
+#define UFIBER_IMPL_TASK_GROUP_HPP
+
+#include <ufiber/task_group.hpp>
+
+#include <type_traits>
+
+namespace ufiber
+{
+
+template<class Executor>
+task_group::task_group(yield_token<Executor>& yield, std::size_t limit)
+  : core_{new detail::group_core{limit}}
+  , yield_{&yield}
+  , drain_{&task_group::drain<Executor>}
+{
+}
+
+template<class Executor, class F>
+void
+task_group::spawn(yield_token<Executor>& yield, F&& f)
+{
+    using fn_type = typename std::decay<F>::type;
+    fn_type fn(std::forward<F>(f));
+    if (!core_->try_reserve())
+    {
+        // The finishing child hands its slot over, there's no need to retry
+        detail::fiber_waiter<Executor> w;
+        detail::suspend_waiter(yield, w, [&] { core_->reserve(&w); });
+    }
+    core_->add_ref();
+    // From here on the task_main owns the slot and the reference, and hands
+    // them back even if the fiber never starts.
+    detail::task_main<fn_type> main{std::move(fn), core_};
+    ufiber::spawn(yield.get_executor(), std::move(main));
+}
+
+template<class Executor>
+void
+task_group::async_wait_all(yield_token<Executor>& yield)
+{
+    if (!core_->idle())
+    {
+        detail::fiber_waiter<Executor> w;
+        detail::suspend_waiter(yield, w, [&] { core_->wait(&w); });
+    }
+    auto const e = core_->take_error();
+    if (e)
+    {
+        std::rethrow_exception(e);
+    }
+}
+
+template<class Executor>
+void
+task_group::drain(task_group& self) noexcept
+{
+    auto& yield = *static_cast<yield_token<Executor>*>(self.yield_);
+    detail::fiber_waiter<Executor> w;
+    detail::suspend_waiter(yield, w, [&] { self.core_->wait(&w); });
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_TASK_GROUP_HPP
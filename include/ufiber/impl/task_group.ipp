@@ -0,0 +1,199 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_TASK_GROUP_IPP
+#define UFIBER_IMPL_TASK_GROUP_IPP
+
+#include <ufiber/task_group.hpp>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+void
+group_core::request_stop() noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (stopped_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    stopped_.store(true, std::memory_order_release);
+    while (callbacks_ != nullptr)
+    {
+        auto const cb = callbacks_;
+        callbacks_ = cb->next_;
+        cb->linked_ = false;
+        cb->invoke_(cb);
+    }
+}
+
+bool
+group_core::add_callback(stop_callback_base* cb) noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (stopped_.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    cb->prev_ = nullptr;
+    cb->next_ = callbacks_;
+    if (callbacks_ != nullptr)
+    {
+        callbacks_->prev_ = cb;
+    }
+    callbacks_ = cb;
+    cb->linked_ = true;
+    return true;
+}
+
+void
+group_core::remove_callback(stop_callback_base* cb) noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (!cb->linked_)
+    {
+        return;
+    }
+    if (cb->prev_ != nullptr)
+    {
+        cb->prev_->next_ = cb->next_;
+    }
+    else
+    {
+        callbacks_ = cb->next_;
+    }
+    if (cb->next_ != nullptr)
+    {
+        cb->next_->prev_ = cb->prev_;
+    }
+    cb->linked_ = false;
+}
+
+bool
+group_core::try_reserve() noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (limit_ != 0 && live_ >= limit_)
+    {
+        return false;
+    }
+    ++live_;
+    return true;
+}
+
+void
+group_core::reserve(waiter_base* w) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (live_ >= limit_)
+        {
+            spawners_.push(w);
+            return;
+        }
+        ++live_;
+    }
+    w->complete();
+}
+
+bool
+group_core::idle() noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return live_ == 0;
+}
+
+void
+group_core::wait(waiter_base* w) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (live_ != 0)
+        {
+            waiter_ = w;
+            return;
+        }
+    }
+    w->complete();
+}
+
+void
+group_core::finish(std::exception_ptr e) noexcept
+{
+    bool const failed = static_cast<bool>(e);
+    waiter_base* spawner;
+    waiter_base* waiter = nullptr;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (failed && !error_)
+        {
+            error_ = std::move(e);
+        }
+        // The slot goes straight to a suspended spawner, if there is one
+        spawner = spawners_.pop();
+        if (spawner == nullptr && --live_ == 0)
+        {
+            waiter = waiter_;
+            waiter_ = nullptr;
+        }
+    }
+    if (failed)
+    {
+        request_stop();
+    }
+    if (spawner != nullptr)
+    {
+        spawner->complete();
+    }
+    if (waiter != nullptr)
+    {
+        waiter->complete();
+    }
+    release();
+}
+
+std::exception_ptr
+group_core::take_error() noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto e = std::move(error_);
+    error_ = nullptr;
+    return e;
+}
+
+stop_token
+make_stop_token(group_core* core) noexcept
+{
+    return stop_token{core};
+}
+
+} // namespace detail
+
+task_group::~task_group()
+{
+    if (!core_->idle())
+    {
+        core_->request_stop();
+        drain_(*this);
+    }
+    core_->release();
+}
+
+void
+task_group::cancel() noexcept
+{
+    core_->request_stop();
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_TASK_GROUP_IPP
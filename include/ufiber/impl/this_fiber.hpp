@@ -0,0 +1,48 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_THIS_FIBER_HPP
+#define UFIBER_IMPL_THIS_FIBER_HPP
+
+#include <ufiber/this_fiber.hpp>
+
+namespace ufiber
+{
+namespace this_fiber
+{
+
+template<class Executor>
+void
+yield(yield_token<Executor>& yield)
+{
+    detail::yield_fiber(yield);
+}
+
+template<class Executor>
+void
+set_budget(yield_token<Executor>& yield, yield_budget const& budget) noexcept
+{
+    detail::get_fiber(yield).budget().set(budget.operations, budget.time);
+}
+
+template<class Executor>
+yield_budget
+get_budget(yield_token<Executor>& yield) noexcept
+{
+    auto const& b = detail::get_fiber(yield).budget();
+    yield_budget budget;
+    budget.operations = b.operations();
+    budget.time = b.time();
+    return budget;
+}
+
+} // namespace this_fiber
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_THIS_FIBER_HPP
@@ -0,0 +1,254 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_TRACE_IPP
+#define UFIBER_IMPL_TRACE_IPP
+
+#include <ufiber/trace.hpp>
+
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <new>
+#include <ostream>
+
+namespace ufiber
+{
+
+#ifdef UFIBER_ENABLE_TRACING
+
+namespace detail
+{
+
+void
+trace_buffer::snapshot(std::vector<trace_record>& out) const
+{
+    std::uint64_t const size = capacity;
+    auto const end = committed_.load(std::memory_order_acquire);
+    auto const begin = end > size ? end - size : 0;
+    auto const first = out.size();
+    for (auto i = begin; i < end; ++i)
+    {
+        auto const& e = entries_[i & (size - 1)];
+        auto const tag = e.tag_.load(std::memory_order_relaxed);
+        out.push_back(trace_record{e.time_.load(std::memory_order_relaxed),
+                                   tag >> 8,
+                                   static_cast<trace_kind>(tag & 0xff),
+                                   thread_});
+    }
+    // Entries below `reserved - capacity` may have been overwritten by the
+    // writer while they were being copied.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto const reserved = reserved_.load(std::memory_order_relaxed);
+    auto const valid = reserved > size ? reserved - size : 0;
+    if (valid > begin)
+    {
+        auto const torn = std::min<std::uint64_t>(valid - begin, end - begin);
+        out.erase(out.begin() + static_cast<std::ptrdiff_t>(first),
+                  out.begin() + static_cast<std::ptrdiff_t>(first + torn));
+    }
+}
+
+trace_registry&
+trace_registry::instance() noexcept
+{
+    static trace_registry registry;
+    return registry;
+}
+
+trace_buffer*
+trace_registry::acquire() noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (!free_.empty())
+    {
+        auto const buffer = free_.back();
+        free_.pop_back();
+        return buffer;
+    }
+    std::unique_ptr<trace_buffer> buffer{
+      new (std::nothrow) trace_buffer{buffers_.size()}};
+    if (!buffer)
+    {
+        return nullptr;
+    }
+    BOOST_TRY
+    {
+        buffers_.push_back(std::move(buffer));
+    }
+    BOOST_CATCH(...)
+    {
+        return nullptr;
+    }
+    BOOST_CATCH_END
+    return buffers_.back().get();
+}
+
+void
+trace_registry::release(trace_buffer* buffer) noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    BOOST_TRY
+    {
+        free_.push_back(buffer);
+    }
+    BOOST_CATCH(...)
+    {
+        // The buffer is kept for its events, but not reused
+    }
+    BOOST_CATCH_END
+}
+
+std::vector<trace_record>
+trace_registry::snapshot()
+{
+    std::vector<trace_buffer const*> buffers;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        for (auto const& b : buffers_)
+        {
+            buffers.push_back(b.get());
+        }
+    }
+    std::vector<trace_record> records;
+    for (auto b : buffers)
+    {
+        b->snapshot(records);
+    }
+    std::stable_sort(records.begin(),
+                     records.end(),
+                     [](trace_record const& lhs, trace_record const& rhs) {
+                         return lhs.time < rhs.time;
+                     });
+    return records;
+}
+
+inline void
+write_trace_slice(std::ostream& os,
+                  bool& first,
+                  char const* name,
+                  std::uint64_t fiber,
+                  std::size_t thread,
+                  std::uint64_t origin,
+                  std::uint64_t begin,
+                  std::uint64_t end)
+{
+    // Chrome trace timestamps are in microseconds
+    char buffer[256];
+    std::snprintf(buffer,
+                  sizeof(buffer),
+                  "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,"
+                  "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"thread\":%llu}}",
+                  first ? "\n" : ",\n",
+                  name,
+                  static_cast<unsigned long long>(fiber),
+                  static_cast<double>(begin - origin) / 1000.0,
+                  static_cast<double>(end - begin) / 1000.0,
+                  static_cast<unsigned long long>(thread));
+    os << buffer;
+    first = false;
+}
+
+} // namespace detail
+
+void
+start_tracing() noexcept
+{
+    detail::trace_active().store(true, std::memory_order_relaxed);
+}
+
+void
+stop_tracing() noexcept
+{
+    detail::trace_active().store(false, std::memory_order_relaxed);
+}
+
+void
+write_chrome_trace(std::ostream& os)
+{
+    struct track
+    {
+        detail::trace_kind last;
+        std::uint64_t since;
+    };
+
+    auto const records = detail::trace_registry::instance().snapshot();
+    auto const origin = records.empty() ? 0 : records.front().time;
+    std::map<std::uint64_t, track> tracks;
+    bool first = true;
+
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (auto const& r : records)
+    {
+        auto it = tracks.find(r.fiber);
+        if (it == tracks.end())
+        {
+            os << (first ? "\n" : ",\n")
+               << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+               << r.fiber << ",\"args\":{\"name\":\"fiber " << r.fiber
+               << "\"}}";
+            first = false;
+            tracks.emplace(r.fiber, track{r.kind, r.time});
+            continue;
+        }
+
+        auto& t = it->second;
+        bool const was_running = t.last == detail::trace_kind::start ||
+                                 t.last == detail::trace_kind::resume;
+        bool const is_running = r.kind == detail::trace_kind::start ||
+                                r.kind == detail::trace_kind::resume;
+        // A pair of events that doesn't delimit a slice means that events in
+        // between have been overwritten.
+        if (was_running && !is_running)
+        {
+            detail::write_trace_slice(
+              os, first, "run", r.fiber, r.thread, origin, t.since, r.time);
+        }
+        else if (t.last == detail::trace_kind::suspend &&
+                 r.kind == detail::trace_kind::resume)
+        {
+            detail::write_trace_slice(os,
+                                      first,
+                                      "suspended",
+                                      r.fiber,
+                                      r.thread,
+                                      origin,
+                                      t.since,
+                                      r.time);
+        }
+        t = track{r.kind, r.time};
+    }
+    os << "\n]}\n";
+}
+
+#else // UFIBER_ENABLE_TRACING
+
+void
+start_tracing() noexcept
+{
+}
+
+void
+stop_tracing() noexcept
+{
+}
+
+void
+write_chrome_trace(std::ostream& os)
+{
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}\n";
+}
+
+#endif // UFIBER_ENABLE_TRACING
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_TRACE_IPP
@@ -29,14 +29,20 @@ yield_token<Executor>::get_executor() noexcept
     return executor_;
 }
 
+template<class Executor>
+fiber_arena&
+yield_token<Executor>::arena() noexcept
+{
+    return ctx_.arena();
+}
+
 template<class E, class F>
 auto
 spawn(E const& ex, F&& f) ->
   typename std::enable_if<boost::asio::is_executor<E>::value>::type
 {
-    detail::initial_resume(
-      boost::context::fiber{detail::fiber_main<typename std::decay<F>::type, E>{
-        std::forward<F>(f), ex}});
+    detail::spawn_fiber(
+      boost::context::fixedsize_stack{}, ex, std::forward<F>(f));
 }
 
 template<class Ctx, class F>
@@ -44,21 +50,48 @@ auto
 spawn(Ctx& ctx, F&& f) -> typename std::enable_if<
   std::is_convertible<Ctx&, boost::asio::execution_context&>::value>::type
 {
-    detail::initial_resume(
-      boost::context::fiber{detail::fiber_main<typename std::decay<F>::type,
-                                               typename Ctx::executor_type>{
-        std::forward<F>(f), ctx.get_executor()}});
+    detail::spawn_fiber(boost::context::fixedsize_stack{},
+                        ctx.get_executor(),
+                        std::forward<F>(f));
 }
 
 template<class Alloc, class Executor, class F>
 void
-spawn(std::allocator_arg_t arg, Alloc&& sa, Executor const& ex, F&& f)
+spawn(std::allocator_arg_t, Alloc&& sa, Executor const& ex, F&& f)
+{
+    detail::spawn_fiber(std::forward<Alloc>(sa), ex, std::forward<F>(f));
+}
+
+template<class E, class F>
+auto
+spawn_dispatch(E const& ex, F&& f) ->
+  typename std::enable_if<boost::asio::is_executor<E>::value>::type
+{
+    detail::spawn_fiber(boost::context::fixedsize_stack{},
+                        ex,
+                        std::forward<F>(f),
+                        detail::start_mode::dispatch);
+}
+
+template<class Ctx, class F>
+auto
+spawn_dispatch(Ctx& ctx, F&& f) -> typename std::enable_if<
+  std::is_convertible<Ctx&, boost::asio::execution_context&>::value>::type
+{
+    detail::spawn_fiber(boost::context::fixedsize_stack{},
+                        ctx.get_executor(),
+                        std::forward<F>(f),
+                        detail::start_mode::dispatch);
+}
+
+template<class Alloc, class E, class F>
+void
+spawn_dispatch(std::allocator_arg_t, Alloc&& sa, E const& ex, F&& f)
 {
-    detail::initial_resume(boost::context::fiber{
-      arg,
-      std::forward<Alloc>(sa),
-      detail::fiber_main<typename std::decay<F>::type, Executor>{
-        std::forward<F>(f), ex}});
+    detail::spawn_fiber(std::forward<Alloc>(sa),
+                        ex,
+                        std::forward<F>(f),
+                        detail::start_mode::dispatch);
 }
 } // namespace ufiber
 
@@ -37,17 +37,52 @@ throw_broken_promise()
 }
 #endif // BOOST_NO_EXCEPTIONS
 
-fiber_context::fiber_context(boost::context::fiber&& f)
+fiber_context::fiber_context(boost::context::fiber&& f,
+                             boost::context::stack_context const& sctx,
+                             reclaim_list* reclaimer) noexcept
   : fiber_{std::move(f)}
+  , park_{reclaimer, sctx}
 {
+    UFIBER_TRACE(detail::trace_event(id_, trace_kind::start));
+    UFIBER_WATCHDOG(detail::watchdog_identify(id_));
 }
 
 void
 fiber_context::resumer::operator()(void*) noexcept
 {
+    // While the operation is still being initiated the fiber hasn't switched
+    // out, so it only has to be told that the operation has completed.
+    auto state = ctx_.handoff_.load(std::memory_order_acquire);
+    while (state == handoff::initiating || state == handoff::suspending)
+    {
+        if (ctx_.handoff_.compare_exchange_weak(state,
+                                                handoff::completed,
+                                                std::memory_order_acq_rel,
+                                                std::memory_order_acquire))
+        {
+            return;
+        }
+    }
+    ctx_.resume_suspended();
+}
+
+void
+fiber_context::resume_suspended() noexcept
+{
+    if (park_.enrolled())
+    {
+        park_.unpark();
+    }
+    UFIBER_STATS(detail::stats_on_resume());
+    UFIBER_TRACE(detail::trace_event(id_, trace_kind::resume));
+    UFIBER_REGISTRY(record_.on_resume());
+    UFIBER_WATCHDOG(auto const stamp = detail::watchdog_enter(id_));
     // Move onto stack, because resume() may invalidate ctx if fiber terminates
-    auto fiber = std::move(ctx_.fiber_);
+    auto fiber = std::move(fiber_);
+    auto const prev = detail::current_fiber();
     fiber = std::move(fiber).resume();
+    detail::current_fiber() = prev;
+    UFIBER_WATCHDOG(detail::watchdog_leave(stamp));
     // At this point the fiber has either suspended in a different async op
     // or it terminated, so it's impossible for us to get a fiber back here
     assert(!fiber && "Unexpected fiber");
@@ -56,16 +91,85 @@ fiber_context::resumer::operator()(void*) noexcept
 boost::context::fiber
 fiber_context::final_suspend() noexcept
 {
+    UFIBER_TRACE(detail::trace_event(id_, trace_kind::finish));
     return std::move(fiber_);
 }
 
 void
 initial_resume(boost::context::fiber&& f)
 {
+    // The fiber's ID is filled in once its fiber_context has been created
+    UFIBER_WATCHDOG(auto const stamp = detail::watchdog_enter(0));
+    auto const prev = detail::current_fiber();
     f = std::move(f).resume();
+    detail::current_fiber() = prev;
+    UFIBER_WATCHDOG(detail::watchdog_leave(stamp));
     assert(!f && "Unexpected fiber");
 }
 
+void
+fiber_locals::clear() noexcept
+{
+    // Matches PTHREAD_DESTRUCTOR_ITERATIONS
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        bool destroyed = false;
+        // The slots are looked up again for every value, because a destructor
+        // may grow the slot array
+        for (auto i = UFIBER_FIBER_LOCAL_SLOTS + overflow_.size(); i-- > 0;)
+        {
+            auto const s = find(i);
+            if (s->value_ == nullptr)
+            {
+                continue;
+            }
+            auto const value = s->value_;
+            auto const destroy = s->destroy_;
+            s->value_ = nullptr;
+            s->destroy_ = nullptr;
+            destroy(value);
+            destroyed = true;
+        }
+        if (!destroyed)
+        {
+            break;
+        }
+    }
+    std::vector<local_slot>{}.swap(overflow_);
+}
+
+local_key
+local_registry::acquire() noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    local_key key{next_index_, next_id_++};
+    if (free_.empty())
+    {
+        ++next_index_;
+    }
+    else
+    {
+        key.index_ = free_.back();
+        free_.pop_back();
+    }
+    return key;
+}
+
+void
+local_registry::release(std::size_t index) noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    BOOST_TRY
+    {
+        free_.push_back(index);
+    }
+    BOOST_CATCH(...)
+    {
+        // The index is never reused
+    }
+    BOOST_CATCH_END
+}
+
 void
 promise<>::set_result() noexcept
 {
@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_WATCHDOG_IPP
+#define UFIBER_IMPL_WATCHDOG_IPP
+
+#include <ufiber/detail/registry.hpp>
+#include <ufiber/watchdog.hpp>
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace ufiber
+{
+
+#ifdef UFIBER_ENABLE_WATCHDOG
+
+namespace detail
+{
+
+watchdog_slot::watchdog_slot()
+{
+    auto& r = watchdog_registry::instance();
+    std::lock_guard<std::mutex> lock{r.mutex_};
+    index_ = r.next_index_++;
+    next_ = r.head_;
+    if (next_ != nullptr)
+    {
+        next_->prev_ = this;
+    }
+    r.head_ = this;
+}
+
+watchdog_slot::~watchdog_slot()
+{
+    auto& r = watchdog_registry::instance();
+    std::lock_guard<std::mutex> lock{r.mutex_};
+    if (prev_ != nullptr)
+    {
+        prev_->next_ = next_;
+    }
+    else
+    {
+        r.head_ = next_;
+    }
+    if (next_ != nullptr)
+    {
+        next_->prev_ = prev_;
+    }
+}
+
+watchdog_registry&
+watchdog_registry::instance() noexcept
+{
+    static watchdog_registry registry;
+    return registry;
+}
+
+} // namespace detail
+
+#endif // UFIBER_ENABLE_WATCHDOG
+
+watchdog::watchdog(std::chrono::steady_clock::duration budget,
+                   handler_type handler)
+  : budget_{budget}
+  , handler_{std::move(handler)}
+{
+    if (!handler_)
+    {
+        handler_ = [](watchdog_report const& r) {
+            std::cerr << "ufiber watchdog: fiber " << r.fiber;
+            if (!r.name.empty())
+            {
+                std::cerr << " \"" << r.name << '"';
+            }
+            std::cerr << " has been running for "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(
+                           r.elapsed)
+                           .count()
+                      << " ms on thread " << r.thread << '\n';
+        };
+    }
+    thread_ = std::thread{[this] { run(); }};
+}
+
+watchdog::~watchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stopped_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void
+watchdog::run()
+{
+#ifdef UFIBER_ENABLE_WATCHDOG
+    struct observed
+    {
+        std::uint64_t run;
+        bool reported;
+    };
+
+    auto interval = budget_ / 4;
+    if (interval <= std::chrono::steady_clock::duration::zero())
+    {
+        interval = std::chrono::milliseconds{1};
+    }
+    std::map<std::size_t, observed> threads;
+    std::vector<watchdog_report> reports;
+    std::unique_lock<std::mutex> lock{mutex_};
+    while (!cv_.wait_for(lock, interval, [this] { return stopped_; }))
+    {
+        auto const now = std::chrono::steady_clock::now();
+        reports.clear();
+        detail::watchdog_registry::instance().for_each(
+          [&](std::size_t index, detail::watchdog_stamp const& s) {
+              auto& o = threads[index];
+              if (s.run != o.run)
+              {
+                  o = observed{s.run, false};
+              }
+              if (s.run == 0 || o.reported)
+              {
+                  return;
+              }
+              auto const elapsed =
+                now - std::chrono::steady_clock::time_point{
+                        std::chrono::steady_clock::duration{s.since}};
+              if (elapsed > budget_)
+              {
+                  o.reported = true;
+                  reports.push_back(
+                    watchdog_report{s.fiber, std::string{}, elapsed, index});
+              }
+          });
+
+#ifdef UFIBER_ENABLE_REGISTRY
+        if (!reports.empty())
+        {
+            detail::fiber_registry::instance().for_each(
+              [&reports](std::uint64_t id,
+                         char const* name,
+                         detail::fiber_record::state_type,
+                         std::int64_t,
+                         std::type_info const*,
+                         std::type_info const*,
+                         std::type_info const*) {
+                  for (auto& r : reports)
+                  {
+                      if (r.fiber == id && name != nullptr)
+                      {
+                          r.name = name;
+                      }
+                  }
+              });
+        }
+#endif // UFIBER_ENABLE_REGISTRY
+
+        lock.unlock();
+        for (auto const& r : reports)
+        {
+            handler_(r);
+        }
+        lock.lock();
+    }
+#else
+    std::unique_lock<std::mutex> lock{mutex_};
+    cv_.wait(lock, [this] { return stopped_; });
+#endif // UFIBER_ENABLE_WATCHDOG
+}
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_WATCHDOG_IPP
@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_WHEN_HPP
+#define UFIBER_IMPL_WHEN_HPP
+
+#include <ufiber/when.hpp>
+
+#include <boost/mp11/integer_sequence.hpp>
+
+#include <exception>
+#include <memory>
+#include <typeinfo>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+template<class... Args>
+leg_handler<Args...>::leg_handler(leg_token const& token) noexcept
+  : state_{token.state_}
+  , index_{token.index_}
+{
+    state_->bind();
+}
+
+template<class Executor, class... Ops>
+struct when_launcher
+{
+    using results_type = std::tuple<leg_result_t<Ops>...>;
+
+    template<std::size_t... I>
+    static std::pair<std::size_t, results_type> run(
+      yield_token<Executor>& yield,
+      bool any,
+      boost::mp11::index_sequence<I...>,
+      Ops&... ops)
+    {
+        std::tuple<boost::optional<leg_result_t<Ops>>...> results;
+        void* const slots[] = {std::addressof(std::get<I>(results))...};
+        leg_cancel const cancels[] = {detail::make_leg_cancel(ops, 0)...};
+        promise<> p;
+        auto& ctx = detail::get_fiber(yield);
+        when_state<Executor> state{
+          sizeof...(Ops), slots, cancels, any, &p, yield, ctx};
+        UFIBER_REGISTRY(
+          ctx.record().wait_for(typeid(when_launcher), typeid(void())));
+        std::exception_ptr error;
+        ctx.initiate([&] {
+            BOOST_TRY
+            {
+                // The operations are started in order
+                int const started[] = {(ops(leg_token{&state, I}), 0)...};
+                static_cast<void>(started);
+                state.started();
+            }
+            BOOST_CATCH(...)
+            {
+                // The fiber still waits for the legs that were started, as
+                // their handlers refer to this frame
+                error = std::current_exception();
+                state.abort();
+            }
+            BOOST_CATCH_END
+        });
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        p.get_value();
+        return std::pair<std::size_t, results_type>{
+          state.winner(), results_type{std::move(*std::get<I>(results))...}};
+    }
+};
+
+} // namespace detail
+
+template<class Op, class Cancel>
+detail::cancellable_op<typename std::decay<Op>::type,
+                       typename std::decay<Cancel>::type>
+cancellable(Op&& op, Cancel&& cancel)
+{
+    return {std::forward<Op>(op), std::forward<Cancel>(cancel)};
+}
+
+template<class Executor, class... Ops>
+std::tuple<detail::leg_result_t<Ops>...>
+when_all(yield_token<Executor>& yield, Ops&&... ops)
+{
+    static_assert(sizeof...(Ops) > 0, "Expected at least one operation");
+    return detail::when_launcher<Executor, Ops...>::run(
+             yield, false, boost::mp11::index_sequence_for<Ops...>{}, ops...)
+      .second;
+}
+
+template<class Executor, class... Ops>
+std::pair<std::size_t, std::tuple<detail::leg_result_t<Ops>...>>
+when_any(yield_token<Executor>& yield, Ops&&... ops)
+{
+    static_assert(sizeof...(Ops) > 0, "Expected at least one operation");
+    return detail::when_launcher<Executor, Ops...>::run(
+      yield, true, boost::mp11::index_sequence_for<Ops...>{}, ops...);
+}
+
+} // namespace ufiber
+
+namespace boost
+{
+
+namespace asio
+{
+
+template<class... Args>
+class async_result<::ufiber::leg_token, void(Args...)>
+{
+public:
+    using completion_handler_type = ::ufiber::detail::leg_handler<Args...>;
+
+    using return_type = ::ufiber::detail::leg_signature<Args...>;
+
+    template<class Op, class Token, class... Ts>
+    static return_type initiate(Op&& op, Token&& token, Ts&&... ts)
+    {
+        op(completion_handler_type{token}, std::forward<Ts>(ts)...);
+        return return_type{};
+    }
+
+    return_type get() = delete;
+};
+
+} // asio
+
+} // boost
+
+#endif // UFIBER_IMPL_WHEN_HPP
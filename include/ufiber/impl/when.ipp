@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_IMPL_WHEN_IPP
+#define UFIBER_IMPL_WHEN_IPP
+
+#include <ufiber/when.hpp>
+
+namespace ufiber
+{
+
+namespace detail
+{
+
+void
+when_state_base::started() noexcept
+{
+    // Pairs with complete(): either the winner sees started_, or we see the
+    // winner, so the losers are cancelled even if the winner completed while
+    // later legs were still being started.
+    started_.store(true);
+    if (any_ && winner_.load() != npos)
+    {
+        cancel_losers();
+    }
+    release();
+}
+
+void
+when_state_base::abort() noexcept
+{
+    // The legs are started in order, so exactly the first bound_ legs will
+    // complete. The extra count keeps the sum from reaching zero here.
+    remaining_.fetch_sub(legs_ - bound_, std::memory_order_acq_rel);
+    if (!cancelled_.exchange(true))
+    {
+        for (std::size_t i = 0; i < bound_; ++i)
+        {
+            if (cancels_[i].cancel_ != nullptr)
+            {
+                cancels_[i].cancel_(cancels_[i].op_);
+            }
+        }
+    }
+    release();
+}
+
+void
+when_state_base::complete(std::size_t index, bool abandoned) noexcept
+{
+    if (abandoned)
+    {
+        abandoned_.store(true, std::memory_order_relaxed);
+    }
+    else if (any_)
+    {
+        auto expected = npos;
+        if (winner_.compare_exchange_strong(expected, index) &&
+            started_.load())
+        {
+            cancel_losers();
+        }
+    }
+    release();
+}
+
+void
+when_state_base::cancel_losers() noexcept
+{
+    if (cancelled_.exchange(true))
+    {
+        return;
+    }
+    auto const winner = winner_.load();
+    for (std::size_t i = 0; i < legs_; ++i)
+    {
+        if (i != winner && cancels_[i].cancel_ != nullptr)
+        {
+            cancels_[i].cancel_(cancels_[i].op_);
+        }
+    }
+}
+
+void
+when_state_base::release() noexcept
+{
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        finish_(this);
+    }
+}
+
+} // namespace detail
+
+} // namespace ufiber
+
+#endif // UFIBER_IMPL_WHEN_IPP
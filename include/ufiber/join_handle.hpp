@@ -0,0 +1,170 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_JOIN_HANDLE_HPP
+#define UFIBER_JOIN_HANDLE_HPP
+
+#include <ufiber/detail/join_handle.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <memory>
+#include <type_traits>
+
+/**
+ * @file
+ * Spawning fibers whose result can be waited for.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Refers to a fiber spawned by `spawn_joinable()`, whose result can be
+ * retrieved by another fiber with `async_join()`.
+ *
+ * The result is stored at the top of the spawned fiber's stack, which is kept
+ * allocated until both the fiber has finished and the handle has been joined
+ * or destroyed. Destroying a handle without joining detaches the fiber.
+ *
+ * @tparam T the return type of the fiber's main function.
+ */
+template<class T>
+class join_handle
+{
+public:
+    /**
+     * Constructs a handle that doesn't refer to a fiber.
+     */
+    join_handle() noexcept = default;
+
+    join_handle(join_handle&& other) noexcept
+      : state_{other.state_}
+    {
+        other.state_ = nullptr;
+    }
+
+    join_handle& operator=(join_handle&& other) noexcept
+    {
+        join_handle tmp{std::move(other)};
+        std::swap(state_, tmp.state_);
+        return *this;
+    }
+
+    ~join_handle()
+    {
+        if (state_ != nullptr)
+        {
+            state_->release();
+        }
+    }
+
+    /**
+     * Returns whether the handle refers to a fiber that hasn't been joined.
+     */
+    bool joinable() const noexcept
+    {
+        return state_ != nullptr;
+    }
+
+    /**
+     * Returns whether the fiber has finished, in which case `async_join()`
+     * doesn't suspend.
+     *
+     * @pre `joinable()`.
+     */
+    bool done() const noexcept
+    {
+        return state_->done();
+    }
+
+    /**
+     * Suspends the calling fiber until the fiber referred to by this handle
+     * has finished. Returns the value returned by its main function, or
+     * rethrows the exception that escaped from it. The handle no longer
+     * refers to the fiber afterwards.
+     *
+     * @pre `joinable()`.
+     *
+     * @throws broken_promise if the spawned fiber was abandoned by its
+     * executor.
+     *
+     * @note The calling fiber counts as outstanding work of its executor
+     * while it waits, and is not abandoned if that executor shuts down.
+     */
+    template<class Executor>
+    T async_join(yield_token<Executor>& yield);
+
+private:
+    template<class U, class Alloc, class E, class F>
+    friend join_handle<U>
+    detail::make_join_handle(Alloc&& sa, E const& ex, F&& f);
+
+    explicit join_handle(detail::join_state<T>* state) noexcept
+      : state_{state}
+    {
+    }
+
+    detail::join_state<T>* state_ = nullptr;
+};
+
+/**
+ * Spawns a new fiber on the provided executor, like `spawn()`, and returns a
+ * handle through which its result can be retrieved. This function
+ * participates in overload resolution only if E is an Executor.
+ *
+ * @param ex the executor that will be associated with the fiber.
+ * @param f the function object that will be invoked as the fiber's main
+ * function.
+ */
+template<class E, class F>
+auto
+spawn_joinable(E const& ex, F&& f) -> typename std::enable_if<
+  boost::asio::is_executor<E>::value,
+  join_handle<detail::spawn_result_t<F, E>>>::type;
+
+/**
+ * Spawns a new fiber on the provided ExecutionContext, like `spawn()`, and
+ * returns a handle through which its result can be retrieved.
+ *
+ * @param ctx the ExecutionContext that will be associated with the fiber.
+ * @param f the function object that will be invoked as the fiber's main
+ * function.
+ */
+template<class Ctx, class F>
+auto
+spawn_joinable(Ctx& ctx, F&& f) -> typename std::enable_if<
+  std::is_convertible<Ctx&, boost::asio::execution_context&>::value,
+  join_handle<
+    detail::spawn_result_t<F, typename Ctx::executor_type>>>::type;
+
+/**
+ * Spawns a new fiber on the provided executor, using the provided
+ * StackAllocator, and returns a handle through which its result can be
+ * retrieved.
+ *
+ * @param arg std::allocator_arg tag to disambiguate overloads.
+ * @param sa an object that satisfies the requirements of the StackAllocator
+ * concept.
+ * @param ex the executor that will be associated with the fiber.
+ * @param f the function object that will be invoked as the fiber's main
+ * function.
+ */
+template<class Alloc, class E, class F>
+join_handle<detail::spawn_result_t<F, E>>
+spawn_joinable(std::allocator_arg_t arg, Alloc&& sa, E const& ex, F&& f);
+
+} // namespace ufiber
+
+#include <ufiber/impl/join_handle.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/join_handle.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_JOIN_HANDLE_HPP
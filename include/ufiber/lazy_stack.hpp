@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_LAZY_STACK_HPP
+#define UFIBER_LAZY_STACK_HPP
+
+#include <ufiber/detail/config.hpp>
+#include <ufiber/detail/park_record.hpp>
+
+#include <boost/config.hpp>
+#include <boost/context/stack_context.hpp>
+
+#if defined(BOOST_WINDOWS)
+#error "ufiber::lazy_stack requires a POSIX system"
+#endif
+
+#include <chrono>
+#include <cstddef>
+
+/**
+ * @file
+ * Lazily committed fiber stacks and trimming of idle fibers' stacks.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Returns memory held by the stacks of fibers that have stayed suspended for
+ * longer than a threshold to the operating system. Only fibers whose stacks
+ * were allocated by a lazy_stack constructed with a pointer to this object are
+ * considered.
+ *
+ * The pages between the bottom of the stack and the stack pointer at the
+ * suspension point are released with `madvise`. The kernel will supply zeroed
+ * pages if the fiber grows its stack into that region again, so the resident
+ * size of a fiber follows its live working set rather than its peak stack
+ * depth.
+ *
+ * @remark The object must outlive all fibers that refer to it.
+ */
+class stack_reclaimer
+{
+public:
+    /**
+     * The advice passed to `madvise` for released pages.
+     */
+    enum class advice
+    {
+        /**
+         * `MADV_DONTNEED`: pages are released immediately.
+         */
+        dont_need,
+
+        /**
+         * `MADV_FREE`: pages are released lazily, when the system is under
+         * memory pressure. Falls back to `MADV_DONTNEED` if unavailable.
+         */
+        free,
+    };
+
+    /**
+     * Constructs a reclaimer.
+     *
+     * @param threshold minimum time a fiber has to stay suspended before its
+     * stack is trimmed.
+     * @param adv the advice used to release pages.
+     */
+    UFIBER_INLINE_DECL explicit stack_reclaimer(
+      std::chrono::steady_clock::duration threshold,
+      advice adv = advice::dont_need) noexcept;
+
+    stack_reclaimer(stack_reclaimer const&) = delete;
+    stack_reclaimer& operator=(stack_reclaimer const&) = delete;
+
+    /**
+     * Trims the stacks of all enrolled fibers that have been suspended for
+     * longer than the threshold and have not been trimmed since they were
+     * suspended. This function may be called from any thread, e.g. from a
+     * timer or a dedicated housekeeping thread.
+     *
+     * @remark A fiber whose operation completes while its stack is being
+     * trimmed is resumed after trimming is done.
+     *
+     * @returns the number of bytes passed to `madvise`.
+     */
+    UFIBER_INLINE_DECL std::size_t reclaim() noexcept;
+
+private:
+    friend class lazy_stack;
+
+    detail::reclaim_list list_;
+    std::chrono::steady_clock::duration const threshold_;
+    advice const advice_;
+};
+
+/**
+ * A StackAllocator which reserves address space for a stack without
+ * committing memory for it. The stack is mapped with `MAP_NORESERVE` and
+ * protected by a guard page, pages are backed by memory only when the fiber
+ * touches them.
+ *
+ * Refer to the StackAllocator concept in boost::context for more information.
+ */
+class lazy_stack
+{
+public:
+    /**
+     * Constructs an allocator.
+     *
+     * @param size the size of the reserved address range, excluding the guard
+     * page.
+     * @param reclaimer if not null, fibers running on stacks allocated by this
+     * object will be trimmed by `reclaimer` while they are suspended.
+     */
+    UFIBER_INLINE_DECL explicit lazy_stack(
+      std::size_t size = 1024 * 1024,
+      stack_reclaimer* reclaimer = nullptr) noexcept;
+
+    /**
+     * Reserves a stack.
+     */
+    UFIBER_INLINE_DECL boost::context::stack_context allocate();
+
+    /**
+     * Unmaps a stack.
+     */
+    UFIBER_INLINE_DECL void deallocate(
+      boost::context::stack_context& sctx) noexcept;
+
+    /**
+     * Returns the list the fibers are enrolled in, if any.
+     */
+    UFIBER_INLINE_DECL detail::reclaim_list* reclaimer() const noexcept;
+
+private:
+    std::size_t size_;
+    stack_reclaimer* reclaimer_;
+};
+
+} // namespace ufiber
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/lazy_stack.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_LAZY_STACK_HPP
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_REGISTRY_HPP
+#define UFIBER_REGISTRY_HPP
+
+#include <ufiber/detail/registry.hpp>
+#include <ufiber/detail/ufiber.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * @file
+ * Registry of live fibers, for diagnosing fibers that never finish.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Returns whether the library has been compiled with the fiber registry
+ * (`UFIBER_ENABLE_REGISTRY`). Without it, no fibers are ever listed.
+ */
+constexpr bool
+registry_enabled() noexcept
+{
+#ifdef UFIBER_ENABLE_REGISTRY
+    return true;
+#else
+    return false;
+#endif // UFIBER_ENABLE_REGISTRY
+}
+
+/**
+ * Scheduling state of a fiber.
+ */
+enum class fiber_state
+{
+    /// The fiber is running on some thread.
+    running,
+    /// The fiber is waiting for an asynchronous operation to complete.
+    suspended
+};
+
+/**
+ * A snapshot of a live fiber's state.
+ */
+struct fiber_info
+{
+    /// Sequential ID of the fiber, starting from 1.
+    std::uint64_t id;
+
+    /// Name given with `set_fiber_name()`, or an empty string.
+    std::string name;
+
+    /// Whether the fiber is running or suspended.
+    fiber_state state;
+
+    /// Time elapsed since the fiber was started or last resumed.
+    std::chrono::steady_clock::duration since_resume;
+
+    /// Type of the fiber's executor.
+    std::string executor;
+
+    /// Initiating function object of the operation the fiber last waited on.
+    std::string operation;
+
+    /// Completion signature of the operation the fiber last waited on.
+    std::string signature;
+};
+
+/**
+ * Names the calling fiber in registry dumps. The string is not copied, so it
+ * must outlive the fiber, e.g. a string literal.
+ */
+template<class Executor>
+void
+set_fiber_name(yield_token<Executor>& yield, char const* name) noexcept;
+
+/**
+ * Returns a snapshot of all live fibers. May be called from any thread, while
+ * fibers are running. Fibers being started or finishing on other threads wait
+ * until the snapshot has been taken.
+ */
+UFIBER_INLINE_DECL std::vector<fiber_info>
+live_fibers();
+
+/**
+ * Writes a human readable listing of all live fibers, one per line.
+ *
+ * @remark This function allocates and locks a mutex, so it must not be called
+ * from a signal handler directly. Use `boost::asio::signal_set` on an
+ * `io_context` that is run by a thread that doesn't run fibers.
+ */
+UFIBER_INLINE_DECL void
+dump_fibers(std::ostream& os);
+
+} // namespace ufiber
+
+#include <ufiber/impl/registry.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/registry.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_REGISTRY_HPP
@@ -0,0 +1,195 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_RUNTIME_HPP
+#define UFIBER_RUNTIME_HPP
+
+#include <ufiber/detail/runtime.hpp>
+#include <ufiber/stack_pool.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/basic_socket_acceptor.hpp>
+#include <boost/asio/basic_stream_socket.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @file
+ * A thread-per-core runtime, with one `io_context` per thread.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Runs one single-threaded `io_context`, a shard, on each of several threads.
+ * Each thread is pinned to its own CPU. A fiber spawned on a shard stays on
+ * that shard's thread for its whole life. So thread local variables are safe
+ * to use, and fibers on different shards don't contend for queues or caches.
+ *
+ * Servers call `listen()` to accept connections on every shard. Work that
+ * has to cross shards uses `spawn_on()`, `post()` and `call_on()`.
+ */
+class runtime
+{
+public:
+    /**
+     * The executor of a shard.
+     */
+    using executor_type = boost::asio::io_context::executor_type;
+
+    /**
+     * A TCP socket bound to a shard.
+     */
+    using socket_type =
+      boost::asio::basic_stream_socket<boost::asio::ip::tcp, executor_type>;
+
+    /**
+     * A TCP acceptor bound to a shard.
+     */
+    using acceptor_type =
+      boost::asio::basic_socket_acceptor<boost::asio::ip::tcp, executor_type>;
+
+    /**
+     * Constructs a runtime.
+     *
+     * @param shards the number of shards. If 0, one shard is created for each
+     * CPU that the process may run on.
+     * @param pin whether `run()` pins the thread of each shard to a CPU.
+     */
+    UFIBER_INLINE_DECL explicit runtime(std::size_t shards = 0,
+                                        bool pin = true);
+
+    runtime(runtime const&) = delete;
+    runtime& operator=(runtime const&) = delete;
+
+    /**
+     * Returns the number of shards.
+     */
+    std::size_t size() const noexcept
+    {
+        return shards_.size();
+    }
+
+    /**
+     * Returns the `io_context` of shard `i`.
+     */
+    boost::asio::io_context& context(std::size_t i) noexcept
+    {
+        return shards_[i]->io_;
+    }
+
+    /**
+     * Returns the executor of shard `i`.
+     */
+    executor_type get_executor(std::size_t i) noexcept
+    {
+        return shards_[i]->io_.get_executor();
+    }
+
+    /**
+     * Returns the index of the shard running on the calling thread, or
+     * `size()` if the calling thread doesn't run a shard of this runtime.
+     */
+    UFIBER_INLINE_DECL std::size_t current_shard() const noexcept;
+
+    /**
+     * Runs every shard on a thread of its own, the first shard on the calling
+     * thread. Returns once `stop()` has been called and all threads have
+     * finished. If a shard throws an exception, the runtime is stopped and the
+     * exception is rethrown.
+     */
+    UFIBER_INLINE_DECL void run();
+
+    /**
+     * Stops all shards. May be called from any thread.
+     */
+    UFIBER_INLINE_DECL void stop() noexcept;
+
+    /**
+     * Spawns a fiber on shard `i`. The fiber's stack is allocated from the
+     * shard's stack pool, by the shard's own thread.
+     */
+    template<class F>
+    void spawn_on(std::size_t i, F&& f);
+
+    /**
+     * Runs `f()` on shard `i`.
+     */
+    template<class F>
+    void post(std::size_t i, F&& f);
+
+    /**
+     * Runs `f()` on shard `i` and suspends the calling fiber until it has
+     * returned. The calling fiber resumes on its own executor.
+     *
+     * @returns the result of `f()`.
+     *
+     * @remark `f` must not throw.
+     */
+    template<class F, class Executor>
+    detail::call_result_t<F> call_on(std::size_t i,
+                                     F&& f,
+                                     yield_token<Executor>& yield);
+
+    /**
+     * Accepts connections to `endpoint` on every shard. Each shard binds its
+     * own acceptor with SO_REUSEPORT, so the kernel balances connections
+     * between shards. Every accepted connection is handed to a new fiber on
+     * the shard that has accepted it, which invokes a copy of `session` as
+     * `session(std::move(socket), yield)`.
+     *
+     * Where SO_REUSEPORT is unavailable, only the first shard accepts.
+     *
+     * An acceptor skips connections that fail before they are accepted. When
+     * it runs out of descriptors or memory, it sleeps for
+     * `UFIBER_ACCEPT_BACKOFF_MS` milliseconds before it accepts again. Any
+     * other error stops the acceptor of that shard.
+     *
+     * @returns the local endpoint of the acceptors, which carries the port
+     * that has been picked if `endpoint` has port 0.
+     *
+     * @throws boost::system::system_error if an acceptor can't be opened or
+     * bound.
+     */
+    template<class Session>
+    boost::asio::ip::tcp::endpoint listen(
+      boost::asio::ip::tcp::endpoint const& endpoint,
+      Session session);
+
+private:
+    struct shard
+    {
+        // Declared first, so that fibers abandoned by the destruction of the
+        // io_context can still return their stacks.
+        stack_pool pool_;
+        boost::asio::io_context io_{1};
+    };
+
+    UFIBER_INLINE_DECL std::vector<acceptor_type> open_acceptors(
+      boost::asio::ip::tcp::endpoint const& endpoint);
+
+    std::vector<std::unique_ptr<shard>> shards_;
+    bool pin_;
+};
+
+} // namespace ufiber
+
+#include <ufiber/impl/runtime.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/runtime.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_RUNTIME_HPP
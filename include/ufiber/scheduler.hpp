@@ -0,0 +1,261 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_SCHEDULER_HPP
+#define UFIBER_SCHEDULER_HPP
+
+#include <ufiber/detail/config.hpp>
+#include <ufiber/detail/scheduler.hpp>
+
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @file
+ * A work-stealing execution context for running fibers on many threads.
+ */
+
+namespace ufiber
+{
+
+/**
+ * A multi-threaded execution context with a run queue per thread.
+ *
+ * A function posted from one of the scheduler's threads is queued on that
+ * thread. The most recently posted function is kept in a LIFO slot and runs
+ * next, so that a fiber woken by another fiber tends to resume on the same
+ * thread, while its data is still in cache. A thread that runs out of work
+ * steals half of the queue of another thread, picked at random. Functions
+ * posted from outside go to a shared queue, which all threads check
+ * periodically.
+ *
+ * I/O objects stay bound to an `io_context`, the reactor. Completions of
+ * operations started from a fiber are delivered through the fiber's executor,
+ * so they are scheduled like any other work. Idle threads take turns waiting
+ * for I/O in the reactor, while busy threads poll it at regular intervals.
+ *
+ * @remark Functions posted from the scheduler's threads don't necessarily run
+ * in the order they were posted.
+ *
+ * @remark The reactor must not be run by other threads during `run()`, since
+ * the scheduler wakes its thread waiting in the reactor by posting to it.
+ */
+class scheduler : public boost::asio::execution_context
+{
+public:
+    class executor_type;
+
+    /**
+     * Constructs a scheduler.
+     *
+     * @param reactor the `io_context` that reports I/O readiness.
+     * @param threads the number of threads that `run()` uses.
+     */
+    UFIBER_INLINE_DECL scheduler(boost::asio::io_context& reactor,
+                                 std::size_t threads);
+
+    /**
+     * Destroys all functions that haven't been run yet.
+     */
+    UFIBER_INLINE_DECL ~scheduler();
+
+    scheduler(scheduler const&) = delete;
+    scheduler& operator=(scheduler const&) = delete;
+
+    /**
+     * Returns an executor that schedules functions on this scheduler.
+     */
+    executor_type get_executor() noexcept;
+
+    /**
+     * Runs the scheduler on the calling thread and `threads - 1` additional
+     * threads, until there is no more work or the scheduler is stopped.
+     * Exceptions thrown by functions stop the scheduler and are rethrown,
+     * after all threads have finished.
+     *
+     * @returns the number of functions that have been run.
+     */
+    UFIBER_INLINE_DECL std::size_t run();
+
+    /**
+     * Makes `run()` return as soon as possible. Functions that haven't been
+     * run yet remain queued.
+     */
+    UFIBER_INLINE_DECL void stop() noexcept;
+
+    /**
+     * Returns whether the scheduler has been stopped.
+     */
+    bool stopped() const noexcept
+    {
+        return stopped_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Prepares a stopped scheduler for another call to `run()`.
+     */
+    void restart() noexcept
+    {
+        stopped_.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Returns the number of threads that `run()` uses.
+     */
+    std::size_t concurrency() const noexcept
+    {
+        return workers_.size();
+    }
+
+    /**
+     * Returns the reactor of this scheduler.
+     */
+    boost::asio::io_context& reactor() noexcept
+    {
+        return reactor_;
+    }
+
+private:
+    UFIBER_INLINE_DECL void work_started() noexcept;
+    UFIBER_INLINE_DECL void work_finished() noexcept;
+    UFIBER_INLINE_DECL void submit(detail::scheduler_op* op,
+                                   bool is_continuation) noexcept;
+    UFIBER_INLINE_DECL bool running_in_this_thread() const noexcept;
+
+    UFIBER_INLINE_DECL std::size_t run_worker(detail::scheduler_worker& w);
+    UFIBER_INLINE_DECL detail::scheduler_op* next_op(
+      detail::scheduler_worker& w) noexcept;
+    UFIBER_INLINE_DECL detail::scheduler_op* pop_injected() noexcept;
+    UFIBER_INLINE_DECL detail::scheduler_op* steal(
+      detail::scheduler_worker& w) noexcept;
+    UFIBER_INLINE_DECL void push_local(detail::scheduler_worker& w,
+                                       detail::scheduler_op* op) noexcept;
+    UFIBER_INLINE_DECL void inject(detail::scheduler_op* op) noexcept;
+    UFIBER_INLINE_DECL bool has_work() const noexcept;
+    UFIBER_INLINE_DECL void park();
+    UFIBER_INLINE_DECL void wake_one() noexcept;
+    UFIBER_INLINE_DECL void wake_reactor() noexcept;
+
+    boost::asio::io_context& reactor_;
+    std::vector<std::unique_ptr<detail::scheduler_worker>> workers_;
+    std::atomic<std::size_t> outstanding_{0};
+    std::atomic<bool> stopped_{false};
+
+    // Operations posted from outside the scheduler's threads
+    std::mutex inject_mutex_;
+    detail::op_list injected_;
+    std::atomic<std::size_t> injected_size_{0};
+
+    // Idle threads. One of them waits in the reactor, the others on `cv_`.
+    std::mutex idle_mutex_;
+    std::condition_variable cv_;
+    std::atomic<std::size_t> idle_{0};
+    std::size_t waiting_ = 0;
+    bool polling_ = false;
+    detail::wake_slot wake_;
+};
+
+/**
+ * The executor of a `scheduler`. Satisfies the Executor requirements.
+ */
+class scheduler::executor_type
+{
+public:
+    /**
+     * Returns the scheduler of this executor.
+     */
+    scheduler& context() const noexcept
+    {
+        return *sched_;
+    }
+
+    /**
+     * Informs the scheduler that it has outstanding work.
+     */
+    void on_work_started() const noexcept
+    {
+        sched_->work_started();
+    }
+
+    /**
+     * Informs the scheduler that some outstanding work has completed.
+     */
+    void on_work_finished() const noexcept
+    {
+        sched_->work_finished();
+    }
+
+    /**
+     * Invokes `f` in place if called from one of the scheduler's threads,
+     * otherwise posts it.
+     */
+    template<class F, class Alloc>
+    void dispatch(F&& f, Alloc const& a) const;
+
+    /**
+     * Schedules `f` to run on the scheduler. If called from one of the
+     * scheduler's threads, `f` is put in that thread's LIFO slot.
+     */
+    template<class F, class Alloc>
+    void post(F&& f, Alloc const& a) const;
+
+    /**
+     * Schedules `f` to run on the scheduler. If called from one of the
+     * scheduler's threads, `f` is put at the back of that thread's queue.
+     */
+    template<class F, class Alloc>
+    void defer(F&& f, Alloc const& a) const;
+
+    /**
+     * Returns whether the calling thread is running the scheduler.
+     */
+    bool running_in_this_thread() const noexcept
+    {
+        return sched_->running_in_this_thread();
+    }
+
+    friend bool operator==(executor_type const& a,
+                           executor_type const& b) noexcept
+    {
+        return a.sched_ == b.sched_;
+    }
+
+    friend bool operator!=(executor_type const& a,
+                           executor_type const& b) noexcept
+    {
+        return a.sched_ != b.sched_;
+    }
+
+private:
+    friend class scheduler;
+
+    explicit executor_type(scheduler& s) noexcept
+      : sched_{&s}
+    {
+    }
+
+    scheduler* sched_;
+};
+
+} // namespace ufiber
+
+#include <ufiber/impl/scheduler.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/scheduler.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_SCHEDULER_HPP
@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_SPAWN_QUEUE_HPP
+#define UFIBER_SPAWN_QUEUE_HPP
+
+#include <ufiber/detail/spawn_queue.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <cstddef>
+#include <memory>
+
+/**
+ * @file
+ * Spawning fibers whose stacks are allocated once the executor runs them, with
+ * a limit on the number of fibers that run at the same time.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Spawns fibers on an executor without allocating their stacks up front.
+ *
+ * `spawn()` only stores the function object and the StackAllocator, then
+ * posts the fiber to the executor. The stack is allocated when the executor
+ * runs the posted handler. At most `max_live` fibers spawned through a queue
+ * are admitted at the same time. A fiber stays admitted from the moment it is
+ * posted until its stack has been deallocated. Further fibers wait in FIFO
+ * order, without a stack, until an admitted fiber has finished. A burst of
+ * spawns, e.g. during a connection flood, therefore can't allocate more than
+ * `max_live` stacks.
+ *
+ * Queued fibers are still started after the spawn_queue has been destroyed.
+ * If the executor abandons an admitted fiber, e.g. because its execution
+ * context is shut down, the queued fibers are destroyed without being
+ * started.
+ *
+ * All member functions are thread-safe.
+ */
+template<class Executor>
+class spawn_queue
+{
+public:
+    using executor_type = Executor;
+
+    /**
+     * @param ex the executor that the fibers are spawned on.
+     * @param max_live the maximum number of admitted fibers, or 0 for no
+     * limit.
+     */
+    spawn_queue(Executor const& ex, std::size_t max_live);
+
+    spawn_queue(spawn_queue const&) = delete;
+    spawn_queue& operator=(spawn_queue const&) = delete;
+
+    ~spawn_queue();
+
+    executor_type get_executor() const noexcept
+    {
+        return ex_;
+    }
+
+    /**
+     * Spawns a fiber that invokes a `DECAY_COPY` of `f`, with a default
+     * constructed `boost::context::fixedsize_stack`.
+     */
+    template<class F>
+    void spawn(F&& f);
+
+    /**
+     * Spawns a fiber that invokes a `DECAY_COPY` of `f`. Its stack is
+     * allocated with a `DECAY_COPY` of `sa`.
+     */
+    template<class StackAllocator, class F>
+    void spawn(std::allocator_arg_t, StackAllocator&& sa, F&& f);
+
+    /**
+     * Returns the number of admitted fibers.
+     */
+    std::size_t live() const noexcept
+    {
+        return core_->live();
+    }
+
+    /**
+     * Returns the number of fibers waiting for admission.
+     */
+    std::size_t pending() const noexcept
+    {
+        return core_->pending();
+    }
+
+private:
+    Executor ex_;
+    detail::admission_core* core_;
+};
+
+} // namespace ufiber
+
+#include <ufiber/impl/spawn_queue.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/spawn_queue.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_SPAWN_QUEUE_HPP
@@ -0,0 +1,167 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_STACK_POOL_HPP
+#define UFIBER_STACK_POOL_HPP
+
+#include <ufiber/detail/stack_pool.hpp>
+
+#include <boost/context/protected_fixedsize_stack.hpp>
+
+/**
+ * @file
+ * Recycling StackAllocator for fibers.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Tuning parameters of a basic_stack_pool.
+ */
+struct stack_pool_options
+{
+    /**
+     * Maximum number of free stacks kept in a thread's local cache. When a
+     * deallocation exceeds it, the cache is drained down to `low_watermark` and
+     * the surplus is moved to the pool's global overflow list.
+     */
+    std::size_t high_watermark = 64;
+
+    /**
+     * Number of free stacks left in a thread's local cache after draining and
+     * the number of stacks taken from the global overflow list when the cache
+     * runs dry.
+     */
+    std::size_t low_watermark = 16;
+
+    /**
+     * Number of stacks allocated up front and placed on the global overflow
+     * list when the pool is constructed.
+     */
+    std::size_t prewarm = 0;
+};
+
+template<class StackAllocator>
+class basic_stack_pool;
+
+/**
+ * A lightweight, copyable handle to a basic_stack_pool that satisfies the
+ * requirements of the StackAllocator concept of boost::context. A copy of this
+ * object may be passed to the `spawn(std::allocator_arg, ...)` overload.
+ *
+ * Stacks released by a fiber are kept in a cache local to the thread the fiber
+ * terminated on, so allocation and deallocation in the common case touch no
+ * shared state. Handles keep the pool's state alive, so a pool may be
+ * destroyed while fibers allocated from it are still running.
+ */
+template<class StackAllocator>
+class basic_pooled_stack
+{
+public:
+    /**
+     * Allocates a stack, reusing a previously released one if available.
+     */
+    boost::context::stack_context allocate();
+
+    /**
+     * Returns a stack to the calling thread's cache.
+     */
+    void deallocate(boost::context::stack_context& sctx) noexcept;
+
+    /**
+     * Forwards to the underlying StackAllocator's `reclaimer()`, so that
+     * pooled lazy stacks can be trimmed. This function participates in
+     * overload resolution only if StackAllocator provides it.
+     */
+    template<class S = StackAllocator>
+    auto reclaimer() const noexcept
+      -> decltype(std::declval<S const&>().reclaimer())
+    {
+        return state_->sa_.reclaimer();
+    }
+
+private:
+    using state_type = detail::stack_pool_state<StackAllocator>;
+
+    explicit basic_pooled_stack(std::shared_ptr<state_type> state) noexcept;
+
+    friend class basic_stack_pool<StackAllocator>;
+
+    std::shared_ptr<state_type> state_;
+};
+
+/**
+ * A pool of fiber stacks. Stacks are obtained from the underlying
+ * StackAllocator only when both the calling thread's cache and the global
+ * overflow list are empty, and are returned to it when the pool's state is
+ * destroyed.
+ *
+ * @tparam StackAllocator the allocator used to obtain new stacks. All stacks
+ * in a pool have the size configured in this allocator.
+ */
+template<class StackAllocator>
+class basic_stack_pool
+{
+public:
+    /**
+     * StackAllocator type that draws stacks from this pool.
+     */
+    using allocator_type = basic_pooled_stack<StackAllocator>;
+
+    /**
+     * Constructs a pool which obtains stacks from `sa`.
+     *
+     * @param sa the StackAllocator used to allocate new stacks.
+     * @param opts watermarks and the number of stacks to allocate up front.
+     */
+    explicit basic_stack_pool(StackAllocator sa = StackAllocator{},
+                              stack_pool_options const& opts = {});
+
+    basic_stack_pool(basic_stack_pool const&) = delete;
+    basic_stack_pool& operator=(basic_stack_pool const&) = delete;
+
+    /**
+     * Destroys the pool. The stacks cached by the calling thread and those on
+     * the global overflow list are released once no allocator_type objects
+     * refer to the pool. Stacks cached by other threads are released when
+     * those threads exit.
+     */
+    ~basic_stack_pool();
+
+    /**
+     * Allocates `n` stacks and places them on the global overflow list.
+     */
+    void prewarm(std::size_t n);
+
+    /**
+     * Returns a StackAllocator that draws stacks from this pool.
+     */
+    allocator_type get_allocator() const noexcept;
+
+private:
+    std::shared_ptr<detail::stack_pool_state<StackAllocator>> state_;
+};
+
+/**
+ * A stack pool backed by `boost::context::protected_fixedsize_stack`.
+ */
+using stack_pool = basic_stack_pool<boost::context::protected_fixedsize_stack>;
+
+/**
+ * The StackAllocator type of `ufiber::stack_pool`.
+ */
+using pooled_stack =
+  basic_pooled_stack<boost::context::protected_fixedsize_stack>;
+
+} // namespace ufiber
+
+#include <ufiber/impl/stack_pool.hpp>
+
+#endif // UFIBER_STACK_POOL_HPP
@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_STACK_PROFILE_HPP
+#define UFIBER_STACK_PROFILE_HPP
+
+#include <ufiber/detail/stack_profile.hpp>
+
+#include <boost/context/protected_fixedsize_stack.hpp>
+#include <boost/context/stack_context.hpp>
+#include <boost/context/stack_traits.hpp>
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @file
+ * Stack high-water-mark measurement and adaptive stack sizing.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Statistics of the peak stack usage of a group of fibers, typically all
+ * fibers spawned with the same entry point. All member functions may be called
+ * concurrently.
+ */
+class stack_profile
+{
+public:
+    stack_profile() = default;
+    stack_profile(stack_profile const&) = delete;
+    stack_profile& operator=(stack_profile const&) = delete;
+
+    /**
+     * Records the peak usage of a single fiber.
+     *
+     * @param used number of bytes of the stack that were touched.
+     * @param exhausted whether the fiber came close to the end of its stack,
+     * in which case it may have needed more than it could touch.
+     */
+    UFIBER_INLINE_DECL void record(std::size_t used,
+                                   bool exhausted = false) noexcept;
+
+    /**
+     * Returns the highest usage recorded so far.
+     */
+    UFIBER_INLINE_DECL std::size_t peak() const noexcept;
+
+    /**
+     * Returns the number of recorded fibers.
+     */
+    UFIBER_INLINE_DECL std::size_t samples() const noexcept;
+
+    /**
+     * Returns the mean usage of recorded fibers.
+     */
+    UFIBER_INLINE_DECL std::size_t mean() const noexcept;
+
+    /**
+     * Returns a stack size sufficient for the recently recorded fibers: the
+     * peak usage of the last `UFIBER_STACK_PROFILE_WINDOW` to
+     * `2 * UFIBER_STACK_PROFILE_WINDOW` samples with 50% headroom, rounded up
+     * to whole pages and clamped to [min_size, max_size]. Returns `max_size`
+     * if nothing has been recorded, or if one of those samples was exhausted.
+     */
+    UFIBER_INLINE_DECL std::size_t recommended_size(
+      std::size_t min_size,
+      std::size_t max_size) const noexcept;
+
+private:
+    std::atomic<std::size_t> peak_{0};
+    std::atomic<std::size_t> samples_{0};
+    std::atomic<std::size_t> total_{0};
+    // Peaks of the current and the previous window of samples
+    std::atomic<std::size_t> current_{0};
+    std::atomic<std::size_t> previous_{0};
+};
+
+/**
+ * Returns the profile associated with `Tag`. Each distinct type has its own
+ * profile, so using a fiber's entry point type as `Tag` yields a profile per
+ * call site.
+ */
+template<class Tag>
+stack_profile&
+stack_profile_for() noexcept;
+
+/**
+ * A StackAllocator adaptor that measures the peak stack usage of each fiber.
+ * Stacks are filled with a sentinel pattern when they are allocated, and the
+ * untouched part is measured when the fiber has finished and its stack is
+ * deallocated. The result is recorded in a stack_profile.
+ *
+ * @remark Filling commits the whole stack, so this adaptor is not suitable for
+ * lazily committed stacks.
+ *
+ * @tparam StackAllocator the allocator used to obtain stacks.
+ */
+template<class StackAllocator>
+class measured_stack
+{
+public:
+    /**
+     * Constructs the adaptor.
+     *
+     * @param sa the allocator used to obtain stacks.
+     * @param profile the profile measurements are recorded in.
+     */
+    measured_stack(StackAllocator sa, stack_profile& profile) noexcept;
+
+    /**
+     * Allocates a stack and fills it with the sentinel pattern.
+     */
+    boost::context::stack_context allocate();
+
+    /**
+     * Records the stack's peak usage and deallocates it.
+     */
+    void deallocate(boost::context::stack_context& sctx) noexcept;
+
+private:
+    StackAllocator sa_;
+    stack_profile* profile_;
+};
+
+/**
+ * A StackAllocator which sizes stacks according to the peak usage measured for
+ * previous fibers with the same `Tag`. The first fibers are given `max_size`
+ * bytes, later ones get `stack_profile::recommended_size()`. Stacks are
+ * protected by a guard page. If a fiber's usage comes close to the size of its
+ * stack, the following fibers are given `max_size` bytes again, until that
+ * fiber's sample has left the profile's window.
+ *
+ * Example usage:
+ * @code
+ * ufiber::spawn(std::allocator_arg,
+ *               ufiber::adaptive_stack<session>{},
+ *               ex,
+ *               session{std::move(socket)});
+ * @endcode
+ *
+ * @tparam Tag the type identifying the call site, usually the type of the
+ * fiber's entry point.
+ */
+template<class Tag>
+class adaptive_stack
+{
+public:
+    /**
+     * Constructs the allocator.
+     *
+     * @param max_size upper bound of the stack size, used until the first
+     * measurement is available.
+     * @param min_size lower bound of the stack size.
+     */
+    explicit adaptive_stack(
+      std::size_t max_size = boost::context::stack_traits::default_size(),
+      std::size_t min_size = boost::context::stack_traits::page_size() *
+                             4) noexcept;
+
+    /**
+     * Allocates a stack of the currently recommended size.
+     */
+    boost::context::stack_context allocate();
+
+    /**
+     * Records the stack's peak usage and deallocates it.
+     */
+    void deallocate(boost::context::stack_context& sctx) noexcept;
+
+private:
+    std::size_t max_size_;
+    std::size_t min_size_;
+};
+
+} // namespace ufiber
+
+#include <ufiber/impl/stack_profile.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/stack_profile.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_STACK_PROFILE_HPP
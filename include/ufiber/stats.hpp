@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_STATS_HPP
+#define UFIBER_STATS_HPP
+
+#include <ufiber/detail/stats.hpp>
+
+#include <cstdint>
+
+/**
+ * @file
+ * Runtime counters of the fiber layer.
+ */
+
+namespace ufiber
+{
+
+/**
+ * A snapshot of the fiber layer's counters. Counters are only maintained if
+ * `UFIBER_ENABLE_STATS` is defined when the library is compiled, otherwise all
+ * of them are zero and the instrumentation compiles to nothing.
+ */
+struct fiber_stats
+{
+    /**
+     * Number of fibers that have been started.
+     */
+    std::uint64_t spawned = 0;
+
+    /**
+     * Number of fibers whose main function has finished, normally or by
+     * unwinding from a `broken_promise`.
+     */
+    std::uint64_t completed = 0;
+
+    /**
+     * Number of fibers that are currently running or suspended.
+     */
+    std::uint64_t live = 0;
+
+    /**
+     * Highest number of live fibers observed at any time.
+     */
+    std::uint64_t peak_live = 0;
+
+    /**
+     * Number of context switches away from a fiber (suspensions in an
+     * asynchronous operation).
+     */
+    std::uint64_t suspends = 0;
+
+    /**
+     * Number of context switches into a suspended fiber.
+     */
+    std::uint64_t resumes = 0;
+
+    /**
+     * Number of asynchronous operations that completed while they were being
+     * initiated, so that the fiber didn't have to be suspended.
+     */
+    std::uint64_t inline_completions = 0;
+
+    /**
+     * Number of times a fiber was rescheduled before an operation, because it
+     * had used up its run budget.
+     */
+    std::uint64_t budget_yields = 0;
+
+    /**
+     * Total size of the stacks of live fibers.
+     */
+    std::uint64_t stack_bytes = 0;
+
+    /**
+     * Number of `broken_promise` exceptions that escaped a fiber's main
+     * function.
+     */
+    std::uint64_t broken_promises = 0;
+};
+
+/**
+ * Returns whether the library has been compiled with statistics enabled.
+ */
+constexpr bool
+stats_enabled() noexcept
+{
+#ifdef UFIBER_ENABLE_STATS
+    return true;
+#else
+    return false;
+#endif // UFIBER_ENABLE_STATS
+}
+
+/**
+ * Aggregates the counters of all threads, including threads that have
+ * exited. Counters are updated with relaxed atomics, so a snapshot taken while
+ * fibers are running is not necessarily consistent across counters. This
+ * function may be called from any thread, e.g. by a metrics exporter.
+ */
+UFIBER_INLINE_DECL fiber_stats
+get_stats();
+
+/**
+ * Returns the counters of the calling thread. The `live` and `peak_live`
+ * fields are process-wide, because fibers may finish on a different thread
+ * than the one they were started on.
+ */
+UFIBER_INLINE_DECL fiber_stats
+get_thread_stats();
+
+} // namespace ufiber
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/stats.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_STATS_HPP
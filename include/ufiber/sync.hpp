@@ -0,0 +1,176 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_SYNC_HPP
+#define UFIBER_SYNC_HPP
+
+#include <ufiber/detail/wait_queue.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @file
+ * Synchronization primitives that suspend the calling fiber instead of
+ * blocking its thread.
+ */
+
+namespace ufiber
+{
+
+/**
+ * A mutex for fibers. A fiber that finds the mutex locked is suspended until
+ * the mutex is handed over to it. Ownership is handed over in FIFO order, so a
+ * fiber that has to wait can't be starved by fibers that lock later.
+ *
+ * Locking and unlocking an uncontended mutex is a single atomic operation. A
+ * resumed waiter runs on its own executor, so fibers on different executors
+ * and threads may share a mutex.
+ */
+class mutex
+{
+public:
+    mutex() = default;
+    mutex(mutex const&) = delete;
+    mutex& operator=(mutex const&) = delete;
+
+    /**
+     * Locks the mutex, suspending the calling fiber until the mutex is
+     * available.
+     *
+     * @note A waiting fiber is queued on its own stack and counts as
+     * outstanding work of its executor until it is resumed. It is not
+     * abandoned when the execution context shuts down, so a mutex that is
+     * never unlocked keeps the waiter's `run()` from returning.
+     */
+    template<class Executor>
+    void lock(yield_token<Executor>& yield);
+
+    /**
+     * Locks the mutex if it is available. Returns true on success.
+     */
+    UFIBER_INLINE_DECL bool try_lock() noexcept;
+
+    /**
+     * Unlocks the mutex, handing it over to the longest waiting fiber, if any.
+     * May be called from any thread.
+     */
+    UFIBER_INLINE_DECL void unlock() noexcept;
+
+private:
+    friend class condition_variable;
+
+    // Acquires the mutex on behalf of a suspended waiter
+    UFIBER_INLINE_DECL void lock_for(detail::waiter_base* w) noexcept;
+
+    // 1 if unlocked, 0 if locked, -N if locked with N waiters
+    std::atomic<std::ptrdiff_t> count_{1};
+    detail::wait_queue queue_;
+};
+
+/**
+ * A condition variable for fibers, used together with `ufiber::mutex`.
+ *
+ * Notified fibers are moved directly into the mutex's queue, so that
+ * `notify_all()` doesn't make every waiter contend for the mutex at once.
+ */
+class condition_variable
+{
+public:
+    condition_variable() = default;
+    condition_variable(condition_variable const&) = delete;
+    condition_variable& operator=(condition_variable const&) = delete;
+
+    /**
+     * Atomically unlocks `m` and suspends the calling fiber until it is
+     * notified. The mutex is locked again when this function returns.
+     *
+     * @pre `m` is locked by the calling fiber.
+     *
+     * @note As with `mutex::lock()`, the waiter keeps its executor's `run()`
+     * from returning until it is notified.
+     */
+    template<class Executor>
+    void wait(mutex& m, yield_token<Executor>& yield);
+
+    /**
+     * Waits until `pred()` returns true.
+     */
+    template<class Executor, class Predicate>
+    void wait(mutex& m, yield_token<Executor>& yield, Predicate pred);
+
+    /**
+     * Wakes the longest waiting fiber, if any.
+     */
+    UFIBER_INLINE_DECL void notify_one() noexcept;
+
+    /**
+     * Wakes all waiting fibers.
+     */
+    UFIBER_INLINE_DECL void notify_all() noexcept;
+
+private:
+    std::mutex mutex_;
+    detail::waiter_list waiters_;
+};
+
+/**
+ * A counting semaphore for fibers. Waiters are resumed in FIFO order, each
+ * `release()` hands a unit over to exactly one waiter.
+ */
+class semaphore
+{
+public:
+    /**
+     * Constructs a semaphore with `initial` available units.
+     */
+    explicit semaphore(std::ptrdiff_t initial) noexcept
+      : count_{initial}
+    {
+    }
+
+    semaphore(semaphore const&) = delete;
+    semaphore& operator=(semaphore const&) = delete;
+
+    /**
+     * Takes a unit, suspending the calling fiber until one is available.
+     *
+     * @note As with `mutex::lock()`, the waiter keeps its executor's `run()`
+     * from returning until it is given a unit.
+     */
+    template<class Executor>
+    void acquire(yield_token<Executor>& yield);
+
+    /**
+     * Takes a unit if one is available. Returns true on success.
+     */
+    UFIBER_INLINE_DECL bool try_acquire() noexcept;
+
+    /**
+     * Returns `n` units, waking up to `n` waiting fibers. May be called from
+     * any thread.
+     */
+    UFIBER_INLINE_DECL void release(std::ptrdiff_t n = 1) noexcept;
+
+private:
+    // Available units, or -N if N fibers are waiting
+    std::atomic<std::ptrdiff_t> count_;
+    detail::wait_queue queue_;
+};
+
+} // namespace ufiber
+
+#include <ufiber/impl/sync.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/sync.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_SYNC_HPP
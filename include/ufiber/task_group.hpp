@@ -0,0 +1,182 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_TASK_GROUP_HPP
+#define UFIBER_TASK_GROUP_HPP
+
+#include <ufiber/detail/task_group.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <cstddef>
+#include <utility>
+
+/**
+ * @file
+ * Groups of child fibers that are joined and cancelled together.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Tells a child of a `task_group` whether the group has been cancelled.
+ *
+ * A token refers to its group's shared state, which stays alive while the
+ * child that received the token is running.
+ */
+class stop_token
+{
+public:
+    /**
+     * Returns whether the group has been cancelled.
+     */
+    bool stop_requested() const noexcept
+    {
+        return core_->stop_requested();
+    }
+
+private:
+    template<class F>
+    friend class stop_callback;
+
+    friend stop_token detail::make_stop_token(detail::group_core*) noexcept;
+
+    explicit stop_token(detail::group_core* core) noexcept
+      : core_{core}
+    {
+    }
+
+    detail::group_core* core_;
+};
+
+/**
+ * Invokes a function object when a `task_group` is cancelled, as long as the
+ * stop_callback exists. Children use it to cancel their pending operations,
+ * e.g. by calling `cancel()` on a socket, so that they return promptly.
+ *
+ * If the group has already been cancelled, the function object is invoked by
+ * the constructor. Otherwise it is invoked by the thread that cancels the
+ * group, and the destructor waits for it to return. The function object must
+ * not throw and must not destroy the stop_callback.
+ */
+template<class F>
+class stop_callback : private detail::stop_callback_base
+{
+public:
+    stop_callback(stop_token const& token, F f)
+      : detail::stop_callback_base{&stop_callback::do_invoke}
+      , f_{std::move(f)}
+      , core_{token.core_}
+    {
+        if (!core_->add_callback(this))
+        {
+            f_();
+        }
+    }
+
+    stop_callback(stop_callback const&) = delete;
+    stop_callback& operator=(stop_callback const&) = delete;
+
+    ~stop_callback()
+    {
+        core_->remove_callback(this);
+    }
+
+private:
+    static void do_invoke(detail::stop_callback_base* base)
+    {
+        static_cast<stop_callback*>(base)->f_();
+    }
+
+    F f_;
+    detail::group_core* core_;
+};
+
+/**
+ * A scope for child fibers. A fiber creates the group on its own stack and
+ * spawns children into it, which run on the same executor. The group doesn't
+ * outlive its children: `async_wait_all()` waits for them, and so does the
+ * destructor. Children may therefore refer to the parent's local variables.
+ *
+ * Cancelling the group, either explicitly or because a child exited with an
+ * exception, is cooperative. Children that haven't started yet are not run,
+ * and running children observe it through a `stop_token`. Destroying a group
+ * with running children cancels it before waiting.
+ *
+ * A limit on the number of running children bounds the memory held by
+ * in-flight work: `spawn()` suspends the parent while the limit is reached.
+ */
+class task_group
+{
+public:
+    /**
+     * Constructs a group owned by the fiber of `yield`.
+     *
+     * @param yield the yield_token of the calling fiber, which must outlive
+     * the group.
+     * @param limit the maximum number of running children, or 0 for no limit.
+     */
+    template<class Executor>
+    explicit task_group(yield_token<Executor>& yield, std::size_t limit = 0);
+
+    task_group(task_group const&) = delete;
+    task_group& operator=(task_group const&) = delete;
+
+    /**
+     * Cancels the group if children are still running, and suspends the
+     * owning fiber until they have finished.
+     */
+    UFIBER_INLINE_DECL ~task_group();
+
+    /**
+     * Spawns a child fiber that invokes a `DECAY_COPY` of `f` with a
+     * `yield_token`, and, if `f` accepts one, a `stop_token`. Suspends the
+     * calling fiber while the group has `limit` running children.
+     */
+    template<class Executor, class F>
+    void spawn(yield_token<Executor>& yield, F&& f);
+
+    /**
+     * Suspends the calling fiber until all children have finished. Rethrows
+     * the first exception that escaped from a child since the last call.
+     */
+    template<class Executor>
+    void async_wait_all(yield_token<Executor>& yield);
+
+    /**
+     * Cancels the group. Children spawned afterwards are not run.
+     */
+    UFIBER_INLINE_DECL void cancel() noexcept;
+
+    /**
+     * Returns whether the group has been cancelled.
+     */
+    bool cancelled() const noexcept
+    {
+        return core_->stop_requested();
+    }
+
+private:
+    template<class Executor>
+    static void drain(task_group& self) noexcept;
+
+    detail::group_core* core_;
+    void* yield_;
+    void (*drain_)(task_group&);
+};
+
+} // namespace ufiber
+
+#include <ufiber/impl/task_group.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/task_group.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_TASK_GROUP_HPP
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_THIS_FIBER_HPP
+#define UFIBER_THIS_FIBER_HPP
+
+#include <ufiber/ufiber.hpp>
+
+#include <chrono>
+#include <cstddef>
+
+/**
+ * @file
+ * Cooperative scheduling of the calling fiber.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Limits how long a fiber may run between two suspensions. Once either limit
+ * has been reached, the fiber's next asynchronous operation first reschedules
+ * the fiber on its executor, so that a fiber whose operations keep completing
+ * immediately can't starve other fibers and handlers. A limit of zero is
+ * disabled.
+ *
+ * The defaults are `UFIBER_BUDGET_OPERATIONS` and `UFIBER_BUDGET_MICROSECONDS`,
+ * both of which are zero unless they are defined when compiling the library.
+ */
+struct yield_budget
+{
+    /**
+     * Number of operations that may complete without suspending the fiber.
+     */
+    std::size_t operations = 0;
+
+    /**
+     * Time the fiber may run after it has been resumed. Enabling it reads
+     * `std::chrono::steady_clock` on every resumption and operation.
+     */
+    std::chrono::microseconds time{0};
+};
+
+namespace this_fiber
+{
+
+/**
+ * Reschedules the calling fiber behind the handlers that are already queued
+ * on its executor. The requeued handler is allocated from the fiber's own
+ * storage.
+ *
+ * @throws broken_promise if the executor is destroyed before the fiber is
+ * resumed.
+ */
+template<class Executor>
+void
+yield(yield_token<Executor>& yield);
+
+/**
+ * Replaces the run budget of the calling fiber. The budget of the current
+ * run starts over.
+ */
+template<class Executor>
+void
+set_budget(yield_token<Executor>& yield, yield_budget const& budget) noexcept;
+
+/**
+ * Returns the run budget of the calling fiber.
+ */
+template<class Executor>
+yield_budget
+get_budget(yield_token<Executor>& yield) noexcept;
+
+} // namespace this_fiber
+} // namespace ufiber
+
+#include <ufiber/impl/this_fiber.hpp>
+
+#endif // UFIBER_THIS_FIBER_HPP
@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_TRACE_HPP
+#define UFIBER_TRACE_HPP
+
+#include <ufiber/detail/trace.hpp>
+
+#include <iosfwd>
+
+/**
+ * @file
+ * Scheduling event tracing of fibers.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Returns whether the library has been compiled with tracing hooks
+ * (`UFIBER_ENABLE_TRACING`). Without them, the functions in this header have
+ * no effect.
+ */
+constexpr bool
+tracing_enabled() noexcept
+{
+#ifdef UFIBER_ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif // UFIBER_ENABLE_TRACING
+}
+
+/**
+ * Starts recording scheduling events. Each thread that runs a fiber records
+ * the start, suspension, resumption and completion of fibers into its own
+ * ring buffer of `UFIBER_TRACE_BUFFER_SIZE` events, overwriting the oldest
+ * events once the buffer is full.
+ */
+UFIBER_INLINE_DECL void
+start_tracing() noexcept;
+
+/**
+ * Stops recording scheduling events. Events that have already been recorded
+ * are kept.
+ */
+UFIBER_INLINE_DECL void
+stop_tracing() noexcept;
+
+/**
+ * Writes the recorded events in the Chrome trace event format, which can be
+ * loaded by `chrome://tracing` and Perfetto. Every fiber is shown as a separate
+ * track, with a `run` slice for each period the fiber was running and a
+ * `suspended` slice for each period it waited in an asynchronous operation.
+ *
+ * This function may be called while fibers are running, it does not block
+ * the threads that record events.
+ */
+UFIBER_INLINE_DECL void
+write_chrome_trace(std::ostream& os);
+
+} // namespace ufiber
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/trace.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_TRACE_HPP
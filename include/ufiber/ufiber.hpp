@@ -11,6 +11,10 @@
 #define UFIBER_UFIBER_HPP
 
 #include <ufiber/detail/ufiber.hpp>
+#include <ufiber/registry.hpp>
+#include <ufiber/stats.hpp>
+#include <ufiber/trace.hpp>
+#include <ufiber/watchdog.hpp>
 
 /**
  * @file
@@ -77,6 +81,11 @@ public:
      */
     executor_type get_executor() noexcept;
 
+    /**
+     * Returns the arena of the fiber this yield_token refers to.
+     */
+    fiber_arena& arena() noexcept;
+
 private:
     yield_token(Executor const& ex, detail::fiber_context&);
 
@@ -139,6 +148,38 @@ template<class Alloc, class E, class F>
 void
 spawn(std::allocator_arg_t arg, Alloc&& sa, E const& ex, F&& f);
 
+/**
+ * Spawns a new fiber like `spawn(ex, f)`, but dispatches instead of posting
+ * the fiber onto its executor. If the calling thread is running `ex`, the
+ * fiber's main function starts before this function returns, and runs until
+ * it first suspends. Otherwise the fiber is posted, as with `spawn()`.
+ *
+ * Starting inline saves a round-trip through the executor's queue, e.g.
+ * between accepting a connection and the first read from it. `spawn()` is
+ * fairer, because the spawning code continues first.
+ */
+template<class E, class F>
+auto
+spawn_dispatch(E const& ex, F&& f) ->
+  typename std::enable_if<boost::asio::is_executor<E>::value>::type;
+
+/**
+ * Spawns a new fiber like `spawn(ctx, f)`, but dispatches it onto the
+ * context's executor.
+ */
+template<class Ctx, class F>
+auto
+spawn_dispatch(Ctx& ctx, F&& f) -> typename std::enable_if<
+  std::is_convertible<Ctx&, boost::asio::execution_context&>::value>::type;
+
+/**
+ * Spawns a new fiber like `spawn(std::allocator_arg, sa, ex, f)`, but
+ * dispatches it onto `ex`.
+ */
+template<class Alloc, class E, class F>
+void
+spawn_dispatch(std::allocator_arg_t arg, Alloc&& sa, E const& ex, F&& f);
+
 } // namespace ufiber
 
 #include <ufiber/impl/ufiber.hpp>
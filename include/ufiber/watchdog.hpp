@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_WATCHDOG_HPP
+#define UFIBER_WATCHDOG_HPP
+
+#include <ufiber/detail/watchdog.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @file
+ * Detection of fibers that run for too long without suspending.
+ */
+
+namespace ufiber
+{
+
+/**
+ * Returns whether the library has been compiled with watchdog hooks
+ * (`UFIBER_ENABLE_WATCHDOG`). Without them, a `watchdog` never reports
+ * anything.
+ */
+constexpr bool
+watchdog_enabled() noexcept
+{
+#ifdef UFIBER_ENABLE_WATCHDOG
+    return true;
+#else
+    return false;
+#endif // UFIBER_ENABLE_WATCHDOG
+}
+
+/**
+ * Describes a fiber that has exceeded the watchdog's budget.
+ */
+struct watchdog_report
+{
+    /// ID of the fiber, as used by the fiber registry and tracing.
+    std::uint64_t fiber;
+
+    /// Name of the fiber if the fiber registry is enabled, otherwise empty.
+    std::string name;
+
+    /// Time the fiber has been running since it was last resumed.
+    std::chrono::steady_clock::duration elapsed;
+
+    /// Index of the thread running the fiber, in the order in which threads
+    /// first ran a fiber.
+    std::size_t thread;
+};
+
+/**
+ * Monitors the threads that run fibers from a background thread, and reports
+ * fibers that run for longer than a budget without suspending.
+ *
+ * Resuming a fiber only stores a new run number and the time in a slot owned
+ * by the current thread. The monitor samples the slots periodically, so a
+ * fiber is reported up to one sampling interval (a quarter of the budget)
+ * after it has exceeded the budget, with the time it has been running since
+ * it was resumed. Each run of a fiber is reported at most once.
+ */
+class watchdog
+{
+public:
+    using handler_type = std::function<void(watchdog_report const&)>;
+
+    /**
+     * Starts the monitor thread. If `handler` is empty, reports are written to
+     * `std::cerr`. The handler is invoked on the monitor thread.
+     */
+    UFIBER_INLINE_DECL explicit watchdog(
+      std::chrono::steady_clock::duration budget,
+      handler_type handler = handler_type{});
+
+    /**
+     * Stops and joins the monitor thread.
+     */
+    UFIBER_INLINE_DECL ~watchdog();
+
+    watchdog(watchdog const&) = delete;
+    watchdog& operator=(watchdog const&) = delete;
+
+private:
+    UFIBER_INLINE_DECL void run();
+
+    std::chrono::steady_clock::duration budget_;
+    handler_type handler_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopped_ = false;
+    std::thread thread_;
+};
+
+} // namespace ufiber
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/watchdog.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_WATCHDOG_HPP
@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_WHEN_HPP
+#define UFIBER_WHEN_HPP
+
+#include <ufiber/detail/when.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/async_result.hpp>
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @file
+ * Waiting for several asynchronous operations of one fiber at once.
+ */
+
+namespace ufiber
+{
+
+/**
+ * The CompletionToken passed to each operation started by `when_all()` and
+ * `when_any()`. An operation is a function object that passes the token to an
+ * initiating function and returns its result, e.g.
+ * `[&](ufiber::leg_token t) { return socket.async_read_some(buffer, t); }`.
+ */
+class leg_token
+{
+private:
+    template<class... Args>
+    friend class detail::leg_handler;
+
+    template<class Executor, class... Ops>
+    friend struct detail::when_launcher;
+
+    leg_token(detail::when_state_base* state, std::size_t index) noexcept
+      : state_{state}
+      , index_{index}
+    {
+    }
+
+    detail::when_state_base* state_;
+    std::size_t index_;
+};
+
+/**
+ * Attaches a function object that cancels an operation, which `when_any()`
+ * invokes if another operation completes first. It usually calls `cancel()`
+ * on the I/O object the operation was started on. It is invoked on the thread
+ * that completes the winning operation, and must not throw.
+ */
+template<class Op, class Cancel>
+detail::cancellable_op<typename std::decay<Op>::type,
+                       typename std::decay<Cancel>::type>
+cancellable(Op&& op, Cancel&& cancel);
+
+/**
+ * Starts all operations and suspends the calling fiber once, until every one
+ * of them has completed. Returns the results in the order of the operations.
+ * The result of an operation is its completion handler's argument, a tuple of
+ * the arguments if there are several, or an empty tuple if there are none.
+ *
+ * @throws broken_promise if an operation is abandoned.
+ * @throws any exception thrown while an operation is started, once the
+ * operations started before it have been cancelled and have completed.
+ */
+template<class Executor, class... Ops>
+std::tuple<detail::leg_result_t<Ops>...>
+when_all(yield_token<Executor>& yield, Ops&&... ops);
+
+/**
+ * Starts all operations and suspends the calling fiber once, until one of
+ * them has completed and the rest, which are cancelled if they were wrapped
+ * by `cancellable()`, have completed too. Returns the index of the operation
+ * that completed first, and the results of all operations.
+ *
+ * @throws broken_promise if an operation is abandoned.
+ * @throws any exception thrown while an operation is started, once the
+ * operations started before it have been cancelled and have completed.
+ */
+template<class Executor, class... Ops>
+std::pair<std::size_t, std::tuple<detail::leg_result_t<Ops>...>>
+when_any(yield_token<Executor>& yield, Ops&&... ops);
+
+} // namespace ufiber
+
+#include <ufiber/impl/when.hpp>
+
+#ifndef UFIBER_SEPARATE_COMPILATION
+#include <ufiber/impl/when.ipp>
+#endif // UFIBER_SEPARATE_COMPILATION
+
+#endif // UFIBER_WHEN_HPP
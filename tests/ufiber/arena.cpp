@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/arena.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+std::uintptr_t
+address(void const* p)
+{
+    return reinterpret_cast<std::uintptr_t>(p);
+}
+
+bool
+near(void const* a, void const* b)
+{
+    auto const x = address(a);
+    auto const y = address(b);
+    return (x > y ? x - y : y - x) < 16 * 1024;
+}
+
+} // namespace
+
+int
+main()
+{
+    {
+        // The first block is on the fiber's stack and is reused after reset
+        boost::asio::io_context io;
+        bool done = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            char local = 0;
+            auto& arena = yield.arena();
+            auto const first = arena.allocate(16);
+            BOOST_TEST(near(first, &local));
+            BOOST_TEST(address(first) % alignof(std::max_align_t) == 0);
+
+            auto const small = arena.allocate(1, 1);
+            auto const aligned = arena.allocate(8, 64);
+            BOOST_TEST(address(small) == address(first) + 16);
+            BOOST_TEST(address(aligned) % 64 == 0);
+
+            // Exceeds the first block
+            auto const large = arena.allocate(UFIBER_ARENA_STACK_BLOCK);
+            BOOST_TEST(!near(large, &local));
+
+            boost::asio::post(yield);
+            arena.reset();
+            BOOST_TEST(arena.allocate(16) == first);
+            // Served by the block that was kept by reset()
+            BOOST_TEST(arena.allocate(UFIBER_ARENA_STACK_BLOCK) == large);
+            done = true;
+        });
+        io.run();
+        BOOST_TEST(done);
+    }
+
+    {
+        // Containers with the C++11 allocator
+        boost::asio::io_context io;
+        std::size_t total = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            using alloc_t = ufiber::arena_allocator<char>;
+            using string_t =
+              std::basic_string<char, std::char_traits<char>, alloc_t>;
+            for (int request = 0; request < 10; ++request)
+            {
+                alloc_t alloc{yield.arena()};
+                std::vector<string_t, ufiber::arena_allocator<string_t>>
+                  parts{alloc};
+                for (int i = 0; i < 100; ++i)
+                {
+                    parts.emplace_back(
+                      std::string(static_cast<std::size_t>(i), 'x').c_str(),
+                      alloc);
+                }
+                for (auto const& p : parts)
+                {
+                    total += p.size();
+                }
+                parts.clear();
+                parts.shrink_to_fit();
+                boost::asio::post(yield);
+                yield.arena().reset();
+            }
+        });
+        io.run();
+        BOOST_TEST(total == 10 * 4950);
+    }
+
+    {
+        // Each fiber has its own arena, whose heap blocks are released when
+        // the fiber finishes, also if it's unwound by broken_promise
+        void* a = nullptr;
+        void* b = nullptr;
+        {
+            boost::asio::io_context io;
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                a = yield.arena().allocate(8);
+                yield.arena().allocate(64 * 1024);
+                boost::asio::post(yield);
+            });
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                b = yield.arena().allocate(8);
+                yield.arena().allocate(64 * 1024);
+                boost::asio::post(yield);
+            });
+            io.poll_one();
+            io.poll_one();
+        }
+        BOOST_TEST(a != nullptr && b != nullptr && a != b);
+    }
+
+#ifdef UFIBER_HAS_MEMORY_RESOURCE
+    {
+        boost::asio::io_context io;
+        bool done = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::arena_resource resource{yield.arena()};
+            std::pmr::vector<std::pmr::string> words{&resource};
+            for (int i = 0; i < 50; ++i)
+            {
+                words.emplace_back(64, 'a');
+            }
+            BOOST_TEST(words.back().size() == 64);
+            done = true;
+        });
+        io.run();
+        BOOST_TEST(done);
+    }
+#endif // UFIBER_HAS_MEMORY_RESOURCE
+
+    return boost::report_errors();
+}
@@ -0,0 +1,311 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/channel.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+void
+run_threads(boost::asio::io_context& io, int n)
+{
+    std::vector<std::thread> threads;
+    for (int i = 1; i < n; ++i)
+    {
+        threads.emplace_back([&io] { io.run(); });
+    }
+    io.run();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+// Throws from the move constructor that brings `moves_left` to 0
+struct fragile
+{
+    static int moves_left;
+
+    fragile() = default;
+
+    explicit fragile(int v) noexcept
+      : value{v}
+    {
+    }
+
+    fragile(fragile&& other)
+      : value{other.value}
+    {
+        if (moves_left > 0 && --moves_left == 0)
+        {
+            throw std::runtime_error{"move"};
+        }
+    }
+
+    fragile& operator=(fragile&&) = default;
+
+    int value = 0;
+};
+
+int fragile::moves_left = 0;
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Values are received in order, then close() is reported
+        boost::asio::io_context io{};
+        ufiber::channel<int> ch{2};
+        std::vector<int> received;
+        boost::system::error_code last;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            for (int i = 0; i < 10; ++i)
+            {
+                BOOST_TEST(!ch.send(i, yield));
+            }
+            ch.close();
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            for (;;)
+            {
+                boost::system::error_code ec;
+                int v;
+                std::tie(ec, v) = ch.receive(yield);
+                if (ec)
+                {
+                    last = ec;
+                    return;
+                }
+                received.push_back(v);
+            }
+        });
+        io.run();
+        BOOST_TEST(
+          (received == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+        BOOST_TEST(last == ufiber::channel_errc::closed);
+        BOOST_TEST(ch.is_closed());
+    }
+
+    {
+        // A full channel suspends its producer
+        boost::asio::io_context io{};
+        ufiber::channel<int> ch{2};
+        int sent = 0;
+        boost::system::error_code send_ec;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            for (int i = 0; i < 5; ++i)
+            {
+                send_ec = ch.send(i, yield);
+                if (send_ec)
+                {
+                    return;
+                }
+                ++sent;
+            }
+        });
+        io.poll();
+        io.restart();
+        BOOST_TEST(sent == 2);
+        int v = -1;
+        BOOST_TEST(ch.try_receive(v));
+        BOOST_TEST(v == 0);
+        io.poll();
+        io.restart();
+        BOOST_TEST(sent == 3);
+
+        // Closing wakes the suspended sender with an error, but buffered values
+        // can still be received
+        ch.close();
+        io.run();
+        BOOST_TEST(sent == 3);
+        BOOST_TEST(send_ec == ufiber::channel_errc::closed);
+        BOOST_TEST(ch.try_receive(v));
+        BOOST_TEST(v == 1);
+        BOOST_TEST(ch.try_receive(v));
+        BOOST_TEST(v == 2);
+        BOOST_TEST(!ch.try_receive(v));
+        BOOST_TEST(!ch.try_send(v));
+    }
+
+    {
+        // An unbuffered channel hands values directly between fibers
+        boost::asio::io_context io{};
+        ufiber::channel<std::unique_ptr<int>> ch{0};
+        std::unique_ptr<int> p{new int{42}};
+        BOOST_TEST(!ch.try_send(p));
+        BOOST_TEST(p != nullptr);
+        int result = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            BOOST_TEST(!ch.send(std::move(p), yield));
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::system::error_code ec;
+            std::unique_ptr<int> v;
+            std::tie(ec, v) = ch.receive(yield);
+            BOOST_TEST(!ec);
+            result = v ? *v : 0;
+        });
+        io.run();
+        BOOST_TEST(result == 42);
+    }
+
+    {
+        // Several producers and consumers on a multi-threaded io_context
+        boost::asio::io_context io{4};
+        ufiber::channel<int> ch{8};
+        std::atomic<int> producers{4};
+        std::atomic<long> sum{0};
+        std::atomic<int> count{0};
+        for (int p = 0; p < 4; ++p)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                for (int i = 1; i <= 250; ++i)
+                {
+                    BOOST_TEST(!ch.send(i, yield));
+                }
+                if (--producers == 0)
+                {
+                    ch.close();
+                }
+            });
+        }
+        for (int c = 0; c < 4; ++c)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                for (;;)
+                {
+                    boost::system::error_code ec;
+                    int v;
+                    std::tie(ec, v) = ch.receive(yield);
+                    if (ec)
+                    {
+                        return;
+                    }
+                    sum += v;
+                    ++count;
+                }
+            });
+        }
+        run_threads(io, 4);
+        BOOST_TEST(count == 1000);
+        BOOST_TEST(sum == 4 * 250 * 251 / 2);
+    }
+
+    {
+        // Producer and consumer on different io_contexts
+        boost::asio::io_context producer_io{};
+        boost::asio::io_context consumer_io{};
+        ufiber::channel<int> ch{1};
+        int sum = 0;
+        ufiber::spawn(producer_io, [&](yield_token_t yield) {
+            for (int i = 1; i <= 100; ++i)
+            {
+                BOOST_TEST(!ch.send(i, yield));
+            }
+            ch.close();
+        });
+        ufiber::spawn(consumer_io, [&](yield_token_t yield) {
+            for (;;)
+            {
+                boost::system::error_code ec;
+                int v;
+                std::tie(ec, v) = ch.receive(yield);
+                if (ec)
+                {
+                    return;
+                }
+                sum += v;
+            }
+        });
+        std::thread t{[&] { producer_io.run(); }};
+        consumer_io.run();
+        t.join();
+        BOOST_TEST(sum == 5050);
+    }
+
+    {
+        // A value that can't be moved to a waiting receiver leaves it waiting
+        boost::asio::io_context io{};
+        ufiber::channel<fragile> ch{0};
+        int received = 0;
+        bool threw = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::system::error_code ec;
+            fragile f;
+            std::tie(ec, f) = ch.receive(yield);
+            BOOST_TEST(!ec);
+            received = f.value;
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            fragile f{1};
+            // The first move constructs the argument
+            fragile::moves_left = 2;
+            try
+            {
+                ch.send(std::move(f), yield);
+            }
+            catch (std::runtime_error const&)
+            {
+                threw = true;
+            }
+            BOOST_TEST(!ch.send(fragile{2}, yield));
+        });
+        io.run();
+        BOOST_TEST(threw);
+        BOOST_TEST(received == 2);
+    }
+
+    {
+        // A sender whose value can't refill the buffer keeps waiting
+        boost::asio::io_context io{};
+        ufiber::channel<fragile> ch{1};
+        std::vector<int> received;
+        bool sent = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            BOOST_TEST(!ch.send(fragile{1}, yield));
+            BOOST_TEST(!ch.send(fragile{2}, yield));
+            sent = true;
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            // The first move takes the buffered value
+            fragile::moves_left = 2;
+            for (int i = 0; i < 2; ++i)
+            {
+                boost::system::error_code ec;
+                fragile f;
+                std::tie(ec, f) = ch.receive(yield);
+                BOOST_TEST(!ec);
+                received.push_back(f.value);
+            }
+        });
+        io.run();
+        BOOST_TEST(sent);
+        BOOST_TEST(received == (std::vector<int>{1, 2}));
+    }
+
+    boost::system::error_code ec = ufiber::channel_errc::closed;
+    BOOST_TEST(ec.message() == "Channel closed");
+
+    return boost::report_errors();
+}
@@ -0,0 +1,278 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/deadline.hpp>
+#include <ufiber/scheduler.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+using socket_t = boost::asio::local::stream_protocol::socket;
+using clock_type = std::chrono::steady_clock;
+
+// A fiber suspended until resume() invokes its handler inline
+struct parked_fiber
+{
+    void park(yield_token_t& yield)
+    {
+        boost::asio::async_initiate<yield_token_t&, void()>(
+          [this](auto handler) {
+              auto h = std::make_shared<decltype(handler)>(std::move(handler));
+              resume_ = [h] { (*h)(); };
+          },
+          yield);
+    }
+
+    void resume()
+    {
+        auto f = std::move(resume_);
+        resume_ = nullptr;
+        f();
+    }
+
+    std::function<void()> resume_;
+};
+
+} // namespace
+
+int
+main()
+{
+    {
+        // A read that doesn't complete in time is cancelled
+        boost::asio::io_context io;
+        socket_t a{io};
+        socket_t b{io};
+        boost::asio::local::connect_pair(a, b);
+        boost::system::error_code result;
+        int cancels = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            char buf[16];
+            std::tie(result, std::ignore) = a.async_read_some(
+              boost::asio::buffer(buf),
+              ufiber::with_timeout(yield, std::chrono::milliseconds{10}, [&] {
+                  ++cancels;
+                  boost::system::error_code ec;
+                  a.cancel(ec);
+              }));
+        });
+        io.run();
+        BOOST_TEST(result == boost::asio::error::operation_aborted);
+        BOOST_TEST(cancels == 1);
+    }
+
+    {
+        // An operation that completes in time is left alone, and a pending
+        // deadline doesn't keep the io_context running
+        boost::asio::io_context io;
+        socket_t a{io};
+        socket_t b{io};
+        boost::asio::local::connect_pair(a, b);
+        std::size_t n = 0;
+        int cancels = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            char buf[16];
+            boost::system::error_code ec;
+            std::tie(ec, n) = a.async_read_some(
+              boost::asio::buffer(buf),
+              ufiber::with_timeout(
+                yield, std::chrono::hours{1}, [&] { ++cancels; }));
+            BOOST_TEST(!ec);
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::asio::async_write(b, boost::asio::buffer("abc", 3), yield);
+        });
+        auto const start = clock_type::now();
+        io.run();
+        BOOST_TEST(clock_type::now() - start < std::chrono::seconds{10});
+        BOOST_TEST(n == 3);
+        BOOST_TEST(cancels == 0);
+    }
+
+    {
+        // Deadlines expire in order, also when an earlier one is added after
+        // a later one has armed the shared timer
+        boost::asio::io_context io;
+        std::vector<int> order;
+        auto const now = clock_type::now();
+        for (int i : {3, 1, 2, 0})
+        {
+            ufiber::spawn(io, [&, i](yield_token_t yield) {
+                boost::asio::steady_timer t{io, std::chrono::hours{1}};
+                auto const ec = t.async_wait(ufiber::with_deadline(
+                  yield, now + std::chrono::milliseconds{5 * i}, [&t] {
+                      t.cancel();
+                  }));
+                BOOST_TEST(ec == boost::asio::error::operation_aborted);
+                order.push_back(i);
+            });
+        }
+        io.run();
+        BOOST_TEST((order == std::vector<int>{0, 1, 2, 3}));
+    }
+
+    {
+        // Deadlines on a multi-threaded io_context, half of which expire
+        boost::asio::io_context io{4};
+        std::atomic<int> aborted{0};
+        std::atomic<int> completed{0};
+        for (int i = 0; i < 64; ++i)
+        {
+            ufiber::spawn(io, [&, i](yield_token_t yield) {
+                boost::asio::steady_timer t{
+                  io, std::chrono::milliseconds{i % 2 == 0 ? 1 : 5000}};
+                auto const ec = t.async_wait(ufiber::with_timeout(
+                  yield, std::chrono::milliseconds{50}, [&t] { t.cancel(); }));
+                if (ec == boost::asio::error::operation_aborted)
+                {
+                    ++aborted;
+                }
+                else if (!ec)
+                {
+                    ++completed;
+                }
+            });
+        }
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i)
+        {
+            threads.emplace_back([&io] { io.run(); });
+        }
+        io.run();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(aborted == 32);
+        BOOST_TEST(completed == 32);
+    }
+
+    {
+        // Fibers on a scheduler share the timer of its reactor
+        boost::asio::io_context reactor;
+        ufiber::scheduler sched{reactor, 2};
+        socket_t a{reactor};
+        socket_t b{reactor};
+        boost::asio::local::connect_pair(a, b);
+        boost::system::error_code result;
+        ufiber::spawn(
+          sched,
+          [&](ufiber::yield_token<ufiber::scheduler::executor_type> yield) {
+              char buf[16];
+              std::tie(result, std::ignore) = a.async_read_some(
+                boost::asio::buffer(buf),
+                ufiber::with_timeout(
+                  yield, std::chrono::milliseconds{10}, [&] {
+                      boost::system::error_code ec;
+                      a.cancel(ec);
+                  }));
+          });
+        sched.run();
+        BOOST_TEST(result == boost::asio::error::operation_aborted);
+    }
+
+    {
+        // A fiber unwound by broken_promise removes its deadline
+        int cancels = 0;
+        bool unwound = false;
+        {
+            boost::asio::io_context io;
+            boost::asio::steady_timer t{io, std::chrono::hours{1}};
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                struct guard
+                {
+                    ~guard()
+                    {
+                        flag = true;
+                    }
+                    bool& flag;
+                } g{unwound};
+                t.async_wait(ufiber::with_timeout(
+                  yield, std::chrono::hours{1}, [&] { ++cancels; }));
+            });
+            io.run_one();
+        }
+        BOOST_TEST(unwound);
+        BOOST_TEST(cancels == 0);
+    }
+
+    {
+        // An initiation that resumes another fiber inline, which adds a
+        // deadline of its own
+        boost::asio::io_context io;
+        parked_fiber parked;
+        bool slept = false;
+        bool done = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            parked.park(yield);
+            ufiber::sleep_for(yield, std::chrono::milliseconds{1});
+            slept = true;
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            auto token =
+              ufiber::with_timeout(yield, std::chrono::hours{1}, [] {});
+            boost::asio::async_initiate<decltype(token), void()>(
+              [&](auto handler) {
+                  parked.resume();
+                  boost::asio::post(io, std::move(handler));
+              },
+              token);
+            done = true;
+        });
+        io.run();
+        BOOST_TEST(slept);
+        BOOST_TEST(done);
+    }
+
+    {
+        // A canceller that resumes another fiber inline, which adds a
+        // deadline of its own
+        boost::asio::io_context io;
+        boost::asio::steady_timer t{io, std::chrono::hours{1}};
+        parked_fiber parked;
+        bool resumed = false;
+        boost::system::error_code result;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            parked.park(yield);
+            boost::asio::post(
+              io, ufiber::with_timeout(yield, std::chrono::hours{1}, [] {}));
+            resumed = true;
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            result = t.async_wait(
+              ufiber::with_timeout(yield, std::chrono::milliseconds{1}, [&] {
+                  parked.resume();
+                  t.cancel();
+              }));
+        });
+        io.run();
+        BOOST_TEST(resumed);
+        BOOST_TEST(result == boost::asio::error::operation_aborted);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,199 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/fiber_local.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+std::atomic<int> live{0};
+
+struct counted
+{
+    counted()
+    {
+        ++live;
+    }
+
+    explicit counted(int v)
+      : value{v}
+    {
+        ++live;
+    }
+
+    counted(counted const&) = delete;
+
+    ~counted()
+    {
+        --live;
+    }
+
+    int value = 0;
+};
+
+} // namespace
+
+int
+main()
+{
+    BOOST_TEST(!ufiber::in_fiber());
+
+    {
+        // Each fiber has its own value, which survives suspension
+        boost::asio::io_context io;
+        ufiber::fiber_local<std::string> name;
+        std::vector<std::string> seen;
+        for (int i = 0; i < 3; ++i)
+        {
+            ufiber::spawn(io, [&, i](yield_token_t yield) {
+                BOOST_TEST(ufiber::in_fiber());
+                BOOST_TEST(!name.has_value());
+                BOOST_TEST(name.get().empty());
+                BOOST_TEST(name.has_value());
+                *name = "fiber " + std::to_string(i);
+                boost::asio::post(yield);
+                boost::asio::post(yield);
+                seen.push_back(*name);
+                name.reset();
+                BOOST_TEST(!name.has_value());
+            });
+        }
+        BOOST_TEST(!ufiber::in_fiber());
+        io.run();
+        BOOST_TEST(!ufiber::in_fiber());
+        BOOST_TEST((seen ==
+                    std::vector<std::string>{"fiber 0", "fiber 1", "fiber 2"}));
+    }
+
+    {
+        // Values follow their fiber across threads
+        boost::asio::io_context io{4};
+        ufiber::fiber_local<int> id;
+        std::atomic<int> mismatches{0};
+        for (int i = 0; i < 32; ++i)
+        {
+            ufiber::spawn(io, [&, i](yield_token_t yield) {
+                id.emplace(i);
+                for (int j = 0; j < 100; ++j)
+                {
+                    boost::asio::post(yield);
+                    if (*id != i)
+                    {
+                        ++mismatches;
+                    }
+                }
+            });
+        }
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i)
+        {
+            threads.emplace_back([&io] { io.run(); });
+        }
+        io.run();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(mismatches == 0);
+    }
+
+    {
+        // Values are destroyed when a fiber finishes, also when it is unwound
+        // by broken_promise
+        ufiber::fiber_local<counted> local;
+        {
+            boost::asio::io_context io;
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                local.emplace(1);
+                boost::asio::post(yield);
+            });
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                local.emplace(2);
+                boost::asio::post(yield);
+                boost::asio::post(yield);
+                boost::asio::post(yield);
+            });
+            io.run_one();
+            io.run_one();
+            io.run_one();
+            io.run_one();
+            BOOST_TEST(live == 1);
+        }
+        BOOST_TEST(live == 0);
+    }
+
+    {
+        // More fiber_locals than inline slots, and a nested fiber
+        boost::asio::io_context io;
+        std::vector<std::unique_ptr<ufiber::fiber_local<counted>>> locals;
+        for (int i = 0; i < UFIBER_FIBER_LOCAL_SLOTS * 2; ++i)
+        {
+            locals.emplace_back(new ufiber::fiber_local<counted>);
+        }
+        bool intact = true;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            for (std::size_t i = 0; i < locals.size(); ++i)
+            {
+                locals[i]->emplace(static_cast<int>(i));
+            }
+            ufiber::spawn(yield.get_executor(), [&](yield_token_t) {
+                for (auto& l : locals)
+                {
+                    intact = intact && !l->has_value();
+                }
+                (*locals.back())->value = -1;
+            });
+            boost::asio::post(yield);
+            for (std::size_t i = 0; i < locals.size(); ++i)
+            {
+                intact = intact && (*locals[i])->value == static_cast<int>(i);
+            }
+        });
+        io.run();
+        BOOST_TEST(intact);
+        BOOST_TEST(live == 0);
+    }
+
+    {
+        // Indices of destroyed fiber_locals are reused, and a value left
+        // behind by one isn't seen through the next
+        boost::asio::io_context io;
+        bool fresh = true;
+        int most_live = 0;
+        ufiber::spawn(io, [&](yield_token_t) {
+            for (int i = 0; i < 1000; ++i)
+            {
+                ufiber::fiber_local<counted> local;
+                fresh = fresh && !local.has_value();
+                local.emplace(i);
+                most_live = std::max(most_live, live.load());
+            }
+        });
+        io.run();
+        BOOST_TEST(fresh);
+        BOOST_TEST(most_live == 1);
+        BOOST_TEST(live == 0);
+    }
+
+    return boost::report_errors();
+}
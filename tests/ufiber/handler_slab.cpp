@@ -0,0 +1,154 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+// Allocates blocks of the given sizes with the handler's associated allocator
+// and frees them before invoking the handler, like Asio does with the state
+// of an operation.
+template<class CompletionToken>
+auto
+async_allocate(boost::asio::io_context& io,
+               std::vector<std::size_t> const& sizes,
+               std::vector<void*>& blocks,
+               CompletionToken&& token)
+  -> BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void())
+{
+    using handler_t = BOOST_ASIO_HANDLER_TYPE(CompletionToken, void());
+    using allocator_t = typename std::allocator_traits<
+      boost::asio::associated_allocator_t<handler_t>>::
+      template rebind_alloc<char>;
+
+    struct op
+    {
+        void operator()()
+        {
+            for (std::size_t i = 0; i < sizes_.size(); ++i)
+            {
+                alloc_.deallocate(static_cast<char*>(blocks_[i]), sizes_[i]);
+            }
+            handler_();
+        }
+
+        handler_t handler_;
+        allocator_t alloc_;
+        std::vector<std::size_t> sizes_;
+        std::vector<void*> blocks_;
+    };
+
+    return boost::asio::async_initiate<CompletionToken, void()>(
+      [&](handler_t&& handler) {
+          allocator_t alloc{boost::asio::get_associated_allocator(handler)};
+          blocks.clear();
+          for (auto const size : sizes)
+          {
+              blocks.push_back(alloc.allocate(size));
+          }
+          boost::asio::post(io, op{std::move(handler), alloc, sizes, blocks});
+      },
+      std::forward<CompletionToken>(token));
+}
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Consecutive operations of one fiber reuse the same block
+        boost::asio::io_context io;
+        bool done = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            std::vector<void*> first;
+            std::vector<void*> second;
+            async_allocate(io, {64}, first, yield);
+            async_allocate(io, {128}, second, yield);
+            BOOST_TEST(first[0] == second[0]);
+
+            // Oversized states and a second concurrent allocation fall back to
+            // the heap
+            std::vector<void*> large;
+            async_allocate(io, {UFIBER_HANDLER_SLAB_SIZE + 1}, large, yield);
+            BOOST_TEST(large[0] != first[0]);
+            std::vector<void*> two;
+            async_allocate(io, {32, 32}, two, yield);
+            BOOST_TEST(two[0] == first[0]);
+            BOOST_TEST(two[1] != first[0]);
+
+            async_allocate(io, {32}, second, yield);
+            BOOST_TEST(second[0] == first[0]);
+            done = true;
+        });
+        io.run();
+        BOOST_TEST(done);
+    }
+
+    {
+        // Different fibers have their own blocks
+        boost::asio::io_context io;
+        std::vector<void*> a;
+        std::vector<void*> b;
+        ufiber::spawn(
+          io, [&](yield_token_t yield) { async_allocate(io, {8}, a, yield); });
+        ufiber::spawn(
+          io, [&](yield_token_t yield) { async_allocate(io, {8}, b, yield); });
+        io.run();
+        BOOST_TEST(a.size() == 1 && b.size() == 1);
+        BOOST_TEST(a[0] != b[0]);
+    }
+
+    {
+        // Operation states allocated on one thread and freed on another
+        boost::asio::io_context io{4};
+        std::atomic<int> done{0};
+        for (int i = 0; i < 32; ++i)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                boost::asio::steady_timer t{io};
+                for (int j = 0; j < 200; ++j)
+                {
+                    boost::asio::post(yield);
+                    t.expires_after(std::chrono::microseconds{j % 3});
+                    t.async_wait(yield);
+                }
+                ++done;
+            });
+        }
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i)
+        {
+            threads.emplace_back([&io] { io.run(); });
+        }
+        io.run();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(done == 32);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/stats.hpp>
+#include <ufiber/ufiber.hpp>
+#include <ufiber/when.hpp>
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+// Invokes the handler with `value` on a new thread, which is joined before
+// returning if `wait` is set.
+template<class CompletionToken>
+auto
+async_from_thread(std::vector<std::thread>& threads,
+                  int value,
+                  bool wait,
+                  CompletionToken&& token)
+  -> BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(int))
+{
+    using handler_t = BOOST_ASIO_HANDLER_TYPE(CompletionToken, void(int));
+    return boost::asio::async_initiate<CompletionToken, void(int)>(
+      [&](handler_t&& handler) {
+          auto h = std::make_shared<handler_t>(std::move(handler));
+          threads.emplace_back([h, value] { (*h)(value); });
+          if (wait)
+          {
+              threads.back().join();
+              threads.pop_back();
+          }
+      },
+      std::forward<CompletionToken>(token));
+}
+
+template<class CompletionToken>
+auto
+async_throw(CompletionToken&& token)
+  -> BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void())
+{
+    using handler_t = BOOST_ASIO_HANDLER_TYPE(CompletionToken, void());
+    return boost::asio::async_initiate<CompletionToken, void()>(
+      [](handler_t&&) { throw std::runtime_error{"initiation failed"}; },
+      std::forward<CompletionToken>(token));
+}
+
+} // namespace
+
+int
+main()
+{
+    {
+        // A handler dispatched inline doesn't suspend the fiber
+        boost::asio::io_context io;
+        bool posted = false;
+        bool done = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::asio::post(io, [&] { posted = true; });
+            auto const before = ufiber::get_thread_stats();
+            for (int i = 0; i < 10; ++i)
+            {
+                boost::asio::dispatch(yield);
+            }
+            ufiber::when_all(
+              yield,
+              [&](ufiber::leg_token token) {
+                  return boost::asio::dispatch(io, token);
+              },
+              [&](ufiber::leg_token token) {
+                  return boost::asio::dispatch(io, token);
+              });
+            auto const after = ufiber::get_thread_stats();
+            BOOST_TEST(!posted);
+            BOOST_TEST(after.suspends == before.suspends);
+            if (ufiber::stats_enabled())
+            {
+                BOOST_TEST(after.inline_completions -
+                             before.inline_completions ==
+                           11);
+            }
+            done = true;
+        });
+        io.run();
+        BOOST_TEST(posted);
+        BOOST_TEST(done);
+    }
+
+    {
+        // A handler invoked by another thread during the initiation
+        boost::asio::io_context io;
+        std::vector<std::thread> threads;
+        int sum = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            for (int i = 0; i < 100; ++i)
+            {
+                sum += async_from_thread(threads, i, true, yield);
+            }
+        });
+        io.run();
+        BOOST_TEST(sum == 4950);
+        BOOST_TEST(threads.empty());
+    }
+
+    {
+        // A handler invoked by another thread at any point of the suspension
+        boost::asio::io_context io;
+        std::vector<std::thread> threads;
+        int sum = 0;
+        // The fiber is resumed on the other threads
+        auto work = boost::asio::make_work_guard(io);
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            for (int i = 0; i < 1000; ++i)
+            {
+                sum += async_from_thread(threads, i, false, yield);
+            }
+            work.reset();
+        });
+        io.run();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(sum == 499500);
+    }
+
+    {
+        // An exception thrown by the initiation reaches the fiber, which can
+        // carry on suspending
+        boost::asio::io_context io;
+        bool caught = false;
+        bool done = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            try
+            {
+                async_throw(yield);
+            }
+            catch (std::runtime_error const&)
+            {
+                caught = true;
+            }
+            boost::asio::post(yield);
+            done = true;
+        });
+        io.run();
+        BOOST_TEST(caught);
+        BOOST_TEST(done);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,252 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/join_handle.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/context/fixedsize_stack.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+std::atomic<int> stacks{0};
+
+// Counts the stacks that haven't been returned
+struct counting_stack
+{
+    boost::context::stack_context allocate()
+    {
+        ++stacks;
+        return boost::context::fixedsize_stack{}.allocate();
+    }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept
+    {
+        --stacks;
+        boost::context::fixedsize_stack{}.deallocate(sctx);
+    }
+};
+
+// A main function whose copy throws
+struct throwing_copy
+{
+    throwing_copy() = default;
+
+    throwing_copy(throwing_copy const&)
+    {
+        throw std::runtime_error{"copy"};
+    }
+
+    int operator()(yield_token_t)
+    {
+        return 0;
+    }
+};
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Joining a fiber that is still running, and one that has finished
+        boost::asio::io_context io;
+        int slow = 0;
+        int fast = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            auto h1 = ufiber::spawn_joinable(
+              std::allocator_arg,
+              counting_stack{},
+              yield.get_executor(),
+              [](yield_token_t yield) {
+                  boost::asio::post(yield);
+                  boost::asio::post(yield);
+                  return 42;
+              });
+            auto h2 = ufiber::spawn_joinable(
+              std::allocator_arg,
+              counting_stack{},
+              yield.get_executor(),
+              [](yield_token_t) { return 7; });
+            BOOST_TEST(h1.joinable());
+            BOOST_TEST(!h1.done());
+            slow = h1.async_join(yield);
+            BOOST_TEST(!h1.joinable());
+            BOOST_TEST(h2.done());
+            fast = h2.async_join(yield);
+        });
+        io.run();
+        BOOST_TEST(slow == 42);
+        BOOST_TEST(fast == 7);
+        BOOST_TEST(stacks == 0);
+    }
+
+    {
+        // void and move-only results, and exceptions
+        boost::asio::io_context io;
+        bool ran = false;
+        std::unique_ptr<int> p;
+        bool caught = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            auto v = ufiber::spawn_joinable(io, [&](yield_token_t yield) {
+                boost::asio::post(yield);
+                ran = true;
+            });
+            auto u = ufiber::spawn_joinable(io, [](yield_token_t yield) {
+                boost::asio::post(yield);
+                return std::unique_ptr<int>{new int{5}};
+            });
+            auto e = ufiber::spawn_joinable(io, [](yield_token_t yield) {
+                boost::asio::post(yield);
+                throw std::runtime_error{"child"};
+            });
+            v.async_join(yield);
+            p = u.async_join(yield);
+            try
+            {
+                e.async_join(yield);
+            }
+            catch (std::runtime_error const& ex)
+            {
+                caught = ex.what() == std::string{"child"};
+            }
+        });
+        io.run();
+        BOOST_TEST(ran);
+        BOOST_TEST(p && *p == 5);
+        BOOST_TEST(caught);
+    }
+
+    {
+        // A detached fiber runs to completion and returns its stack
+        boost::asio::io_context io;
+        bool finished = false;
+        {
+            auto h = ufiber::spawn_joinable(
+              std::allocator_arg,
+              counting_stack{},
+              io.get_executor(),
+              [&](yield_token_t yield) {
+                  boost::asio::post(yield);
+                  finished = true;
+              });
+        }
+        BOOST_TEST(stacks == 1);
+        io.run();
+        BOOST_TEST(finished);
+        BOOST_TEST(stacks == 0);
+    }
+
+    {
+        // Children joined across threads
+        boost::asio::io_context io{4};
+        std::atomic<int> total{0};
+        for (int i = 0; i < 8; ++i)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                std::vector<ufiber::join_handle<int>> children;
+                for (int j = 0; j < 16; ++j)
+                {
+                    children.push_back(ufiber::spawn_joinable(
+                      std::allocator_arg,
+                      counting_stack{},
+                      yield.get_executor(),
+                      [j](yield_token_t yield) {
+                          for (int k = 0; k < j; ++k)
+                          {
+                              boost::asio::post(yield);
+                          }
+                          return j;
+                      }));
+                }
+                int sum = 0;
+                for (auto& c : children)
+                {
+                    sum += c.async_join(yield);
+                }
+                total += sum;
+            });
+        }
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i)
+        {
+            threads.emplace_back([&io] { io.run(); });
+        }
+        io.run();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(total == 8 * (15 * 16 / 2));
+        BOOST_TEST(stacks == 0);
+    }
+
+    {
+        // Abandoned parent and child both unwind and the stack is returned
+        bool parent_unwound = false;
+        {
+            boost::asio::io_context io;
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                auto h = ufiber::spawn_joinable(
+                  std::allocator_arg,
+                  counting_stack{},
+                  yield.get_executor(),
+                  [](yield_token_t yield) {
+                      boost::asio::post(yield);
+                      boost::asio::post(yield);
+                      return 1;
+                  });
+                try
+                {
+                    h.async_join(yield);
+                }
+                catch (ufiber::broken_promise const&)
+                {
+                    parent_unwound = true;
+                    throw;
+                }
+            });
+            io.run_one();
+            io.run_one();
+        }
+        BOOST_TEST(parent_unwound);
+        BOOST_TEST(stacks == 0);
+    }
+
+    {
+        // The stack is returned if the fiber can't be created
+        boost::asio::io_context io;
+        throwing_copy f;
+        bool thrown = false;
+        try
+        {
+            ufiber::spawn_joinable(
+              std::allocator_arg, counting_stack{}, io.get_executor(), f);
+        }
+        catch (std::runtime_error const&)
+        {
+            thrown = true;
+        }
+        BOOST_TEST(thrown);
+        BOOST_TEST(stacks == 0);
+    }
+
+    return boost::report_errors();
+}
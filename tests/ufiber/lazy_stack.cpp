@@ -0,0 +1,170 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/lazy_stack.hpp>
+#include <ufiber/stack_pool.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/context/stack_traits.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <cstring>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace
+{
+
+// Touches roughly `depth` KiB of stack.
+int
+dig(int depth)
+{
+    volatile char buffer[1024];
+    std::memset(const_cast<char*>(buffer), depth, sizeof(buffer));
+    if (depth == 0)
+    {
+        return buffer[0];
+    }
+    return dig(depth - 1) + buffer[1];
+}
+
+std::size_t
+resident_pages(boost::context::stack_context const& sctx)
+{
+    auto const page = boost::context::stack_traits::page_size();
+    auto const pages = sctx.size / page;
+    std::vector<unsigned char> vec(pages);
+    char* bottom = static_cast<char*>(sctx.sp) - sctx.size;
+    if (::mincore(bottom, sctx.size, vec.data()) != 0)
+    {
+        return 0;
+    }
+    std::size_t n = 0;
+    for (auto v : vec)
+    {
+        n += v & 1;
+    }
+    return n;
+}
+
+// Remembers the last stack it allocated so that the test can inspect it.
+struct inspecting_stack
+{
+    boost::context::stack_context allocate()
+    {
+        *last_ = sa_.allocate();
+        return *last_;
+    }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept
+    {
+        sa_.deallocate(sctx);
+    }
+
+    ufiber::detail::reclaim_list* reclaimer() const noexcept
+    {
+        return sa_.reclaimer();
+    }
+
+    ufiber::lazy_stack sa_;
+    boost::context::stack_context* last_;
+};
+
+} // namespace
+
+int
+main()
+{
+    using yield_token_t =
+      ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+    {
+        // Memory is committed only for the pages that are actually used
+        ufiber::lazy_stack sa{64 * 1024 * 1024};
+        auto sctx = sa.allocate();
+        BOOST_TEST(sctx.size > 64 * 1024 * 1024);
+        BOOST_TEST(resident_pages(sctx) == 0);
+        sa.deallocate(sctx);
+    }
+
+    {
+        // The stack of a suspended fiber is trimmed below its stack pointer,
+        // and the fiber's own frames are preserved.
+        ufiber::stack_reclaimer reclaimer{std::chrono::seconds{0}};
+        boost::context::stack_context sctx;
+        boost::asio::io_context io{};
+        int result = 0;
+        ufiber::spawn(
+          std::allocator_arg,
+          inspecting_stack{ufiber::lazy_stack{1024 * 1024, &reclaimer}, &sctx},
+          io.get_executor(),
+          [&](yield_token_t yield) {
+              int value = 42;
+              dig(256);
+              boost::asio::post(yield);
+              result = value;
+          });
+
+        BOOST_TEST(io.run_one() == 1);
+        auto const before = resident_pages(sctx);
+        BOOST_TEST(before > 64);
+        BOOST_TEST(reclaimer.reclaim() > 256 * 1024);
+        BOOST_TEST(resident_pages(sctx) < before / 4);
+        // Already trimmed, nothing more to release until the fiber parks again
+        BOOST_TEST(reclaimer.reclaim() == 0);
+
+        io.run();
+        BOOST_TEST(result == 42);
+    }
+
+    {
+        // Fibers suspended for less than the threshold are left alone
+        ufiber::stack_reclaimer reclaimer{std::chrono::hours{1},
+                                          ufiber::stack_reclaimer::advice::free};
+        boost::asio::io_context io{};
+        int count = 0;
+        ufiber::spawn(std::allocator_arg,
+                      ufiber::lazy_stack{1024 * 1024, &reclaimer},
+                      io.get_executor(),
+                      [&](yield_token_t yield) {
+                          dig(128);
+                          boost::asio::post(yield);
+                          ++count;
+                      });
+        BOOST_TEST(io.run_one() == 1);
+        BOOST_TEST(reclaimer.reclaim() == 0);
+        io.run();
+        BOOST_TEST(count == 1);
+    }
+
+    {
+        // Pooled lazy stacks stay enrolled in the reclaimer
+        ufiber::stack_reclaimer reclaimer{std::chrono::seconds{0}};
+        ufiber::basic_stack_pool<ufiber::lazy_stack> pool{
+          ufiber::lazy_stack{1024 * 1024, &reclaimer}};
+        boost::asio::io_context io{};
+        int count = 0;
+        ufiber::spawn(std::allocator_arg,
+                      pool.get_allocator(),
+                      io.get_executor(),
+                      [&](yield_token_t yield) {
+                          dig(128);
+                          boost::asio::post(yield);
+                          ++count;
+                      });
+        BOOST_TEST(io.run_one() == 1);
+        BOOST_TEST(reclaimer.reclaim() > 0);
+        io.run();
+        BOOST_TEST(count == 1);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,89 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_ENABLE_REGISTRY
+#define UFIBER_ENABLE_REGISTRY
+#endif // UFIBER_ENABLE_REGISTRY
+
+#include <ufiber/registry.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <sstream>
+
+int
+main()
+{
+    using yield_token_t =
+      ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+    BOOST_TEST(ufiber::registry_enabled());
+    BOOST_TEST(ufiber::live_fibers().empty());
+
+    {
+        boost::asio::io_context io{};
+        boost::asio::steady_timer timer{io, std::chrono::hours{1}};
+        std::vector<ufiber::fiber_info> seen_running;
+
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::set_fiber_name(yield, "sleeper");
+            boost::system::error_code ec = timer.async_wait(yield);
+            BOOST_TEST(ec == boost::asio::error::operation_aborted);
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::asio::post(yield);
+            seen_running = ufiber::live_fibers();
+            timer.cancel();
+        });
+
+        auto fibers = ufiber::live_fibers();
+        BOOST_TEST(fibers.size() == 2);
+        for (auto const& f : fibers)
+        {
+            // Both fibers wait in their initial post
+            BOOST_TEST(f.state == ufiber::fiber_state::suspended);
+            BOOST_TEST(f.executor.find("io_context") != std::string::npos);
+            BOOST_TEST(!f.signature.empty());
+        }
+
+        BOOST_TEST(io.run_one() == 1);
+        fibers = ufiber::live_fibers();
+        BOOST_TEST(fibers.size() == 2);
+        auto const& sleeper = fibers[0].name == "sleeper" ? fibers[0]
+                                                          : fibers[1];
+        BOOST_TEST(sleeper.name == "sleeper");
+        BOOST_TEST(sleeper.state == ufiber::fiber_state::suspended);
+        BOOST_TEST(sleeper.signature.find("error_code") != std::string::npos);
+        BOOST_TEST(sleeper.operation.find("wait") != std::string::npos);
+
+        std::ostringstream os;
+        ufiber::dump_fibers(os);
+        auto const dump = os.str();
+        BOOST_TEST(dump.find("\"sleeper\" suspended") != std::string::npos);
+        BOOST_TEST(dump.find("waiting on: void (boost::system::error_code)") !=
+                   std::string::npos);
+
+        io.run();
+        // A fiber that takes a snapshot sees itself as running
+        BOOST_TEST(seen_running.size() == 2);
+        bool found_running = false;
+        for (auto const& f : seen_running)
+        {
+            found_running |= f.state == ufiber::fiber_state::running;
+        }
+        BOOST_TEST(found_running);
+    }
+
+    BOOST_TEST(ufiber::live_fibers().empty());
+
+    return boost::report_errors();
+}
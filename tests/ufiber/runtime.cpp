@@ -0,0 +1,250 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/runtime.hpp>
+
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t = ufiber::yield_token<ufiber::runtime::executor_type>;
+
+struct echo_session
+{
+    void operator()(ufiber::runtime::socket_type socket, yield_token_t& yield)
+    {
+        shards_[rt_.current_shard()]++;
+        char buf[5];
+        boost::system::error_code ec;
+        std::size_t n;
+        std::tie(ec, n) =
+          boost::asio::async_read(socket, boost::asio::buffer(buf), yield);
+        if (!ec)
+        {
+            boost::asio::async_write(socket, boost::asio::buffer(buf), yield);
+        }
+    }
+
+    ufiber::runtime& rt_;
+    std::atomic<int>* shards_;
+};
+
+using clock_type = std::chrono::steady_clock;
+
+struct scripted_socket
+{
+    using executor_type = boost::asio::io_context::executor_type;
+
+    explicit scripted_socket(executor_type ex)
+      : ex_{ex}
+    {
+    }
+
+    executor_type get_executor()
+    {
+        return ex_;
+    }
+
+    executor_type ex_;
+};
+
+// Fails accepts with a scripted sequence of errors, then reports that it has
+// been closed
+struct scripted_acceptor
+{
+    using executor_type = boost::asio::io_context::executor_type;
+
+    executor_type get_executor()
+    {
+        return ex_;
+    }
+
+    template<class Executor>
+    boost::system::error_code async_accept(
+      scripted_socket&,
+      ufiber::yield_token<Executor>& yield)
+    {
+        calls_->push_back(clock_type::now());
+        boost::asio::post(yield);
+        if (calls_->size() > errors_.size())
+        {
+            return boost::asio::error::operation_aborted;
+        }
+        return errors_[calls_->size() - 1];
+    }
+
+    executor_type ex_;
+    std::vector<boost::system::error_code> errors_;
+    std::vector<clock_type::time_point>* calls_;
+};
+
+struct count_session
+{
+    template<class Executor>
+    void operator()(scripted_socket, ufiber::yield_token<Executor>&)
+    {
+        ++*accepted_;
+    }
+
+    int* accepted_;
+};
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Fibers stay on the thread of their shard
+        ufiber::runtime rt{2, false};
+        BOOST_TEST(rt.size() == 2);
+        BOOST_TEST(rt.current_shard() == 2);
+        std::atomic<int> done{0};
+        std::atomic<int> misplaced{0};
+        std::thread::id threads[2];
+        for (std::size_t i = 0; i < 2; ++i)
+        {
+            rt.spawn_on(i, [&, i](yield_token_t yield) {
+                threads[i] = std::this_thread::get_id();
+                for (int j = 0; j < 10; ++j)
+                {
+                    boost::asio::post(yield);
+                    if (rt.current_shard() != i ||
+                        threads[i] != std::this_thread::get_id())
+                    {
+                        ++misplaced;
+                    }
+                }
+                if (++done == 2)
+                {
+                    rt.stop();
+                }
+            });
+        }
+        rt.run();
+        BOOST_TEST(done == 2);
+        BOOST_TEST(misplaced == 0);
+        BOOST_TEST(threads[0] != threads[1]);
+        BOOST_TEST(threads[0] == std::this_thread::get_id());
+    }
+
+    {
+        // Calls and messages between shards
+        ufiber::runtime rt{2};
+        int remote_shard = -1;
+        int posted_shard = -1;
+        bool resumed_home = false;
+        rt.spawn_on(0, [&](yield_token_t yield) {
+            remote_shard = rt.call_on(
+              1, [&] { return static_cast<int>(rt.current_shard()); }, yield);
+            rt.call_on(
+              1,
+              [&] {
+                  rt.post(0, [&] {
+                      posted_shard = static_cast<int>(rt.current_shard());
+                  });
+              },
+              yield);
+            resumed_home = rt.current_shard() == 0;
+            // Runs after the message posted above
+            boost::asio::post(yield);
+            rt.stop();
+        });
+        rt.run();
+        BOOST_TEST(remote_shard == 1);
+        BOOST_TEST(posted_shard == 0);
+        BOOST_TEST(resumed_home);
+    }
+
+    {
+        // Every shard accepts connections on the same port
+        ufiber::runtime rt{2};
+        std::atomic<int> shards[2] = {{0}, {0}};
+        auto const endpoint = rt.listen(
+          {boost::asio::ip::address_v4::loopback(), 0},
+          echo_session{rt, shards});
+        BOOST_TEST(endpoint.port() != 0);
+
+        int const clients = 16;
+        std::atomic<int> echoed{0};
+        std::atomic<int> finished{0};
+        for (int i = 0; i < clients; ++i)
+        {
+            rt.spawn_on(i % 2, [&](yield_token_t yield) {
+                ufiber::runtime::socket_type s{yield.get_executor()};
+                s.async_connect(endpoint, yield);
+                boost::asio::async_write(
+                  s, boost::asio::buffer("hello", 5), yield);
+                char buf[5];
+                boost::system::error_code ec;
+                std::size_t n;
+                std::tie(ec, n) =
+                  boost::asio::async_read(s, boost::asio::buffer(buf), yield);
+                if (!ec && std::string(buf, n) == "hello")
+                {
+                    ++echoed;
+                }
+                if (++finished == clients)
+                {
+                    rt.stop();
+                }
+            });
+        }
+        rt.run();
+        BOOST_TEST(echoed == clients);
+        BOOST_TEST(shards[0] + shards[1] == clients);
+    }
+
+    {
+        // Failed accepts are retried, backed off or end the acceptor
+        // depending on the error
+        boost::asio::io_context io;
+        std::vector<clock_type::time_point> calls;
+        int accepted = 0;
+        using loop = ufiber::detail::accept_loop<scripted_acceptor,
+                                                 scripted_socket,
+                                                 boost::context::fixedsize_stack,
+                                                 count_session>;
+        scripted_acceptor acceptor{
+          io.get_executor(),
+          {boost::asio::error::connection_aborted,
+           boost::system::errc::make_error_code(
+             boost::system::errc::protocol_error),
+           boost::asio::error::no_descriptors,
+           boost::asio::error::no_buffer_space,
+           {},
+           boost::asio::error::bad_descriptor,
+           {}},
+          &calls};
+        ufiber::spawn(
+          io,
+          loop{acceptor, boost::context::fixedsize_stack{}, {&accepted}});
+        io.run();
+        BOOST_TEST(calls.size() == 6);
+        BOOST_TEST(accepted == 1);
+        auto const backoff =
+          std::chrono::milliseconds{UFIBER_ACCEPT_BACKOFF_MS};
+        if (calls.size() == 6)
+        {
+            BOOST_TEST(calls[3] - calls[2] >= backoff);
+            BOOST_TEST(calls[4] - calls[3] >= backoff);
+        }
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,229 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/channel.hpp>
+#include <ufiber/scheduler.hpp>
+#include <ufiber/sync.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace
+{
+
+using executor_t = ufiber::scheduler::executor_type;
+using yield_token_t = ufiber::yield_token<executor_t>;
+
+static_assert(boost::asio::is_executor<executor_t>::value,
+              "scheduler::executor_type must be an Executor");
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Fibers spread over all threads
+        boost::asio::io_context reactor;
+        ufiber::scheduler sched{reactor, 4};
+        std::mutex m;
+        std::set<std::thread::id> threads;
+        std::atomic<int> done{0};
+        for (int i = 0; i < 64; ++i)
+        {
+            ufiber::spawn(sched, [&](yield_token_t yield) {
+                for (int j = 0; j < 10; ++j)
+                {
+                    BOOST_TEST(yield.get_executor().running_in_this_thread());
+                    {
+                        std::lock_guard<std::mutex> lock{m};
+                        threads.insert(std::this_thread::get_id());
+                    }
+                    // Blocks this thread, so that the others steal its work
+                    std::this_thread::sleep_for(std::chrono::microseconds{100});
+                    boost::asio::post(yield);
+                }
+                ++done;
+            });
+        }
+        BOOST_TEST(sched.run() > 0);
+        BOOST_TEST(done == 64);
+        BOOST_TEST(threads.size() > 1);
+        BOOST_TEST(threads.size() <= 4);
+        BOOST_TEST(sched.stopped());
+    }
+
+    {
+        // Fibers on different threads contend on a mutex and a channel
+        boost::asio::io_context reactor;
+        ufiber::scheduler sched{reactor, 4};
+        ufiber::mutex m;
+        ufiber::channel<int> ch{8};
+        int counter = 0;
+        int sum = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            ufiber::spawn(sched, [&](yield_token_t yield) {
+                for (int j = 0; j < 100; ++j)
+                {
+                    m.lock(yield);
+                    ++counter;
+                    m.unlock();
+                    BOOST_TEST(!ch.send(j, yield));
+                }
+            });
+        }
+        ufiber::spawn(sched, [&](yield_token_t yield) {
+            for (int i = 0; i < 800; ++i)
+            {
+                boost::system::error_code ec;
+                int v;
+                std::tie(ec, v) = ch.receive(yield);
+                BOOST_TEST(!ec);
+                sum += v;
+            }
+        });
+        sched.run();
+        BOOST_TEST(counter == 800);
+        BOOST_TEST(sum == 8 * 4950);
+    }
+
+    {
+        // Timers and sockets are serviced by the reactor
+        boost::asio::io_context reactor;
+        ufiber::scheduler sched{reactor, 2};
+        int timers = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            ufiber::spawn(sched, [&](yield_token_t yield) {
+                boost::asio::steady_timer t{reactor};
+                t.expires_after(std::chrono::milliseconds{10});
+                t.async_wait(yield);
+                BOOST_TEST(yield.get_executor().running_in_this_thread());
+                ++timers;
+            });
+        }
+
+        using boost::asio::ip::tcp;
+        tcp::acceptor acceptor{
+          reactor, tcp::endpoint{boost::asio::ip::address_v4::loopback(), 0}};
+        auto const endpoint = acceptor.local_endpoint();
+        std::string echoed;
+        ufiber::spawn(sched, [&](yield_token_t yield) {
+            tcp::socket s{reactor};
+            acceptor.async_accept(s, yield);
+            char buf[5];
+            boost::asio::async_read(s, boost::asio::buffer(buf), yield);
+            boost::asio::async_write(s, boost::asio::buffer(buf), yield);
+        });
+        ufiber::spawn(sched, [&](yield_token_t yield) {
+            tcp::socket s{reactor};
+            s.async_connect(endpoint, yield);
+            boost::asio::async_write(s, boost::asio::buffer("hello", 5), yield);
+            char buf[5];
+            boost::asio::async_read(s, boost::asio::buffer(buf), yield);
+            echoed.assign(buf, sizeof(buf));
+        });
+        sched.run();
+        BOOST_TEST(timers == 16);
+        BOOST_TEST(echoed == "hello");
+    }
+
+    {
+        // A stopped scheduler keeps its work until it is restarted
+        boost::asio::io_context reactor;
+        ufiber::scheduler sched{reactor, 2};
+        int steps = 0;
+        ufiber::spawn(sched, [&](yield_token_t yield) {
+            ++steps;
+            sched.stop();
+            boost::asio::post(yield);
+            ++steps;
+        });
+        sched.run();
+        BOOST_TEST(steps == 1);
+        BOOST_TEST(sched.run() == 0);
+        sched.restart();
+        sched.run();
+        BOOST_TEST(steps == 2);
+    }
+
+    {
+        // Abandoned fibers are cleaned up when the scheduler is destroyed
+        boost::asio::io_context reactor;
+        int unwound = 0;
+        {
+            ufiber::scheduler sched{reactor, 1};
+            ufiber::spawn(sched, [&](yield_token_t yield) {
+                struct on_exit
+                {
+                    ~on_exit()
+                    {
+                        ++n_;
+                    }
+                    int& n_;
+                } guard{unwound};
+                sched.stop();
+                boost::asio::post(yield);
+            });
+            sched.run();
+            BOOST_TEST(unwound == 0);
+        }
+        BOOST_TEST(unwound == 1);
+    }
+
+    {
+        // A wakeup left in the reactor by stop() doesn't outlive the scheduler
+        boost::asio::io_context reactor;
+        {
+            ufiber::scheduler sched{reactor, 1};
+            auto work = boost::asio::make_work_guard(sched.get_executor());
+            boost::asio::steady_timer t{reactor};
+            t.expires_after(std::chrono::milliseconds{1});
+            // Finishes the last work item from within the reactor, while the
+            // worker is waiting in it
+            t.async_wait([&](boost::system::error_code) { work.reset(); });
+            sched.run();
+        }
+        BOOST_TEST(reactor.poll() == 0);
+    }
+
+    {
+        // dispatch() runs inline on the scheduler's threads only
+        boost::asio::io_context reactor;
+        ufiber::scheduler sched{reactor, 1};
+        auto const ex = sched.get_executor();
+        BOOST_TEST(!ex.running_in_this_thread());
+        BOOST_TEST(&ex.context() == &sched);
+        BOOST_TEST(ex == sched.get_executor());
+        bool inline_run = false;
+        boost::asio::post(ex, [&] {
+            bool ran = false;
+            boost::asio::dispatch(ex, [&] { ran = true; });
+            inline_run = ran;
+        });
+        BOOST_TEST(sched.run() == 1);
+        BOOST_TEST(inline_run);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,248 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/deadline.hpp>
+#include <ufiber/scheduler.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/core/lightweight_test.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+using clock_type = std::chrono::steady_clock;
+using ufiber::detail::deadline_entry;
+using ufiber::detail::timer_wheel;
+
+struct wheel_entry : deadline_entry
+{
+    wheel_entry() noexcept
+      : deadline_entry{clock_type::time_point{}, nullptr}
+    {
+    }
+
+    timer_wheel::tick_type due_ = 0;
+    bool expired_ = false;
+};
+
+} // namespace
+
+int
+main()
+{
+    {
+        // A sleep keeps the io_context running and never ends early
+        boost::asio::io_context io;
+        clock_type::duration slept{};
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            auto const start = clock_type::now();
+            ufiber::sleep_for(yield, std::chrono::milliseconds{20});
+            slept = clock_type::now() - start;
+        });
+        io.run();
+        BOOST_TEST(slept >= std::chrono::milliseconds{20});
+        BOOST_TEST(slept < std::chrono::seconds{10});
+    }
+
+    {
+        // Fibers wake up in the order of their deadlines, and fibers with the
+        // same deadline in the order they went to sleep
+        boost::asio::io_context io;
+        std::vector<int> order;
+        auto const now = clock_type::now();
+        int const delays[] = {30, 10, 20, 10, 10};
+        for (int i = 0; i < 5; ++i)
+        {
+            auto const at = now + std::chrono::milliseconds{delays[i]};
+            ufiber::spawn(io, [&order, at, i](yield_token_t yield) {
+                ufiber::sleep_until(yield, at);
+                order.push_back(i);
+            });
+        }
+        io.run();
+        BOOST_TEST((order == std::vector<int>{1, 3, 4, 2, 0}));
+    }
+
+    {
+        // A deadline in the past still suspends the fiber until the next tick
+        boost::asio::io_context io;
+        int woken = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::sleep_until(yield,
+                                clock_type::now() - std::chrono::hours{1});
+            ++woken;
+            ufiber::sleep_for(yield, std::chrono::milliseconds{0});
+            ++woken;
+        });
+        io.run();
+        BOOST_TEST(woken == 2);
+    }
+
+    {
+        // Sleeps and deadlines share the wheel
+        boost::asio::io_context io;
+        std::atomic<int> done{0};
+        boost::asio::steady_timer t{io, std::chrono::hours{1}};
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            auto const ec = t.async_wait(ufiber::with_timeout(
+              yield, std::chrono::milliseconds{15}, [&t] { t.cancel(); }));
+            BOOST_TEST(ec == boost::asio::error::operation_aborted);
+            ++done;
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::sleep_for(yield, std::chrono::milliseconds{5});
+            BOOST_TEST(done == 0);
+            ++done;
+        });
+        io.run();
+        BOOST_TEST(done == 2);
+    }
+
+    {
+        // Sleeping fibers on a multi-threaded io_context
+        boost::asio::io_context io{4};
+        std::atomic<int> woken{0};
+        for (int i = 0; i < 64; ++i)
+        {
+            ufiber::spawn(io, [&, i](yield_token_t yield) {
+                for (int j = 0; j < 3; ++j)
+                {
+                    ufiber::sleep_for(yield, std::chrono::milliseconds{i % 7});
+                }
+                ++woken;
+            });
+        }
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i)
+        {
+            threads.emplace_back([&io] { io.run(); });
+        }
+        io.run();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(woken == 64);
+    }
+
+    {
+        // Fibers on a scheduler sleep on the wheel of its reactor
+        boost::asio::io_context reactor;
+        ufiber::scheduler sched{reactor, 2};
+        std::atomic<int> woken{0};
+        for (int i = 0; i < 8; ++i)
+        {
+            ufiber::spawn(
+              sched,
+              [&](ufiber::yield_token<ufiber::scheduler::executor_type> yield) {
+                  ufiber::sleep_for(yield, std::chrono::milliseconds{5});
+                  ++woken;
+              });
+        }
+        sched.run();
+        BOOST_TEST(woken == 8);
+    }
+
+    {
+        // Sleeping fibers are unwound when the io_context is destroyed
+        int unwound = 0;
+        {
+            boost::asio::io_context io;
+            for (int i = 0; i < 3; ++i)
+            {
+                ufiber::spawn(io, [&](yield_token_t yield) {
+                    BOOST_TRY
+                    {
+                        ufiber::sleep_for(yield, std::chrono::hours{1});
+                    }
+                    BOOST_CATCH(ufiber::broken_promise const&)
+                    {
+                        ++unwound;
+                        BOOST_RETHROW
+                    }
+                    BOOST_CATCH_END
+                });
+            }
+            io.poll();
+        }
+        BOOST_TEST(unwound == 3);
+    }
+
+    {
+        // Entries expire exactly at their tick, also after cascading from the
+        // higher levels, or after waiting beyond the range of the wheel. Half
+        // of the entries are inserted while the wheel advances.
+        std::mt19937_64 rng{42};
+        timer_wheel wheel;
+        std::vector<wheel_entry> entries(4000);
+        auto const range = timer_wheel::tick_type{1} << 26;
+        for (std::size_t i = 0; i < 2000; ++i)
+        {
+            entries[i].due_ = 1 + rng() % range;
+            wheel.insert(&entries[i], entries[i].due_);
+        }
+        // Some entries are removed before they expire
+        for (std::size_t i = 0; i < 2000; i += 5)
+        {
+            wheel.erase(&entries[i]);
+        }
+        std::size_t added = 2000;
+        bool early = false;
+        bool late = false;
+        while (!wheel.empty())
+        {
+            auto const next = wheel.next_tick();
+            if (next <= wheel.now())
+            {
+                late = true;
+                break;
+            }
+            // Advancing to a tick before the next event is a no-op
+            auto const before = wheel.now() + rng() % (next - wheel.now());
+            if (wheel.advance(before) != nullptr)
+            {
+                early = true;
+            }
+            if (added < entries.size())
+            {
+                auto& e = entries[added++];
+                e.due_ = wheel.now() + 1 + rng() % range;
+                wheel.insert(&e, e.due_);
+                continue;
+            }
+            for (auto e = wheel.advance(next); e != nullptr; e = e->next_)
+            {
+                auto const w = static_cast<wheel_entry*>(e);
+                early = early || w->due_ > wheel.now();
+                late = late || w->due_ < wheel.now();
+                w->expired_ = true;
+            }
+        }
+        BOOST_TEST(!early);
+        BOOST_TEST(!late);
+        for (std::size_t i = 0; i < entries.size(); ++i)
+        {
+            BOOST_TEST(entries[i].expired_ == (i >= 2000 || i % 5 != 0));
+        }
+    }
+
+    return boost::report_errors();
+}
@@ -10,11 +10,53 @@
 #include <ufiber/ufiber.hpp>
 
 #include <boost/asio/io_context.hpp>
+#include <boost/context/fixedsize_stack.hpp>
 #include <boost/core/lightweight_test.hpp>
 #include <boost/make_unique.hpp>
 
+#include <stdexcept>
+
 #include "common.hpp"
 
+namespace
+{
+
+int stacks = 0;
+
+// Counts the stacks that haven't been returned
+struct counting_stack
+{
+    boost::context::stack_context allocate()
+    {
+        ++stacks;
+        return boost::context::fixedsize_stack{}.allocate();
+    }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept
+    {
+        --stacks;
+        boost::context::fixedsize_stack{}.deallocate(sctx);
+    }
+};
+
+// A main function whose copy throws
+struct throwing_copy
+{
+    throwing_copy() = default;
+
+    throwing_copy(throwing_copy const&)
+    {
+        throw std::runtime_error{"copy"};
+    }
+
+    template<class Executor>
+    void operator()(ufiber::yield_token<Executor>)
+    {
+    }
+};
+
+} // namespace
+
 int
 main()
 {
@@ -97,5 +139,23 @@ main()
     }
     BOOST_TEST(count == 2);
 
+    {
+        // The stack is returned if the fiber can't be created
+        boost::asio::io_context io{};
+        throwing_copy t;
+        bool thrown = false;
+        try
+        {
+            ufiber::spawn(
+              std::allocator_arg, counting_stack{}, io.get_executor(), t);
+        }
+        catch (std::runtime_error const&)
+        {
+            thrown = true;
+        }
+        BOOST_TEST(thrown);
+        BOOST_TEST(stacks == 0);
+    }
+
     return boost::report_errors();
 }
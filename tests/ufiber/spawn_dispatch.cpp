@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/stack_pool.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/core/lightweight_test.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <string>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Outside of the executor the fiber is posted, like with spawn()
+        boost::asio::io_context io;
+        bool started = false;
+        ufiber::spawn_dispatch(io, [&](yield_token_t) { started = true; });
+        BOOST_TEST(!started);
+        io.run();
+        BOOST_TEST(started);
+    }
+
+    {
+        // Inside of the executor the child runs until it first suspends,
+        // before spawn_dispatch() returns
+        boost::asio::io_context io;
+        std::string trace;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            trace += 'a';
+            ufiber::spawn_dispatch(yield.get_executor(),
+                                   [&](yield_token_t yield) {
+                                       trace += 'b';
+                                       boost::asio::post(yield);
+                                       trace += 'd';
+                                   });
+            trace += 'c';
+            ufiber::spawn(yield.get_executor(),
+                          [&](yield_token_t) { trace += 'e'; });
+            trace += 'f';
+        });
+        io.run();
+        BOOST_TEST_EQ(trace, "abcfde");
+    }
+
+    {
+        // From a plain handler, with a custom stack allocator
+        boost::asio::io_context io;
+        ufiber::stack_pool pool;
+        std::string trace;
+        boost::asio::post(io, [&] {
+            ufiber::spawn_dispatch(std::allocator_arg,
+                                   pool.get_allocator(),
+                                   io.get_executor(),
+                                   [&](yield_token_t) { trace += 'a'; });
+            trace += 'b';
+        });
+        io.run();
+        BOOST_TEST_EQ(trace, "ab");
+    }
+
+    {
+        // Fibers that are dispatched while the executor is being destroyed are
+        // unwound like posted ones
+        bool unwound = false;
+        {
+            boost::asio::io_context io;
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                ufiber::spawn_dispatch(io, [&](yield_token_t yield) {
+                    BOOST_TRY
+                    {
+                        boost::asio::post(yield);
+                    }
+                    BOOST_CATCH(ufiber::broken_promise const&)
+                    {
+                        unwound = true;
+                        BOOST_RETHROW
+                    }
+                    BOOST_CATCH_END
+                });
+                boost::asio::post(yield);
+            });
+            io.poll_one();
+        }
+        BOOST_TEST(unwound);
+    }
+
+    return boost::report_errors();
+}
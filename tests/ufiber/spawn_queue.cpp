@@ -0,0 +1,327 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/spawn_queue.hpp>
+#include <ufiber/stack_pool.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/context/fixedsize_stack.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using executor_t = boost::asio::io_context::executor_type;
+using yield_token_t = ufiber::yield_token<executor_t>;
+
+std::atomic<int> stacks{0};
+std::atomic<int> peak_stacks{0};
+
+// Tracks the number of stacks that are allocated at the same time
+struct counting_stack
+{
+    boost::context::stack_context allocate()
+    {
+        auto const n = ++stacks;
+        auto peak = peak_stacks.load();
+        while (n > peak && !peak_stacks.compare_exchange_weak(peak, n))
+        {
+        }
+        return sa_.allocate();
+    }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept
+    {
+        --stacks;
+        sa_.deallocate(sctx);
+    }
+
+    boost::context::fixedsize_stack sa_{16 * 1024};
+};
+
+// Counts the instances of a function object that are still alive
+struct tracked
+{
+    explicit tracked(std::atomic<int>& alive)
+      : alive_{&alive}
+    {
+        ++*alive_;
+    }
+
+    tracked(tracked const& other) noexcept
+      : alive_{other.alive_}
+    {
+        ++*alive_;
+    }
+
+    tracked& operator=(tracked const&) = delete;
+
+    ~tracked()
+    {
+        --*alive_;
+    }
+
+    std::atomic<int>* alive_;
+};
+
+// Number of upcoming posts through a flaky_executor that throw
+int failing_posts = 0;
+
+// An io_context executor whose post() fails on demand
+class flaky_executor
+{
+public:
+    explicit flaky_executor(boost::asio::io_context& io) noexcept
+      : io_{&io}
+    {
+    }
+
+    boost::asio::io_context& context() const noexcept
+    {
+        return *io_;
+    }
+
+    void on_work_started() const noexcept
+    {
+        io_->get_executor().on_work_started();
+    }
+
+    void on_work_finished() const noexcept
+    {
+        io_->get_executor().on_work_finished();
+    }
+
+    template<class F, class A>
+    void dispatch(F&& f, A const& a) const
+    {
+        io_->get_executor().dispatch(std::forward<F>(f), a);
+    }
+
+    template<class F, class A>
+    void post(F&& f, A const& a) const
+    {
+        if (failing_posts > 0)
+        {
+            --failing_posts;
+            throw std::bad_alloc{};
+        }
+        io_->get_executor().post(std::forward<F>(f), a);
+    }
+
+    template<class F, class A>
+    void defer(F&& f, A const& a) const
+    {
+        post(std::forward<F>(f), a);
+    }
+
+    friend bool operator==(flaky_executor const& lhs,
+                           flaky_executor const& rhs) noexcept
+    {
+        return lhs.io_ == rhs.io_;
+    }
+
+    friend bool operator!=(flaky_executor const& lhs,
+                           flaky_executor const& rhs) noexcept
+    {
+        return lhs.io_ != rhs.io_;
+    }
+
+private:
+    boost::asio::io_context* io_;
+};
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Stacks are only allocated for admitted fibers, which start in FIFO
+        // order
+        stacks = 0;
+        peak_stacks = 0;
+        boost::asio::io_context io;
+        std::vector<int> order;
+        {
+            ufiber::spawn_queue<executor_t> queue{io.get_executor(), 2};
+            for (int i = 0; i < 10; ++i)
+            {
+                auto const f = [&order, i](yield_token_t yield) {
+                    order.push_back(i);
+                    boost::asio::post(yield);
+                    boost::asio::post(yield);
+                };
+                queue.spawn(std::allocator_arg, counting_stack{}, f);
+            }
+            BOOST_TEST(stacks == 0);
+            BOOST_TEST(queue.live() == 2);
+            BOOST_TEST(queue.pending() == 8);
+        }
+        // The fibers outlive the queue
+        io.run();
+        BOOST_TEST(stacks == 0);
+        BOOST_TEST(peak_stacks == 2);
+        BOOST_TEST((order == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    }
+
+    {
+        // Without a limit every fiber is admitted, but no stack is allocated
+        // before the executor runs the fiber
+        stacks = 0;
+        boost::asio::io_context io;
+        ufiber::spawn_queue<executor_t> queue{io.get_executor(), 0};
+        int done = 0;
+        for (int i = 0; i < 5; ++i)
+        {
+            queue.spawn(std::allocator_arg,
+                        counting_stack{},
+                        [&](yield_token_t) { ++done; });
+        }
+        ufiber::stack_pool pool;
+        queue.spawn(std::allocator_arg,
+                    pool.get_allocator(),
+                    [&](yield_token_t) { ++done; });
+        BOOST_TEST(stacks == 0);
+        BOOST_TEST(queue.live() == 6);
+        BOOST_TEST(queue.pending() == 0);
+        io.run();
+        BOOST_TEST(done == 6);
+        BOOST_TEST(queue.live() == 0);
+    }
+
+    {
+        // Abandoned fibers destroy the queued ones without starting them
+        std::atomic<int> alive{0};
+        int started = 0;
+        {
+            boost::asio::io_context io;
+            ufiber::spawn_queue<executor_t> queue{io.get_executor(), 1};
+            for (int i = 0; i < 4; ++i)
+            {
+                tracked t{alive};
+                queue.spawn([&started, t](yield_token_t yield) {
+                    ++started;
+                    boost::asio::steady_timer timer{
+                      yield.get_executor().context(), std::chrono::hours{1}};
+                    timer.async_wait(yield);
+                });
+            }
+            io.poll();
+            BOOST_TEST(queue.live() == 1);
+            BOOST_TEST(queue.pending() == 3);
+        }
+        BOOST_TEST(started == 1);
+        BOOST_TEST(alive == 0);
+    }
+
+    {
+        // A spawn that can't be posted is destroyed and gives up its slot
+        std::atomic<int> alive{0};
+        boost::asio::io_context io;
+        ufiber::spawn_queue<flaky_executor> queue{flaky_executor{io}, 0};
+        failing_posts = 1;
+        bool threw = false;
+        try
+        {
+            queue.spawn([t = tracked{alive}](
+                          ufiber::yield_token<flaky_executor>) {});
+        }
+        catch (std::bad_alloc const&)
+        {
+            threw = true;
+        }
+        BOOST_TEST(threw);
+        BOOST_TEST(alive == 0);
+        BOOST_TEST(queue.live() == 0);
+    }
+
+    {
+        // A queued spawn that can't be posted when a slot is handed to it is
+        // destroyed, and the slot goes to the next one
+        std::atomic<int> alive{0};
+        std::vector<int> order;
+        boost::asio::io_context io;
+        ufiber::spawn_queue<flaky_executor> queue{flaky_executor{io}, 1};
+        for (int i = 0; i < 3; ++i)
+        {
+            queue.spawn([&order, i, t = tracked{alive}](
+                          ufiber::yield_token<flaky_executor>) {
+                order.push_back(i);
+                if (i == 0)
+                {
+                    failing_posts = 1;
+                }
+            });
+        }
+        io.run();
+        BOOST_TEST((order == std::vector<int>{0, 2}));
+        BOOST_TEST(alive == 0);
+        BOOST_TEST(queue.live() == 0);
+        BOOST_TEST(queue.pending() == 0);
+    }
+
+    {
+        // Spawns from several threads, and fibers that finish on several
+        // threads
+        stacks = 0;
+        peak_stacks = 0;
+        boost::asio::io_context io{4};
+        ufiber::spawn_queue<executor_t> queue{io.get_executor(), 3};
+        std::atomic<int> running{0};
+        std::atomic<int> peak{0};
+        std::atomic<int> done{0};
+        auto const body = [&](yield_token_t yield) {
+            auto const n = ++running;
+            auto p = peak.load();
+            while (n > p && !peak.compare_exchange_weak(p, n))
+            {
+            }
+            boost::asio::steady_timer t{yield.get_executor().context(),
+                                        std::chrono::microseconds{50}};
+            t.async_wait(yield);
+            --running;
+            ++done;
+        };
+        auto work = boost::asio::make_work_guard(io);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back([&] {
+                for (int j = 0; j < 50; ++j)
+                {
+                    queue.spawn(std::allocator_arg, counting_stack{}, body);
+                }
+                io.run();
+            });
+        }
+        while (done != 200)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        work.reset();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(peak <= 3);
+        BOOST_TEST(peak_stacks <= 3);
+        BOOST_TEST(queue.live() == 0);
+        BOOST_TEST(queue.pending() == 0);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,207 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/stack_pool.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/context/fixedsize_stack.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+std::atomic<int> allocations{0};
+std::atomic<int> deallocations{0};
+
+// Counts the stacks that actually reach the underlying allocator.
+struct counting_stack
+{
+    boost::context::stack_context allocate()
+    {
+        ++allocations;
+        return sa_.allocate();
+    }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept
+    {
+        ++deallocations;
+        sa_.deallocate(sctx);
+    }
+
+    boost::context::fixedsize_stack sa_{16 * 1024};
+};
+
+using pool_t = ufiber::basic_stack_pool<counting_stack>;
+
+void
+reset()
+{
+    allocations = 0;
+    deallocations = 0;
+}
+
+} // namespace
+
+int
+main()
+{
+    using yield_token_t =
+      ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+    {
+        // Fibers spawned one after another reuse the same stack
+        reset();
+        pool_t pool;
+        int count = 0;
+        boost::asio::io_context io{};
+        for (int i = 0; i < 8; ++i)
+        {
+            ufiber::spawn(std::allocator_arg,
+                          pool.get_allocator(),
+                          io.get_executor(),
+                          [&](yield_token_t yield) {
+                              boost::asio::post(yield);
+                              ++count;
+                          });
+            io.run();
+            io.restart();
+        }
+        BOOST_TEST(count == 8);
+        BOOST_TEST(allocations == 1);
+        BOOST_TEST(deallocations == 0);
+    }
+    BOOST_TEST(deallocations == 1);
+
+    {
+        // A released stack is handed out again
+        reset();
+        pool_t pool;
+        auto sa = pool.get_allocator();
+        auto sctx = sa.allocate();
+        auto sp = sctx.sp;
+        sa.deallocate(sctx);
+        sctx = sa.allocate();
+        BOOST_TEST(sctx.sp == sp);
+        sa.deallocate(sctx);
+        BOOST_TEST(allocations == 1);
+    }
+    BOOST_TEST(deallocations == 1);
+
+    {
+        // Exceeding the high watermark moves stacks to the global list, where
+        // other threads can pick them up.
+        reset();
+        ufiber::stack_pool_options opts;
+        opts.high_watermark = 4;
+        opts.low_watermark = 2;
+        pool_t pool{counting_stack{}, opts};
+        auto sa = pool.get_allocator();
+
+        std::vector<boost::context::stack_context> stacks;
+        std::set<void*> sps;
+        for (int i = 0; i < 10; ++i)
+        {
+            stacks.push_back(sa.allocate());
+            sps.insert(stacks.back().sp);
+        }
+        for (auto& s : stacks)
+        {
+            sa.deallocate(s);
+        }
+        BOOST_TEST(allocations == 10);
+
+        std::thread t{[&] {
+            for (int i = 0; i < 6; ++i)
+            {
+                auto s = sa.allocate();
+                BOOST_TEST(sps.count(s.sp) == 1);
+                stacks[i] = s;
+            }
+            for (int i = 0; i < 6; ++i)
+            {
+                sa.deallocate(stacks[i]);
+            }
+        }};
+        t.join();
+        BOOST_TEST(allocations == 10);
+    }
+    BOOST_TEST(deallocations == 10);
+
+    {
+        // Prewarmed stacks are used before new ones are allocated
+        reset();
+        ufiber::stack_pool_options opts;
+        opts.prewarm = 3;
+        pool_t pool{counting_stack{}, opts};
+        BOOST_TEST(allocations == 3);
+        auto sa = pool.get_allocator();
+        boost::context::stack_context stacks[4];
+        for (auto& s : stacks)
+        {
+            s = sa.allocate();
+        }
+        BOOST_TEST(allocations == 4);
+        for (auto& s : stacks)
+        {
+            sa.deallocate(s);
+        }
+    }
+    BOOST_TEST(deallocations == 4);
+
+    {
+        // A refill takes whole batches, only as many as it needs
+        ufiber::detail::stack_freelist list;
+        ufiber::detail::stack_node nodes[6] = {};
+        for (int i = 0; i < 5; ++i)
+        {
+            nodes[i].next_ = &nodes[i + 1];
+        }
+        list.push(&nodes[0], &nodes[2], 3);
+        list.push(&nodes[3], &nodes[4], 2);
+        list.push(&nodes[5], &nodes[5], 1);
+        std::size_t taken = 0;
+        auto n = list.pop(2, taken);
+        BOOST_TEST(n == &nodes[5]);
+        BOOST_TEST(n->next_ == &nodes[3]);
+        BOOST_TEST(nodes[4].next_ == nullptr);
+        BOOST_TEST(taken == 3);
+        taken = 0;
+        n = list.pop(1, taken);
+        BOOST_TEST(n == &nodes[0]);
+        BOOST_TEST(nodes[2].next_ == nullptr);
+        BOOST_TEST(taken == 3);
+        BOOST_TEST(list.pop_all() == nullptr);
+    }
+
+    {
+        // The default pool works with the protected stack allocator
+        ufiber::stack_pool pool;
+        int count = 0;
+        boost::asio::io_context io{};
+        for (int i = 0; i < 4; ++i)
+        {
+            ufiber::spawn(std::allocator_arg,
+                          pool.get_allocator(),
+                          io.get_executor(),
+                          [&](yield_token_t yield) {
+                              boost::asio::post(yield);
+                              ++count;
+                          });
+        }
+        io.run();
+        BOOST_TEST(count == 4);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/stack_profile.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/context/fixedsize_stack.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <cstring>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+// Touches roughly `depth` KiB of stack.
+int
+dig(int depth)
+{
+    volatile char buffer[1024];
+    std::memset(const_cast<char*>(buffer), depth, sizeof(buffer));
+    if (depth == 0)
+    {
+        return buffer[0];
+    }
+    return dig(depth - 1) + buffer[1];
+}
+
+struct shallow
+{
+    void operator()(yield_token_t yield)
+    {
+        dig(8);
+        boost::asio::post(yield);
+    }
+};
+
+} // namespace
+
+int
+main()
+{
+    {
+        // The peak usage of each fiber is recorded once it finishes
+        ufiber::stack_profile profile;
+        boost::asio::io_context io{};
+        for (int depth : {16, 32})
+        {
+            ufiber::spawn(
+              std::allocator_arg,
+              ufiber::measured_stack<boost::context::fixedsize_stack>{
+                boost::context::fixedsize_stack{256 * 1024}, profile},
+              io.get_executor(),
+              [depth](yield_token_t yield) {
+                  dig(depth);
+                  boost::asio::post(yield);
+              });
+        }
+        BOOST_TEST(profile.samples() == 0);
+        io.run();
+        BOOST_TEST(profile.samples() == 2);
+        BOOST_TEST(profile.peak() >= 32 * 1024);
+        BOOST_TEST(profile.peak() < 64 * 1024);
+        BOOST_TEST(profile.mean() >= 16 * 1024);
+        BOOST_TEST(profile.mean() < profile.peak());
+    }
+
+    {
+        auto const page = boost::context::stack_traits::page_size();
+        ufiber::stack_profile profile;
+        BOOST_TEST(profile.recommended_size(page, 64 * page) == 64 * page);
+        profile.record(page);
+        BOOST_TEST(profile.recommended_size(page, 64 * page) == 2 * page);
+        BOOST_TEST(profile.recommended_size(4 * page, 64 * page) == 4 * page);
+        profile.record(100 * page);
+        BOOST_TEST(profile.recommended_size(page, 64 * page) == 64 * page);
+    }
+
+    {
+        // A deep or exhausted fiber only affects the recommendation until its
+        // sample has left the window
+        auto const page = boost::context::stack_traits::page_size();
+        ufiber::stack_profile profile;
+        profile.record(page);
+        profile.record(8 * page, true);
+        BOOST_TEST(profile.recommended_size(page, 64 * page) == 64 * page);
+        for (int i = 0; i < 2 * UFIBER_STACK_PROFILE_WINDOW; ++i)
+        {
+            profile.record(page);
+        }
+        BOOST_TEST(profile.recommended_size(page, 64 * page) == 2 * page);
+        BOOST_TEST(profile.peak() == 8 * page);
+
+        profile.record(32 * page);
+        BOOST_TEST(profile.recommended_size(page, 64 * page) == 48 * page);
+        for (int i = 0; i < 2 * UFIBER_STACK_PROFILE_WINDOW; ++i)
+        {
+            profile.record(page);
+        }
+        BOOST_TEST(profile.recommended_size(page, 64 * page) == 2 * page);
+    }
+
+    {
+        // Stacks for the same entry point shrink to the measured usage
+        auto const max_size = std::size_t{512 * 1024};
+        auto& profile = ufiber::stack_profile_for<shallow>();
+        boost::asio::io_context io{};
+        ufiber::spawn(std::allocator_arg,
+                      ufiber::adaptive_stack<shallow>{max_size},
+                      io.get_executor(),
+                      shallow{});
+        io.run();
+        BOOST_TEST(profile.samples() == 1);
+        auto const recommended =
+          profile.recommended_size(std::size_t{0}, max_size);
+        BOOST_TEST(recommended >= profile.peak());
+        BOOST_TEST(recommended < max_size / 8);
+
+        ufiber::adaptive_stack<shallow> sa{max_size};
+        auto sctx = sa.allocate();
+        BOOST_TEST(sctx.size < max_size / 8);
+        sa.deallocate(sctx);
+
+        io.restart();
+        ufiber::spawn(std::allocator_arg,
+                      ufiber::adaptive_stack<shallow>{max_size},
+                      io.get_executor(),
+                      shallow{});
+        io.run();
+        BOOST_TEST(profile.samples() == 3);
+    }
+
+    return boost::report_errors();
+}
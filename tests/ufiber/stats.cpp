@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_ENABLE_STATS
+#define UFIBER_ENABLE_STATS
+#endif // UFIBER_ENABLE_STATS
+
+#include <ufiber/stats.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <thread>
+
+int
+main()
+{
+    using yield_token_t =
+      ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+    BOOST_TEST(ufiber::stats_enabled());
+    auto const before = ufiber::get_stats();
+    BOOST_TEST(before.live == 0);
+
+    {
+        boost::asio::io_context io{};
+        std::uint64_t stack_bytes = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                stack_bytes = ufiber::get_thread_stats().stack_bytes;
+                boost::asio::post(yield);
+                boost::asio::post(yield);
+            });
+        }
+
+        auto s = ufiber::get_stats();
+        BOOST_TEST(s.spawned - before.spawned == 3);
+        BOOST_TEST(s.completed == before.completed);
+        BOOST_TEST(s.live == 3);
+        BOOST_TEST(s.peak_live >= 3);
+        BOOST_TEST(s.stack_bytes > before.stack_bytes);
+
+        io.run();
+        BOOST_TEST(stack_bytes > 0);
+        s = ufiber::get_stats();
+        BOOST_TEST(s.completed - before.completed == 3);
+        BOOST_TEST(s.live == 0);
+        BOOST_TEST(s.stack_bytes == before.stack_bytes);
+        // Each fiber suspends in its initial post and in two more operations
+        BOOST_TEST(s.suspends - before.suspends == 9);
+        BOOST_TEST(s.resumes - before.resumes == 9);
+        BOOST_TEST(s.broken_promises == before.broken_promises);
+    }
+
+    {
+        // An abandoned operation unwinds the fiber with a broken_promise
+        auto const start = ufiber::get_stats();
+        {
+            boost::asio::io_context io{};
+            ufiber::spawn(io, [](yield_token_t yield) {
+                boost::asio::post(yield);
+                BOOST_ERROR("unreachable");
+            });
+        }
+        auto const s = ufiber::get_stats();
+        BOOST_TEST(s.broken_promises - start.broken_promises == 1);
+        BOOST_TEST(s.completed - start.completed == 1);
+        BOOST_TEST(s.live == 0);
+    }
+
+    {
+        // Counters of exited threads remain part of the aggregate
+        auto const start = ufiber::get_stats();
+        std::thread t{[] {
+            boost::asio::io_context io{};
+            ufiber::spawn(io, [](yield_token_t yield) {
+                boost::asio::post(yield);
+            });
+            io.run();
+        }};
+        t.join();
+        auto const s = ufiber::get_stats();
+        BOOST_TEST(s.spawned - start.spawned == 1);
+        BOOST_TEST(s.completed - start.completed == 1);
+        BOOST_TEST(s.resumes - start.resumes == 2);
+        BOOST_TEST(ufiber::get_thread_stats().spawned == start.spawned);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,222 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/sync.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+void
+run_threads(boost::asio::io_context& io, int n)
+{
+    std::vector<std::thread> threads;
+    for (int i = 1; i < n; ++i)
+    {
+        threads.emplace_back([&io] { io.run(); });
+    }
+    io.run();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Mutual exclusion between fibers on several threads
+        boost::asio::io_context io{4};
+        ufiber::mutex m;
+        int inside = 0;
+        int max_inside = 0;
+        int counter = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                for (int j = 0; j < 100; ++j)
+                {
+                    m.lock(yield);
+                    max_inside = std::max(max_inside, ++inside);
+                    boost::asio::post(yield);
+                    ++counter;
+                    --inside;
+                    m.unlock();
+                }
+            });
+        }
+        run_threads(io, 4);
+        BOOST_TEST(counter == 1600);
+        BOOST_TEST(max_inside == 1);
+        BOOST_TEST(m.try_lock());
+        BOOST_TEST(!m.try_lock());
+        m.unlock();
+    }
+
+    {
+        // Ownership is handed over in FIFO order
+        boost::asio::io_context io{};
+        ufiber::mutex m;
+        std::vector<int> order;
+        BOOST_TEST(m.try_lock());
+        for (int i = 0; i < 4; ++i)
+        {
+            ufiber::spawn(io, [&, i](yield_token_t yield) {
+                m.lock(yield);
+                order.push_back(i);
+                m.unlock();
+            });
+            // Let the fiber queue up before spawning the next one
+            io.poll();
+            io.restart();
+        }
+        BOOST_TEST(order.empty());
+        m.unlock();
+        io.run();
+        BOOST_TEST((order == std::vector<int>{0, 1, 2, 3}));
+    }
+
+    {
+        // Producer and consumer synchronized by a condition variable
+        boost::asio::io_context io{2};
+        ufiber::mutex m;
+        ufiber::condition_variable cv;
+        std::vector<int> queue;
+        int sum = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            for (int received = 0; received < 100;)
+            {
+                m.lock(yield);
+                cv.wait(m, yield, [&] { return !queue.empty(); });
+                for (auto v : queue)
+                {
+                    sum += v;
+                    ++received;
+                }
+                queue.clear();
+                m.unlock();
+            }
+        });
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            for (int i = 1; i <= 100; ++i)
+            {
+                m.lock(yield);
+                queue.push_back(i);
+                m.unlock();
+                cv.notify_one();
+                boost::asio::post(yield);
+            }
+        });
+        run_threads(io, 2);
+        BOOST_TEST(sum == 5050);
+    }
+
+    {
+        // notify_all() wakes every waiter, each one reacquires the mutex
+        boost::asio::io_context io{};
+        ufiber::mutex m;
+        ufiber::condition_variable cv;
+        bool ready = false;
+        int woken = 0;
+        for (int i = 0; i < 5; ++i)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                m.lock(yield);
+                cv.wait(m, yield, [&] { return ready; });
+                ++woken;
+                m.unlock();
+            });
+        }
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::asio::post(yield);
+            m.lock(yield);
+            ready = true;
+            cv.notify_all();
+            // Waiters can't proceed until the mutex is released
+            boost::asio::post(yield);
+            BOOST_TEST(woken == 0);
+            m.unlock();
+        });
+        io.run();
+        BOOST_TEST(woken == 5);
+    }
+
+    {
+        // A semaphore limits concurrency
+        boost::asio::io_context io{4};
+        ufiber::semaphore sem{2};
+        std::atomic<int> inside{0};
+        std::atomic<int> max_inside{0};
+        std::atomic<int> done{0};
+        for (int i = 0; i < 16; ++i)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                for (int j = 0; j < 20; ++j)
+                {
+                    sem.acquire(yield);
+                    auto n = ++inside;
+                    auto max = max_inside.load();
+                    while (n > max && !max_inside.compare_exchange_weak(max, n))
+                    {
+                    }
+                    boost::asio::post(yield);
+                    --inside;
+                    sem.release();
+                }
+                ++done;
+            });
+        }
+        run_threads(io, 4);
+        BOOST_TEST(done == 16);
+        BOOST_TEST(max_inside <= 2);
+        BOOST_TEST(sem.try_acquire());
+        BOOST_TEST(sem.try_acquire());
+        BOOST_TEST(!sem.try_acquire());
+    }
+
+    {
+        // release(n) wakes up to n waiters
+        boost::asio::io_context io{};
+        ufiber::semaphore sem{0};
+        int acquired = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                sem.acquire(yield);
+                ++acquired;
+            });
+        }
+        io.poll();
+        io.restart();
+        BOOST_TEST(acquired == 0);
+        sem.release(2);
+        io.poll();
+        io.restart();
+        BOOST_TEST(acquired == 2);
+        sem.release(2);
+        io.run();
+        BOOST_TEST(acquired == 3);
+        BOOST_TEST(sem.try_acquire());
+        BOOST_TEST(!sem.try_acquire());
+    }
+
+    return boost::report_errors();
+}
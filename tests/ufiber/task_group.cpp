@@ -0,0 +1,226 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/task_group.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+// Waits on a timer that only expires if the group isn't cancelled
+void
+wait_for_cancel(yield_token_t& yield, ufiber::stop_token const& stop)
+{
+    boost::asio::steady_timer t{yield.get_executor().context(),
+                                std::chrono::hours{1}};
+    auto cancel = [&t] { t.cancel(); };
+    ufiber::stop_callback<decltype(cancel)> cb{stop, cancel};
+    t.async_wait(yield);
+}
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Fan-out and join
+        boost::asio::io_context io;
+        int sum = 0;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::task_group group{yield};
+            for (int i = 0; i < 100; ++i)
+            {
+                group.spawn(yield, [&sum, i](yield_token_t yield) {
+                    boost::asio::post(yield);
+                    sum += i;
+                });
+            }
+            group.async_wait_all(yield);
+            BOOST_TEST(sum == 99 * 100 / 2);
+            // Waiting on an empty group doesn't suspend
+            group.async_wait_all(yield);
+        });
+        io.run();
+        BOOST_TEST(sum == 99 * 100 / 2);
+    }
+
+    {
+        // A failing child cancels its siblings, and the error is rethrown
+        boost::asio::io_context io;
+        int cancelled = 0;
+        bool caught = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::task_group group{yield};
+            for (int i = 0; i < 4; ++i)
+            {
+                group.spawn(yield,
+                            [&](yield_token_t yield, ufiber::stop_token stop) {
+                                wait_for_cancel(yield, stop);
+                                BOOST_TEST(stop.stop_requested());
+                                ++cancelled;
+                            });
+            }
+            group.spawn(yield, [](yield_token_t yield) {
+                boost::asio::post(yield);
+                throw std::runtime_error{"child"};
+            });
+            try
+            {
+                group.async_wait_all(yield);
+            }
+            catch (std::runtime_error const&)
+            {
+                caught = true;
+            }
+            BOOST_TEST(group.cancelled());
+        });
+        auto const start = std::chrono::steady_clock::now();
+        io.run();
+        BOOST_TEST(std::chrono::steady_clock::now() - start <
+                   std::chrono::minutes{1});
+        BOOST_TEST(caught);
+        BOOST_TEST(cancelled == 4);
+    }
+
+    {
+        // Leaving the scope cancels the children and waits for them, also
+        // when the scope is left by an exception
+        boost::asio::io_context io;
+        int running = 0;
+        bool caught = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            try
+            {
+                ufiber::task_group group{yield};
+                for (int i = 0; i < 3; ++i)
+                {
+                    group.spawn(
+                      yield, [&](yield_token_t yield, ufiber::stop_token stop) {
+                          ++running;
+                          wait_for_cancel(yield, stop);
+                          --running;
+                      });
+                }
+                boost::asio::post(yield);
+                BOOST_TEST(running == 3);
+                throw std::logic_error{"parent"};
+            }
+            catch (std::logic_error const&)
+            {
+                caught = true;
+                BOOST_TEST(running == 0);
+            }
+        });
+        io.run();
+        BOOST_TEST(caught);
+        BOOST_TEST(running == 0);
+    }
+
+    {
+        // Children spawned into a cancelled group are not run
+        boost::asio::io_context io;
+        bool ran = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::task_group group{yield};
+            group.cancel();
+            group.spawn(yield, [&](yield_token_t) { ran = true; });
+            group.async_wait_all(yield);
+        });
+        io.run();
+        BOOST_TEST(!ran);
+    }
+
+    {
+        // The limit bounds the number of running children, also when they
+        // run on several threads
+        boost::asio::io_context io{4};
+        std::atomic<int> running{0};
+        std::atomic<int> peak{0};
+        std::atomic<int> done{0};
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::task_group group{yield, 4};
+            for (int i = 0; i < 64; ++i)
+            {
+                group.spawn(yield, [&](yield_token_t yield) {
+                    auto const now = ++running;
+                    auto prev = peak.load();
+                    while (now > prev && !peak.compare_exchange_weak(prev, now))
+                    {
+                    }
+                    for (int j = 0; j < 10; ++j)
+                    {
+                        boost::asio::post(yield);
+                    }
+                    --running;
+                    ++done;
+                });
+            }
+            group.async_wait_all(yield);
+        });
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i)
+        {
+            threads.emplace_back([&io] { io.run(); });
+        }
+        io.run();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(done == 64);
+        BOOST_TEST(peak <= 4);
+    }
+
+    {
+        // Abandoning the parent and its children at shutdown
+        int unwound = 0;
+        {
+            boost::asio::io_context io;
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                ufiber::task_group group{yield};
+                for (int i = 0; i < 3; ++i)
+                {
+                    group.spawn(yield, [&](yield_token_t yield) {
+                        try
+                        {
+                            boost::asio::steady_timer t{
+                              yield.get_executor().context(),
+                              std::chrono::hours{1}};
+                            t.async_wait(yield);
+                        }
+                        catch (ufiber::broken_promise const&)
+                        {
+                            ++unwound;
+                            throw;
+                        }
+                    });
+                }
+                group.async_wait_all(yield);
+            });
+            io.poll();
+        }
+        BOOST_TEST(unwound == 3);
+    }
+
+    return boost::report_errors();
+}
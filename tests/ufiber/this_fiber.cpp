@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/this_fiber.hpp>
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/core/lightweight_test.hpp>
+#include <boost/core/no_exceptions_support.hpp>
+
+#include <chrono>
+#include <string>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Yielding fibers take turns
+        boost::asio::io_context io;
+        std::string trace;
+        for (char c : {'a', 'b'})
+        {
+            ufiber::spawn(io, [&trace, c](yield_token_t yield) {
+                for (int i = 0; i < 3; ++i)
+                {
+                    trace += c;
+                    ufiber::this_fiber::yield(yield);
+                }
+            });
+        }
+        io.run();
+        BOOST_TEST_EQ(trace, "ababab");
+    }
+
+    {
+        // The budget is disabled by default
+        boost::asio::io_context io;
+        ufiber::spawn(io, [](yield_token_t yield) {
+            auto const b = ufiber::this_fiber::get_budget(yield);
+            BOOST_TEST_EQ(b.operations, UFIBER_BUDGET_OPERATIONS);
+            BOOST_TEST(b.time.count() == UFIBER_BUDGET_MICROSECONDS);
+
+            ufiber::yield_budget budget;
+            budget.operations = 7;
+            budget.time = std::chrono::milliseconds{1};
+            ufiber::this_fiber::set_budget(yield, budget);
+            auto const set = ufiber::this_fiber::get_budget(yield);
+            BOOST_TEST_EQ(set.operations, 7u);
+            BOOST_TEST(set.time == std::chrono::milliseconds{1});
+        });
+        io.run();
+    }
+
+    {
+        // A fiber whose operations complete immediately is rescheduled once it
+        // has used up its operations
+        boost::asio::io_context io;
+        std::string trace;
+        auto const before = ufiber::get_thread_stats();
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::yield_budget budget;
+            budget.operations = 4;
+            ufiber::this_fiber::set_budget(yield, budget);
+            for (int i = 0; i < 10; ++i)
+            {
+                boost::asio::dispatch(yield);
+                trace += 'a';
+            }
+        });
+        ufiber::spawn(io, [&](yield_token_t) { trace += 'b'; });
+        io.run();
+        BOOST_TEST_EQ(trace, "aaaabaaaaaa");
+        if (ufiber::stats_enabled())
+        {
+            auto const after = ufiber::get_thread_stats();
+            // Before the 5th and the 9th operation
+            BOOST_TEST_EQ(after.budget_yields - before.budget_yields, 2u);
+        }
+    }
+
+    {
+        // Or once it has run for too long
+        boost::asio::io_context io;
+        std::string trace;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            ufiber::yield_budget budget;
+            budget.time = std::chrono::microseconds{100};
+            ufiber::this_fiber::set_budget(yield, budget);
+            boost::asio::dispatch(yield);
+            trace += 'a';
+            auto const start = std::chrono::steady_clock::now();
+            while (std::chrono::steady_clock::now() - start <
+                   std::chrono::milliseconds{1})
+            {
+            }
+            boost::asio::dispatch(yield);
+            trace += 'a';
+        });
+        ufiber::spawn(io, [&](yield_token_t) { trace += 'b'; });
+        io.run();
+        BOOST_TEST_EQ(trace, "aba");
+    }
+
+    {
+        // A yielded fiber is unwound if the executor is destroyed
+        bool unwound = false;
+        {
+            boost::asio::io_context io;
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                BOOST_TRY
+                {
+                    ufiber::this_fiber::yield(yield);
+                    ufiber::this_fiber::yield(yield);
+                }
+                BOOST_CATCH(ufiber::broken_promise const&)
+                {
+                    unwound = true;
+                    BOOST_RETHROW
+                }
+                BOOST_CATCH_END
+            });
+            io.poll_one();
+            io.poll_one();
+        }
+        BOOST_TEST(unwound);
+    }
+
+    return boost::report_errors();
+}
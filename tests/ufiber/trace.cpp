@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_ENABLE_TRACING
+#define UFIBER_ENABLE_TRACING
+#endif // UFIBER_ENABLE_TRACING
+#define UFIBER_TRACE_BUFFER_SIZE 64
+
+#include <ufiber/trace.hpp>
+#include <ufiber/ufiber.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+std::size_t
+count(std::string const& s, std::string const& what)
+{
+    std::size_t n = 0;
+    for (auto pos = s.find(what); pos != std::string::npos;
+         pos = s.find(what, pos + what.size()))
+    {
+        ++n;
+    }
+    return n;
+}
+
+std::string
+dump()
+{
+    std::ostringstream os;
+    ufiber::write_chrome_trace(os);
+    return os.str();
+}
+
+void
+run_fibers(int fibers, int posts)
+{
+    boost::asio::io_context io{};
+    for (int i = 0; i < fibers; ++i)
+    {
+        ufiber::spawn(io, [posts](yield_token_t yield) {
+            for (int j = 0; j < posts; ++j)
+            {
+                boost::asio::post(yield);
+            }
+        });
+    }
+    io.run();
+}
+
+std::set<std::string>
+threads_of(std::string const& s)
+{
+    std::string const what = "\"thread\":";
+    std::set<std::string> threads;
+    for (auto pos = s.find(what); pos != std::string::npos;
+         pos = s.find(what, pos + what.size()))
+    {
+        auto const begin = pos + what.size();
+        threads.insert(s.substr(begin, s.find('}', begin) - begin));
+    }
+    return threads;
+}
+
+} // namespace
+
+int
+main()
+{
+    BOOST_TEST(ufiber::tracing_enabled());
+
+    // Nothing is recorded until tracing is started
+    run_fibers(1, 1);
+    BOOST_TEST(count(dump(), "\"ph\"") == 0);
+
+    {
+        ufiber::start_tracing();
+        run_fibers(2, 1);
+        ufiber::stop_tracing();
+        auto const trace = dump();
+        BOOST_TEST(trace.compare(0, 1, "{") == 0);
+        BOOST_TEST(count(trace, "\"thread_name\"") == 2);
+        // Each fiber runs until its initial post, until its own post and until
+        // it finishes.
+        BOOST_TEST(count(trace, "\"name\":\"run\"") == 6);
+        BOOST_TEST(count(trace, "\"name\":\"suspended\"") == 4);
+    }
+
+    {
+        // Events recorded while tracing is stopped are not kept
+        run_fibers(1, 3);
+        BOOST_TEST(count(dump(), "\"name\":\"run\"") == 6);
+    }
+
+    {
+        // Only the newest events are kept once the ring buffer wraps around
+        ufiber::start_tracing();
+        run_fibers(1, 1000);
+        ufiber::stop_tracing();
+        auto const trace = dump();
+        BOOST_TEST(count(trace, "\"thread_name\"") == 1);
+        auto const slices = count(trace, "\"ph\":\"X\"");
+        BOOST_TEST(slices > 0);
+        BOOST_TEST(slices < 64);
+        BOOST_TEST(trace.find("\n]}") != std::string::npos);
+    }
+
+    {
+        // Threads that don't record at the same time share a buffer
+        auto const before = threads_of(dump()).size();
+        ufiber::start_tracing();
+        for (int i = 0; i < 8; ++i)
+        {
+            std::thread t{[] { run_fibers(1, 1); }};
+            t.join();
+        }
+        ufiber::stop_tracing();
+        BOOST_TEST(threads_of(dump()).size() == before + 1);
+    }
+
+    return boost::report_errors();
+}
@@ -0,0 +1,127 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#ifndef UFIBER_ENABLE_WATCHDOG
+#define UFIBER_ENABLE_WATCHDOG
+#endif // UFIBER_ENABLE_WATCHDOG
+#ifndef UFIBER_ENABLE_REGISTRY
+#define UFIBER_ENABLE_REGISTRY
+#endif // UFIBER_ENABLE_REGISTRY
+
+#include <ufiber/ufiber.hpp>
+#include <ufiber/watchdog.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+void
+spin_for(std::chrono::steady_clock::duration d)
+{
+    auto const end = std::chrono::steady_clock::now() + d;
+    while (std::chrono::steady_clock::now() < end)
+    {
+    }
+}
+
+} // namespace
+
+int
+main()
+{
+    using yield_token_t =
+      ufiber::yield_token<boost::asio::io_context::executor_type>;
+
+    BOOST_TEST(ufiber::watchdog_enabled());
+
+    std::mutex mutex;
+    std::vector<ufiber::watchdog_report> reports;
+    auto const budget = std::chrono::milliseconds{40};
+
+    {
+        ufiber::watchdog dog{budget, [&](ufiber::watchdog_report const& r) {
+                                 std::lock_guard<std::mutex> lock{mutex};
+                                 reports.push_back(r);
+                             }};
+        boost::asio::io_context io{};
+        // Well-behaved fibers suspend often and are never reported
+        for (int i = 0; i < 4; ++i)
+        {
+            ufiber::spawn(io, [](yield_token_t yield) {
+                for (int j = 0; j < 100; ++j)
+                {
+                    spin_for(std::chrono::microseconds{100});
+                    boost::asio::post(yield);
+                }
+            });
+        }
+        ufiber::spawn(io, [](yield_token_t yield) {
+            ufiber::set_fiber_name(yield, "hog");
+            boost::asio::post(yield);
+            spin_for(std::chrono::milliseconds{400});
+            boost::asio::post(yield);
+            // Suspended fibers don't count against the budget
+            spin_for(std::chrono::milliseconds{1});
+        });
+        io.run();
+        // Give the monitor a chance to see the thread idle
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        BOOST_TEST(reports.size() == 1);
+        if (!reports.empty())
+        {
+            BOOST_TEST(reports[0].name == "hog");
+            BOOST_TEST(reports[0].fiber != 0);
+            BOOST_TEST(reports[0].elapsed > budget);
+            BOOST_TEST(reports[0].elapsed < std::chrono::milliseconds{400});
+        }
+    }
+
+    {
+        // A run is measured from the resume, not from the first sample that
+        // saw it
+        reports.clear();
+        std::atomic<bool> started{false};
+        boost::asio::io_context io{};
+        ufiber::spawn(io, [&](yield_token_t) {
+            started = true;
+            spin_for(std::chrono::milliseconds{300});
+        });
+        std::thread t{[&io] { io.run(); }};
+        while (!started)
+        {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+        {
+            ufiber::watchdog dog{budget, [&](ufiber::watchdog_report const& r) {
+                                     std::lock_guard<std::mutex> lock{mutex};
+                                     reports.push_back(r);
+                                 }};
+            t.join();
+        }
+        BOOST_TEST(reports.size() == 1);
+        if (!reports.empty())
+        {
+            BOOST_TEST(reports[0].elapsed >= std::chrono::milliseconds{100});
+        }
+    }
+
+    return boost::report_errors();
+}
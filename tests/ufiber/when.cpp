@@ -0,0 +1,297 @@
+//
+// Copyright (c) 2018 Damian Jarek (damian dot jarek93 at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/djarek/ufiber
+//
+
+#include <ufiber/ufiber.hpp>
+#include <ufiber/when.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+
+using yield_token_t =
+  ufiber::yield_token<boost::asio::io_context::executor_type>;
+using socket_t = boost::asio::local::stream_protocol::socket;
+using error_code = boost::system::error_code;
+
+} // namespace
+
+int
+main()
+{
+    {
+        // Results of different completion signatures, in order
+        boost::asio::io_context io;
+        socket_t a{io};
+        socket_t b{io};
+        boost::asio::local::connect_pair(a, b);
+        bool checked = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::asio::steady_timer t{io, std::chrono::milliseconds{1}};
+            char buf[3];
+            auto r = ufiber::when_all(
+              yield,
+              [&](ufiber::leg_token token) { return t.async_wait(token); },
+              [&](ufiber::leg_token token) {
+                  return boost::asio::async_write(
+                    b, boost::asio::buffer("abc", 3), token);
+              },
+              [&](ufiber::leg_token token) {
+                  return boost::asio::async_read(
+                    a, boost::asio::buffer(buf), token);
+              },
+              [&](ufiber::leg_token token) {
+                  return boost::asio::post(io, token);
+              });
+            static_assert(
+              std::is_same<decltype(r),
+                           std::tuple<error_code,
+                                      std::tuple<error_code, std::size_t>,
+                                      std::tuple<error_code, std::size_t>,
+                                      std::tuple<>>>::value,
+              "");
+            BOOST_TEST(!std::get<0>(r));
+            BOOST_TEST(std::get<1>(std::get<1>(r)) == 3);
+            BOOST_TEST(std::get<1>(std::get<2>(r)) == 3);
+            BOOST_TEST(std::string(buf, 3) == "abc");
+            checked = true;
+        });
+        io.run();
+        BOOST_TEST(checked);
+    }
+
+    {
+        // The first completion wins and the other operations are cancelled
+        boost::asio::io_context io;
+        socket_t a{io};
+        socket_t b{io};
+        boost::asio::local::connect_pair(a, b);
+        std::size_t winner = 2;
+        error_code read_ec;
+        error_code timer_ec;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::asio::steady_timer t{io, std::chrono::milliseconds{5}};
+            char buf[16];
+            auto r = ufiber::when_any(
+              yield,
+              ufiber::cancellable(
+                [&](ufiber::leg_token token) {
+                    return a.async_read_some(boost::asio::buffer(buf), token);
+                },
+                [&] {
+                    error_code ec;
+                    a.cancel(ec);
+                }),
+              ufiber::cancellable(
+                [&](ufiber::leg_token token) { return t.async_wait(token); },
+                [&] { t.cancel(); }));
+            winner = r.first;
+            read_ec = std::get<0>(std::get<0>(r.second));
+            timer_ec = std::get<1>(r.second);
+        });
+        auto const start = std::chrono::steady_clock::now();
+        io.run();
+        BOOST_TEST(std::chrono::steady_clock::now() - start <
+                   std::chrono::minutes{1});
+        BOOST_TEST(winner == 1);
+        BOOST_TEST(!timer_ec);
+        BOOST_TEST(read_ec == boost::asio::error::operation_aborted);
+    }
+
+    {
+        // A winner that completes while later operations are being started
+        // still cancels them
+        boost::asio::io_context io;
+        std::size_t winner = 2;
+        error_code timer_ec;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::asio::steady_timer t{io, std::chrono::hours{1}};
+            auto r = ufiber::when_any(
+              yield,
+              [&](ufiber::leg_token token) {
+                  return boost::asio::post(io, token);
+              },
+              ufiber::cancellable(
+                [&](ufiber::leg_token token) { return t.async_wait(token); },
+                [&] { t.cancel(); }));
+            winner = r.first;
+            timer_ec = std::get<1>(r.second);
+        });
+        io.run();
+        BOOST_TEST(winner == 0);
+        BOOST_TEST(timer_ec == boost::asio::error::operation_aborted);
+    }
+
+    {
+        // Many fibers on several threads
+        boost::asio::io_context io{4};
+        std::atomic<int> done{0};
+        for (int i = 0; i < 64; ++i)
+        {
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                for (int j = 0; j < 20; ++j)
+                {
+                    boost::asio::steady_timer t{io,
+                                                std::chrono::microseconds{j}};
+                    auto post = [&](ufiber::leg_token token) {
+                        return boost::asio::post(io, token);
+                    };
+                    auto r = ufiber::when_all(
+                      yield,
+                      post,
+                      [&](ufiber::leg_token token) {
+                          return t.async_wait(token);
+                      },
+                      post);
+                    BOOST_TEST(!std::get<1>(r));
+                }
+                ++done;
+            });
+        }
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i)
+        {
+            threads.emplace_back([&io] { io.run(); });
+        }
+        io.run();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        BOOST_TEST(done == 64);
+    }
+
+    {
+        // Abandoned operations resume the fiber with broken_promise
+        bool abandoned = false;
+        {
+            boost::asio::io_context io;
+            boost::asio::steady_timer t{io, std::chrono::hours{1}};
+            ufiber::spawn(io, [&](yield_token_t yield) {
+                try
+                {
+                    ufiber::when_all(
+                      yield,
+                      [&](ufiber::leg_token token) {
+                          return boost::asio::post(io, token);
+                      },
+                      [&](ufiber::leg_token token) {
+                          return t.async_wait(token);
+                      });
+                }
+                catch (ufiber::broken_promise const&)
+                {
+                    abandoned = true;
+                    throw;
+                }
+            });
+            io.poll();
+        }
+        BOOST_TEST(abandoned);
+    }
+
+    {
+        // An exception thrown while starting an operation reaches the fiber,
+        // once the operations started before it have been cancelled
+        boost::asio::io_context io;
+        bool cancelled = false;
+        bool third_started = false;
+        bool caught = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            boost::asio::steady_timer t{io, std::chrono::hours{1}};
+            try
+            {
+                ufiber::when_all(
+                  yield,
+                  ufiber::cancellable(
+                    [&](ufiber::leg_token token) {
+                        return t.async_wait(token);
+                    },
+                    [&] {
+                        cancelled = true;
+                        t.cancel();
+                    }),
+                  [&](ufiber::leg_token token) {
+                      // The handler is destroyed without being invoked
+                      return boost::asio::async_initiate<ufiber::leg_token,
+                                                         void()>(
+                        [](ufiber::detail::leg_handler<>) {
+                            throw std::runtime_error{"start"};
+                        },
+                        token);
+                  },
+                  [&](ufiber::leg_token token) {
+                      third_started = true;
+                      return boost::asio::post(io, token);
+                  });
+            }
+            catch (std::runtime_error const&)
+            {
+                caught = true;
+            }
+        });
+        auto const start = std::chrono::steady_clock::now();
+        io.run();
+        BOOST_TEST(std::chrono::steady_clock::now() - start <
+                   std::chrono::minutes{1});
+        BOOST_TEST(caught);
+        BOOST_TEST(cancelled);
+        BOOST_TEST(!third_started);
+    }
+
+    {
+        // An operation that is started before its initiation throws is
+        // waited for
+        boost::asio::io_context io;
+        bool fail = true;
+        bool caught = false;
+        ufiber::spawn(io, [&](yield_token_t yield) {
+            try
+            {
+                ufiber::when_any(
+                  yield,
+                  [&](ufiber::leg_token token) {
+                      return boost::asio::post(io, token);
+                  },
+                  [&](ufiber::leg_token token) {
+                      auto r = boost::asio::post(io, token);
+                      if (fail)
+                      {
+                          throw std::runtime_error{"start"};
+                      }
+                      return r;
+                  });
+            }
+            catch (std::runtime_error const&)
+            {
+                caught = true;
+            }
+        });
+        io.run();
+        BOOST_TEST(caught);
+    }
+
+    return boost::report_errors();
+}